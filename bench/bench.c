@@ -0,0 +1,326 @@
+#include "../include/buffer.h"
+#include "../include/constants.h"
+#include "../include/rle.h"
+#include "../include/simd.h"
+#include "../include/stream.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC 1
+#endif
+
+#define DEFAULT_CORPUS_SIZE (16 * MB)
+#define DEFAULT_RESULTS_DIR "./bench/results"
+#define BENCH_REPEATS 3
+#define BENCH_SEED 0x2545F4914F6CDD1DULL
+#define MAX_PATH 256
+
+typedef struct {
+    const char *name;
+    void (*generate)(unsigned char *data, size_t size, uint64_t *state);
+} Corpus;
+
+typedef struct {
+    double seconds;
+    uint64_t cycles;
+} Timing;
+
+// One benchmarked configuration: which API, corpus, mode and buffer size, and its best timings
+typedef struct {
+    const char *api;
+    const char *corpus;
+    const char *mode;
+    size_t buffer_size;
+    size_t input_size;
+    ssize_t compressed_size;
+    Timing compress;
+    Timing decompress;
+} BenchRow;
+
+static const size_t buffer_sizes[] = {4 * KB, 64 * KB, 1 * MB};
+
+// Deterministic xorshift64* generator, so every run benchmarks the same bytes
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Random bytes, no byte equal to the one before it: only literals
+static void generate_literal(unsigned char *data, size_t size, uint64_t *state) {
+    for (size_t i = 0; i < size; i++) {
+        unsigned char value = (unsigned char) next_random(state);
+        data[i] = i > 0 && value == data[i - 1] ? value + 1 : value;
+    }
+}
+
+// Runs of 256 to 4351 bytes: only runs
+static void generate_run(unsigned char *data, size_t size, uint64_t *state) {
+    size_t i = 0;
+    unsigned char value = 0;
+    while (i < size) {
+        size_t length = 256 + next_random(state) % 4096;
+        value += 1 + next_random(state) % 255;
+        length = length < size - i ? length : size - i;
+        memset(&data[i], value, length);
+        i += length;
+    }
+}
+
+// Geometric run lengths (mean 4) with random values: runs and literals mixed
+static void generate_mixed(unsigned char *data, size_t size, uint64_t *state) {
+    size_t i = 0;
+    while (i < size) {
+        size_t length = 1;
+        while (length < 64 && next_random(state) % 4 != 0) {
+            length++;
+        }
+        unsigned char value = (unsigned char) next_random(state);
+        length = length < size - i ? length : size - i;
+        memset(&data[i], value, length);
+        i += length;
+    }
+}
+
+// 24-bit pixel rows: flat background with shapes of a few colors and some noise,
+// like a drawing or screenshot saved as BMP
+static void generate_bmp(unsigned char *data, size_t size, uint64_t *state) {
+    const size_t row_size = 3 * 1024;
+    size_t i = 0;
+    while (i < size) {
+        size_t row = i / row_size;
+        for (size_t x = 0; x < row_size / 3 && i + 3 <= size; x++, i += 3) {
+            unsigned char pixel[3] = {0xF0, 0xF0, 0xF0};
+            if ((x / 64 + row / 64) % 3 == 0) {
+                pixel[0] = 0x20;
+                pixel[1] = (unsigned char) (row / 8);
+                pixel[2] = 0xC0;
+            }
+            if (next_random(state) % 32 == 0) {
+                pixel[next_random(state) % 3] ^= 0x01;
+            }
+            memcpy(&data[i], pixel, 3);
+        }
+        for (; i < size && i % row_size != 0; i++) {
+            data[i] = 0;
+        }
+    }
+}
+
+static const Corpus corpora[] = {
+    {"literal", generate_literal},
+    {"run", generate_run},
+    {"mixed", generate_mixed},
+    {"bmp", generate_bmp},
+};
+
+// Wall clock (not CPU time) and TSC cycles
+static Timing start_timing(void) {
+    Timing timing;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    timing.seconds = now.tv_sec + now.tv_nsec / 1e9;
+#ifdef HAS_TSC
+    timing.cycles = __rdtsc();
+#else
+    timing.cycles = 0;
+#endif
+    return timing;
+}
+
+static Timing stop_timing(Timing start) {
+    Timing end = start_timing();
+    end.seconds -= start.seconds;
+    end.cycles -= start.cycles;
+    return end;
+}
+
+// Compresses input in buffer_size pieces into buffer_size output pieces through a stream context
+static ssize_t compress_stream(const unsigned char *input, size_t input_size, unsigned char *output,
+                               CompressionMode mode, size_t buffer_size) {
+    RLEStream stream;
+    if (!rle_stream_init(&stream, stream_compress, mode)) {
+        return -1;
+    }
+    size_t consumed = 0, output_size = 0;
+    ssize_t produced = 0;
+    do {
+        size_t size = input_size - consumed < buffer_size ? input_size - consumed : buffer_size;
+        produced = rle_stream_compress(&stream, &input[consumed], size, &output[output_size], buffer_size,
+                                       consumed + size == input_size ? stream_finish : stream_no_flush);
+        consumed += stream.input_consumed;
+        output_size += produced > 0 ? produced : 0;
+    } while (produced > 0 || (produced == 0 && consumed < input_size));
+    rle_stream_end(&stream);
+    return produced < 0 ? -1 : (ssize_t) output_size;
+}
+
+// Decompresses input in buffer_size pieces into buffer_size output pieces through a stream context
+static ssize_t decompress_stream(const unsigned char *input, size_t input_size, unsigned char *output,
+                                 size_t buffer_size) {
+    RLEStream stream;
+    if (!rle_stream_init(&stream, stream_decompress, basic)) {
+        return -1;
+    }
+    size_t consumed = 0, output_size = 0;
+    ssize_t produced = 0;
+    do {
+        size_t size = input_size - consumed < buffer_size ? input_size - consumed : buffer_size;
+        produced = rle_stream_decompress(&stream, &input[consumed], size, &output[output_size], buffer_size,
+                                         consumed + size == input_size ? stream_finish : stream_no_flush);
+        consumed += stream.input_consumed;
+        output_size += produced > 0 ? produced : 0;
+    } while (produced > 0 || (produced == 0 && consumed < input_size));
+    rle_stream_end(&stream);
+    return produced < 0 ? -1 : (ssize_t) output_size;
+}
+
+// Prints one row and appends it to the csv and json results
+static void report_row(FILE *csv, FILE *json, int first, const BenchRow *row) {
+    double ratio = (double) row->compressed_size / row->input_size;
+    double compress_mbps = row->input_size / (double) MB / row->compress.seconds;
+    double decompress_mbps = row->input_size / (double) MB / row->decompress.seconds;
+    double compress_cpb = (double) row->compress.cycles / row->input_size;
+    double decompress_cpb = (double) row->decompress.cycles / row->input_size;
+    printf("%-9s %-8s %-8s %8zu %8.3f %12.1f %12.1f %10.2f %10.2f\n", row->api, row->corpus, row->mode,
+           row->buffer_size, ratio, compress_mbps, decompress_mbps, compress_cpb, decompress_cpb);
+    fprintf(csv, "%s,%s,%s,%zu,%zu,%zd,%.4f,%.1f,%.1f,%.3f,%.3f\n", row->api, row->corpus, row->mode,
+            row->buffer_size, row->input_size, row->compressed_size, ratio, compress_mbps, decompress_mbps,
+            compress_cpb, decompress_cpb);
+    fprintf(json, "%s\n    {\"api\": \"%s\", \"corpus\": \"%s\", \"mode\": \"%s\", \"buffer_size\": %zu, "
+                  "\"input_size\": %zu, \"compressed_size\": %zd, \"ratio\": %.4f, "
+                  "\"compress_mbps\": %.1f, \"decompress_mbps\": %.1f, "
+                  "\"compress_cycles_per_byte\": %.3f, \"decompress_cycles_per_byte\": %.3f}",
+            first ? "" : ",", row->api, row->corpus, row->mode, row->buffer_size, row->input_size,
+            row->compressed_size, ratio, compress_mbps, decompress_mbps, compress_cpb, decompress_cpb);
+}
+
+int main(int argc, char *argv[]) {
+    size_t corpus_size = DEFAULT_CORPUS_SIZE;
+    const char *results_dir = argc > 1 ? argv[1] : DEFAULT_RESULTS_DIR;
+    if (argc > 2 && (sscanf(argv[2], "%zu", &corpus_size) != 1 || corpus_size == 0)) {
+        fprintf(stderr, "[USAGE]: %s [results_dir] [corpus_size]\n", argv[0]);
+        return 1;
+    }
+
+    char csv_path[MAX_PATH];
+    char json_path[MAX_PATH];
+    mkdir(results_dir, 0755);
+    snprintf(csv_path, MAX_PATH, "%s/bench.csv", results_dir);
+    snprintf(json_path, MAX_PATH, "%s/bench.json", results_dir);
+    FILE *csv = fopen(csv_path, "w");
+    FILE *json = fopen(json_path, "w");
+    unsigned char *corpus = malloc(corpus_size);
+    // Room for the worst stream output and the worst container (rle_compress_bound())
+    size_t compressed_capacity = 2 * corpus_size + 2 * MB;
+    if (compressed_capacity < rle_compress_bound(corpus_size)) {
+        compressed_capacity = rle_compress_bound(corpus_size);
+    }
+    unsigned char *compressed = malloc(compressed_capacity);
+    unsigned char *decoded = malloc(corpus_size + 2 * MB);
+    if (!csv || !json || !corpus || !compressed || !decoded) {
+        fprintf(stderr, "Failed to set up the benchmark (%s)\n", results_dir);
+        return 1;
+    }
+
+    printf("Kernels: %s, corpus size: %zu bytes, best of %d runs\n\n", simd_kernel_name(), corpus_size,
+           BENCH_REPEATS);
+    printf("%-9s %-8s %-8s %8s %8s %12s %12s %10s %10s\n", "api", "corpus", "mode", "buffer", "ratio",
+           "comp MB/s", "decomp MB/s", "comp c/B", "decomp c/B");
+    fprintf(csv, "api,corpus,mode,buffer_size,input_size,compressed_size,ratio,compress_mbps,decompress_mbps,"
+                 "compress_cycles_per_byte,decompress_cycles_per_byte\n");
+    fprintf(json, "{\n  \"kernels\": \"%s\",\n  \"corpus_size\": %zu,\n  \"results\": [", simd_kernel_name(),
+            corpus_size);
+
+    int failed = 0;
+    int first = 1;
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++) {
+        uint64_t state = BENCH_SEED;
+        corpora[c].generate(corpus, corpus_size, &state);
+
+        for (int mode = basic; mode <= advance; mode++) {
+            for (size_t b = 0; b < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]); b++) {
+                Timing best_compress = {0, 0}, best_decompress = {0, 0};
+                ssize_t compressed_size = -1, decoded_size = -1;
+                for (int r = 0; r < BENCH_REPEATS; r++) {
+                    Timing timing = start_timing();
+                    compressed_size = compress_stream(corpus, corpus_size, compressed, mode, buffer_sizes[b]);
+                    timing = stop_timing(timing);
+                    if (r == 0 || timing.seconds < best_compress.seconds) {
+                        best_compress = timing;
+                    }
+
+                    timing = start_timing();
+                    decoded_size = compressed_size < 0 ? -1 : decompress_stream(compressed, compressed_size, decoded,
+                                                                                buffer_sizes[b]);
+                    timing = stop_timing(timing);
+                    if (r == 0 || timing.seconds < best_decompress.seconds) {
+                        best_decompress = timing;
+                    }
+                }
+                if (compressed_size < 0 || decoded_size != (ssize_t) corpus_size ||
+                    memcmp(corpus, decoded, corpus_size) != 0) {
+                    fprintf(stderr, "Round trip failed: %s, mode %d, buffer %zu\n", corpora[c].name, mode,
+                            buffer_sizes[b]);
+                    failed++;
+                    continue;
+                }
+
+                BenchRow row = {"stream", corpora[c].name, mode == advance ? "advance" : "basic", buffer_sizes[b],
+                                corpus_size, compressed_size, best_compress, best_decompress};
+                report_row(csv, json, first, &row);
+                first = 0;
+            }
+        }
+
+        // The block container the CLI writes, through the one-shot buffer API (DEFAULT_BLOCK_SIZE blocks)
+        for (int mode = basic; mode <= advance; mode++) {
+            Timing best_compress = {0, 0}, best_decompress = {0, 0};
+            ssize_t compressed_size = -1, decoded_size = -1;
+            for (int r = 0; r < BENCH_REPEATS; r++) {
+                Timing timing = start_timing();
+                compressed_size = rle_compress_buffer(corpus, corpus_size, compressed, compressed_capacity, mode);
+                timing = stop_timing(timing);
+                if (r == 0 || timing.seconds < best_compress.seconds) {
+                    best_compress = timing;
+                }
+
+                timing = start_timing();
+                decoded_size = compressed_size < 0 ? -1 : rle_decompress_buffer(compressed, compressed_size, decoded,
+                                                                                 corpus_size + 2 * MB);
+                timing = stop_timing(timing);
+                if (r == 0 || timing.seconds < best_decompress.seconds) {
+                    best_decompress = timing;
+                }
+            }
+            if (compressed_size < 0 || decoded_size != (ssize_t) corpus_size ||
+                memcmp(corpus, decoded, corpus_size) != 0) {
+                fprintf(stderr, "Container round trip failed: %s, mode %d\n", corpora[c].name, mode);
+                failed++;
+                continue;
+            }
+
+            BenchRow row = {"container", corpora[c].name, mode == advance ? "advance" : "basic", DEFAULT_BLOCK_SIZE,
+                            corpus_size, compressed_size, best_compress, best_decompress};
+            report_row(csv, json, first, &row);
+            first = 0;
+        }
+    }
+    fprintf(json, "\n  ]\n}\n");
+
+    printf("\nResults written to %s and %s\n", csv_path, json_path);
+    fclose(csv);
+    fclose(json);
+    free(corpus);
+    free(compressed);
+    free(decoded);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include "compressor.h"
+#include "stats.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct {
+    char* input_path;
+    char* output_path;
+    size_t input_size;
+    const char* error;  // Why the file failed before it was (de)compressed, or NULL
+    int result;         // If failed (0), on success (1)
+    RLEStats stats;     // Sizes and timings of the file
+} BatchFile;
+
+typedef struct {
+    BatchFile* files;
+    size_t file_count;
+    size_t file_capacity;
+    int compress_mode;       // Compress (1) or decompress (0) the files
+    const char* output_dir;  // Directory the outputs are written to (NULL = next to the inputs)
+    double total_time;
+} Batch;
+
+/*
+* Function: init_batch
+* --------------------
+*  Initiates an empty Batch.
+*
+*  batch: Pointer to the Batch.
+*  compress_mode: Compress (1) or decompress (0) the files.
+*  output_dir: Directory the outputs are written to, created if missing (NULL = next to the inputs).
+*/
+void init_batch(Batch* batch, int compress_mode, const char* output_dir);
+
+/*
+* Function: add_batch_path
+* ------------------------
+*  Adds a file, or every file under a directory (recursively), to a Batch.
+*  When compressing, directories are walked without their .rle files; when
+*  decompressing, only their .rle files are taken. The output of a file is
+*  named like in single file mode (.rle added or removed), and placed in
+*  output_dir under its path relative to the directory it was found in.
+*
+*  batch: Pointer to the Batch.
+*  path: File or directory path.
+*
+*  returns: If failed (0), on success (1)
+*/
+int add_batch_path(Batch* batch, const char* path);
+
+/*
+* Function: run_batch
+* -------------------
+*  (De)compresses every file of a Batch on one shared work-stealing pool.
+*  Files larger than a block are run one after the other, each split into
+*  blocks over the whole pool; smaller files are grouped into tasks of
+*  about a block of input each that run between them, so every worker stays
+*  busy whatever the file sizes are. A file that fails does not stop the
+*  others.
+*
+*  batch: Pointer to the Batch.
+*  options: Compression options (options->pool and options->stats are ignored).
+*
+*  returns: If any file failed (0), on success (1)
+*/
+int run_batch(Batch* batch, const CompressorOptions* options);
+
+/*
+* Function: print_batch_report
+* ----------------------------
+*  Prints the result of every file of a finished Batch, and the totals.
+*
+*  stream: Output stream.
+*  batch: Pointer to the Batch.
+*  verbose: Also print the stats of all the files together.
+*/
+void print_batch_report(FILE* stream, const Batch* batch, int verbose);
+
+/*
+* Function: free_batch
+* --------------------
+*  Frees the files of a Batch.
+*
+*  batch: Pointer to the Batch.
+*/
+void free_batch(Batch* batch);
+#endif
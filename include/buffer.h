@@ -0,0 +1,102 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+#include "rle.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+* Function: rle_compress_bound
+* ----------------------------
+*  Returns the largest possible size of the container rle_compress_buffer()
+*  writes for an input of src_size bytes. Blocks that RLE does not shrink
+*  are stored raw, so the bound is src_size plus 33 bytes, plus 25 bytes
+*  for every DEFAULT_BLOCK_SIZE block.
+*
+*  src_size: Input size.
+*
+*  returns: Output buffer size that always fits.
+*/
+size_t rle_compress_bound(size_t src_size);
+
+/*
+* Function: rle_compress_buffer
+* -----------------------------
+*  Compresses a buffer into a block container (DEFAULT_BLOCK_SIZE blocks)
+*  in another buffer. The blocks are encoded straight into dst and the
+*  block index is built by walking the written block headers, so nothing
+*  is allocated and no FILE is used.
+*
+*  src: Pointer to the input.
+*  src_size: Input size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (rle_compress_bound(src_size) always fits).
+*  compression_mode: Compression algorithm (any mode; 'pattern' uses DEFAULT_ELEMENT_WIDTH).
+*
+*  returns: Size of the container. If failed (-1).
+*/
+ssize_t rle_compress_buffer(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_capacity,
+                            CompressionMode compression_mode);
+
+/*
+* Function: rle_get_decompressed_size
+* -----------------------------------
+*  Returns the decoded size of a block container (from its block headers)
+*  or of a legacy .rle stream (from its counter bytes).
+*
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*
+*  returns: Decoded size. If the data is corrupted (-1).
+*/
+ssize_t rle_get_decompressed_size(const unsigned char* src, size_t src_size);
+
+/*
+* Function: rle_decompress_buffer
+* -------------------------------
+*  Decompresses a block container or a legacy .rle stream from a buffer
+*  into another buffer, without any FILE. Nothing is allocated, except one
+*  block of scratch memory for containers split into byte planes (-P) or
+*  with Huffman coded blocks (-H).
+*
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (see rle_get_decompressed_size()).
+*
+*  returns: Decoded size. If failed or dst is too small (-1).
+*/
+ssize_t rle_decompress_buffer(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_capacity);
+
+/*
+* Function: rle_get_scratch_size
+* ------------------------------
+*  Returns the scratch memory rle_decompress_buffer_with_scratch() needs
+*  for the compressed data: one block for containers split into byte planes
+*  (-P) or with Huffman coded blocks (-H), nothing otherwise.
+*
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*
+*  returns: Scratch size. If the data is corrupted (-1).
+*/
+ssize_t rle_get_scratch_size(const unsigned char* src, size_t src_size);
+
+/*
+* Function: rle_decompress_buffer_with_scratch
+* --------------------------------------------
+*  Same as rle_decompress_buffer(), but the scratch memory is caller owned
+*  (e.g. kept by an RLEContext between payloads), so nothing is allocated.
+*
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (see rle_get_decompressed_size()).
+*  scratch: Pointer to the scratch memory (NULL if none is needed).
+*  scratch_size: Scratch memory size (see rle_get_scratch_size()).
+*
+*  returns: Decoded size. If failed, dst is too small or the scratch memory is (-1).
+*/
+ssize_t rle_decompress_buffer_with_scratch(const unsigned char* src, size_t src_size, unsigned char* dst,
+                                           size_t dst_capacity, unsigned char* scratch, size_t scratch_size);
+#endif
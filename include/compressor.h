@@ -1,37 +1,127 @@
 #ifndef COMPRESSOR_H
 #define COMPRESSOR_H
+#include "pool.h"
 #include "rle.h"
+#include "simd.h"
+#include "stats.h"
+#include "thread_pool.h"
 
+#include <stdint.h>
 #include <stdio.h>
 
+typedef struct {
+    CompressionMode compression_mode;
+    size_t block_size;
+    size_t element_width;  // Element width of 'pattern' mode (also tried by 'adaptive')
+    size_t plane_count;    // Byte planes every block is split into before encoding (0 or 1 = not split)
+    DeltaMode delta_mode;  // Delta filter applied to every block before the planes are split
+    size_t delta_stride;   // Distance to the previous byte of the delta filter (e.g. a row of pixels)
+    int huffman;           // Huffman code the tokens of every block that it shrinks
+    size_t thread_count;
+    size_t buffer_size;    // Reader buffer (output buffer) size of legacy streams (0 = from the L2 cache and st_blksize)
+    size_t chunk_size;     // Input chunk size of legacy streams (0 = from the L2 cache, st_blksize and the file size)
+    RLEStats* stats;  // Filled with counters and timings when not NULL
+    ThreadPool* pool; // Shared pool to code the blocks on (NULL = start thread_count workers per call)
+    BufferPool* buffer_pool;  // Shared pool the block and stream buffers come from (NULL = allocated per call)
+    int quiet;        // Do not print the progress and the summary line
+    int io_uring;     // Read and write regular files through io_uring in compress()/decompress() (stdio if unavailable)
+} CompressorOptions;
+
+/*
+* Function: init_compressor_options
+* ---------------------------------
+* Fills CompressorOptions with the defaults: basic mode, DEFAULT_BLOCK_SIZE
+* blocks, DEFAULT_ELEMENT_WIDTH elements, no filters, one thread per CPU,
+* reader/chunk buffer sizes (used for legacy .rle streams) chosen for every
+* file, no stats, no shared thread or buffer pool and stdio reads and writes.
+*
+* options: Pointer to the CompressorOptions
+*/
+void init_compressor_options(CompressorOptions* options);
 
 /*
 * Function: compress
 * ------------------
-* Compresses the input file using huffman coding
+* Compresses the input file into a block container. The input is split into
+* options->block_size blocks that are encoded in parallel on a thread pool
+* and written in order. With options->io_uring, a regular input and output
+* are read and written with io_uring requests, a batch of blocks in flight
+* at once.
 *
 * input_file: Pointer to the input_file
 * output_file: Pointer to the output_file
-* writer_buffer_size: RLEWriter buffer (output buffer) size 
-* compressor_buffer_size: Compressor input buffer size
-* compression_mode: "basic" or "advance" algorithm
+* options: Compression mode, block size and thread count
 *
 * returns: If failed (0), On success (1)
 */
-int compress(FILE* input_file, FILE* output_file, size_t writer_buffer_size, size_t compressor_buffer_size,
-             CompressionMode compression_mode);
+int compress(FILE* input_file, FILE* output_file, const CompressorOptions* options);
 
 /*
 * Function: decompress
 * ------------------
-* Decompresses the input file using huffman coding
+* Decompresses a block container or a legacy .rle stream. With
+* options->io_uring, the blocks of a container in a regular file are read
+* through its block index, and a regular output is written, with io_uring
+* requests, a batch of blocks in flight at once.
 *
 * input_file: Pointer to the input_file
 * output_file: Pointer to the output_file
-* reader_buffer_size: RLEReader buffer (output buffer) size 
-* decompressor_buffer_size: Compressor input buffer size
+* options: Reader buffer (output buffer) and chunk sizes for legacy streams
+*
+* returns: If failed (0), On success (1)
+*/
+int decompress(FILE* input_file, FILE* output_file, const CompressorOptions* options);
+
+/*
+* Function: decompress_range
+* --------------------------
+* Decompresses only the bytes [offset, offset + length) of the decoded data.
+* Block containers are served through their block index: only the blocks
+* overlapping the range are read and decoded. Legacy .rle streams have no
+* index and are walked from the start, but the tokens before the range are
+* skipped without being expanded. A range past the end of the data is cut
+* short.
+*
+* input_file: Pointer to the input_file (must be seekable for block containers)
+* output_file: Pointer to the output_file
+* offset: First decoded byte to output
+* length: Number of decoded bytes to output
+* options: Reader buffer (output buffer) and chunk sizes for legacy streams
+*
+* returns: If failed (0), On success (1)
+*/
+int decompress_range(FILE* input_file, FILE* output_file, uint64_t offset, uint64_t length,
+                     const CompressorOptions* options);
+
+/*
+* Function: compress_mapped
+* -------------------------
+* Same as compress(), but the input is memory mapped read-only, so the
+* blocks are encoded straight from the page cache without read buffers.
+* Falls back to compress() where mmap is not available.
+*
+* input_file: Pointer to the input_file (regular file)
+* output_file: Pointer to the output_file
+* options: Compression mode, block size and thread count
+*
+* returns: If failed (0), On success (1)
+*/
+int compress_mapped(FILE* input_file, FILE* output_file, const CompressorOptions* options);
+
+/*
+* Function: decompress_mapped
+* ---------------------------
+* Decompresses a regular file through memory mappings. The decoded size is
+* computed from the block headers (or the counter bytes of a legacy stream),
+* the output is pre-sized with ftruncate, and the tokens are expanded
+* straight into the mapped output.
+* Falls back to decompress() where mmap is not available.
+*
+* input_file: Pointer to the input_file (regular file)
+* output_file: Pointer to the output_file (regular file, opened for reading and writing)
+* options: Reader buffer (output buffer) and chunk sizes for legacy streams
 *
 * returns: If failed (0), On success (1)
 */
-int decompress(FILE* input_file, FILE* output_file, size_t reader_buffer_size, size_t decompressor_buffer_size);    
+int decompress_mapped(FILE* input_file, FILE* output_file, const CompressorOptions* options);
 #endif
@@ -1,6 +1,22 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 #define KB 1024
+#define MB (1024 * KB)
 #define COMPRESSED_BUFFER_SIZE (2 * KB)
 #define DECOMPRESSED_BUFFER_SIZE (4 * KB)
+#define DEFAULT_BLOCK_SIZE (1 * MB)
+#define DEFAULT_ELEMENT_WIDTH 4
+#define BLOCKS_PER_THREAD 2
+#define MIN_SEGMENT_SIZE (64 * KB)
+#define MAX_SEGMENT_SIZE (1 * MB)
+#define STREAM_BUFFER_SIZE (64 * KB)
+#define PIPELINE_SLOTS 3
+#define BATCH_GROUP_FILES 64
+#define IO_RING_ENTRIES 64
+#define IO_BUFFER_ALIGNMENT 4096
+#define DEFAULT_IO_BLOCK_SIZE (4 * KB)
+#define DEFAULT_L2_CACHE_SIZE (256 * KB)
+#define MAX_BUFFER_SIZE (256 * MB)
+#define MIN_POOL_BUFFER_SIZE (4 * KB)
+#define HUGE_PAGE_SIZE (2 * MB)
 #endif
@@ -0,0 +1,276 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+#include "rle.h"
+#include "simd.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+* Container format (all integers are little-endian):
+*
+*  File header (CONTAINER_HEADER_SIZE bytes):
+*   magic "RLEC" | version (1) | compression mode (1) | plane count (1) | delta mode (1) | block size (4) |
+*   delta stride (4)
+*
+*  Blocks, each encoded on its own (no state is shared between blocks):
+*   block type (1, compression mode of the block) | raw size (4) | compressed size (4) | compressed data
+*  or, for blocks that RLE does not shrink (version 2):
+*   BLOCK_STORED (1) | raw size (4) | raw size (4) | raw data
+*
+*  Block types 0 and 1 hold basic/advance tokens, block type 2 (version 3)
+*  holds varint tokens (see write_varint_tokens()) and block type 3 (version 4)
+*  holds the element width and varint tokens of elements (see write_pattern_tokens()).
+*
+*  With a plane count above 1 (version 5), the bytes of every token block are
+*  split into that many byte planes (see split_planes()) before they are
+*  encoded. With a delta mode (version 6), every byte from the delta stride on
+*  is replaced by its difference or XOR to the byte delta stride bytes earlier
+*  first (see encode_delta()). Both filters start over at every block, and
+*  stored blocks always hold the raw bytes.
+*
+*  The tokens of a block may be Huffman coded as well (version 7, see
+*  huffman_encode()); the block type of such a block has BLOCK_HUFFMAN set.
+*  Blocks only use it when the compression mode byte of the file header has
+*  BLOCK_HUFFMAN set too.
+*
+*  Block index, after the last block:
+*   BLOCK_END (1) | per block: offset of its header (8) | raw size (4) | compressed size (4)
+*
+*  Trailer (CONTAINER_TRAILER_SIZE bytes):
+*   offset of the first index entry (8) | block count (4) | magic "RLEI"
+*
+* Legacy .rle files start with their compression mode byte (0 or 1) instead
+* of the magic, so both formats can be told apart by the first byte.
+*/
+#define CONTAINER_MAGIC "RLEC"
+#define CONTAINER_INDEX_MAGIC "RLEI"
+#define CONTAINER_VERSION 7
+#define CONTAINER_HEADER_SIZE 16
+#define CONTAINER_TRAILER_SIZE 16
+#define BLOCK_HEADER_SIZE 9
+#define INDEX_ENTRY_SIZE 16
+#define BLOCK_HUFFMAN 0x40
+#define BLOCK_STORED 0xFE
+#define BLOCK_END 0xFF
+#define MAX_BLOCK_SIZE (1U << 30)
+
+typedef struct {
+    unsigned char version;
+    CompressionMode compression_mode;
+    unsigned char huffman;      // Blocks may be Huffman coded (BLOCK_HUFFMAN in the compression mode byte)
+    uint32_t block_size;
+    unsigned char plane_count;  // Byte planes of the token blocks (0 or 1 = not split)
+    DeltaMode delta_mode;       // Delta filter of the token blocks
+    uint32_t delta_stride;
+} ContainerHeader;
+
+typedef struct {
+    size_t plane_count;      // Byte planes the block is split into (0 or 1 = not split)
+    DeltaMode delta_mode;    // Delta filter applied before the planes are split
+    size_t delta_stride;
+    int huffman;             // Huffman code the tokens when that makes them smaller (encoding only)
+    unsigned char* scratch;  // Block size bytes for the planes and the Huffman coding, and for the deltas when encoding
+} BlockFilter;
+
+typedef struct {
+    unsigned char block_type;
+    uint32_t raw_size;
+    uint32_t compressed_size;
+} BlockHeader;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t raw_offset; // Decoded offset of the block (not stored, summed up when loaded)
+    uint32_t raw_size;
+    uint32_t compressed_size;
+} BlockIndexEntry;
+
+typedef struct {
+    BlockIndexEntry* entries;
+    size_t block_count;
+    size_t capacity;
+} BlockIndex;
+
+/*
+* Function: write_container_header
+* --------------------------------
+*  Serializes a ContainerHeader.
+*
+*  output: Pointer to CONTAINER_HEADER_SIZE bytes.
+*  header: Pointer to the header.
+*/
+void write_container_header(unsigned char* output, const ContainerHeader* header);
+
+/*
+* Function: read_container_header
+* -------------------------------
+*  Parses and validates a serialized ContainerHeader.
+*
+*  input: Pointer to CONTAINER_HEADER_SIZE bytes.
+*  header: Pointer to the header to fill.
+*
+*  returns: If invalid (0), on success (1)
+*/
+int read_container_header(const unsigned char* input, ContainerHeader* header);
+
+/*
+* Function: write_block_header
+* ----------------------------
+*  Serializes a BlockHeader.
+*
+*  output: Pointer to BLOCK_HEADER_SIZE bytes.
+*  header: Pointer to the header.
+*/
+void write_block_header(unsigned char* output, const BlockHeader* header);
+
+/*
+* Function: read_block_header
+* ---------------------------
+*  Parses a serialized BlockHeader. Only the block type byte is read for
+*  BLOCK_END.
+*
+*  input: Pointer to BLOCK_HEADER_SIZE bytes.
+*  header: Pointer to the header to fill.
+*  container_header: Header of the container, used to validate the sizes.
+*
+*  returns: If invalid (0), on success (1)
+*/
+int read_block_header(const unsigned char* input, BlockHeader* header, const ContainerHeader* container_header);
+
+/*
+* Function: get_block_bound
+* -------------------------
+*  Returns the largest possible compressed size of a block. Version 1
+*  containers have no stored blocks, so their blocks may take 2 bytes for
+*  every raw byte; later versions store a block that does not shrink.
+*
+*  raw_size: Raw (uncompressed) block size.
+*  version: Container version.
+*
+*  returns: Compressed size upper bound.
+*/
+size_t get_block_bound(size_t raw_size, unsigned char version);
+
+/*
+* Function: encode_block
+* ----------------------
+*  Encodes one block into memory. A block whose tokens would not be smaller
+*  than the block itself is stored raw (BLOCK_STORED) instead.
+*
+*  input: Pointer to the raw block.
+*  raw_size: Raw block size.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size (raw_size always fits).
+*  compression_mode: Compression algorithm ('basic', 'advance', 'varint', 'pattern', or 'adaptive'
+*                    to pick the smallest one for this block; the block type records the choice).
+*  element_width: Element width for 'pattern' (and for 'adaptive' to try it), in bytes.
+*  filter: Pointer to the BlockFilter that delta encodes and splits the block first and Huffman codes the
+*          tokens (optional, NULL to disable). With both filters, the output buffer must hold raw_size bytes.
+*  header: Pointer to the BlockHeader to fill.
+*  stats: Pointer to the RLEStats that counts the tokens (optional, NULL to disable).
+*
+*  returns: If failed (0), on success (1)
+*/
+int encode_block(const unsigned char* input, size_t raw_size, unsigned char* output, size_t output_capacity,
+                 CompressionMode compression_mode, size_t element_width, const BlockFilter* filter,
+                 BlockHeader* header, RLEStats* stats);
+
+/*
+* Function: decode_block
+* ----------------------
+*  Decodes one block into memory.
+*
+*  header: Pointer to the BlockHeader of the block.
+*  input: Pointer to the compressed block data.
+*  output: Pointer to the output buffer (header->raw_size bytes).
+*  filter: Pointer to the BlockFilter that merges the planes and decodes the deltas (optional, NULL to disable;
+*          Huffman coded blocks need its scratch memory).
+*
+*  returns: If failed (0), on success (1)
+*/
+int decode_block(const BlockHeader* header, const unsigned char* input, unsigned char* output,
+                 const BlockFilter* filter);
+
+/*
+* Function: add_index_entry
+* -------------------------
+*  Appends a block to the BlockIndex.
+*
+*  index: Pointer to the BlockIndex (zero initialized before first use).
+*  offset: Offset of the block header in the file.
+*  header: Pointer to the BlockHeader of the block.
+*
+*  returns: If failed (0), on success (1)
+*/
+int add_index_entry(BlockIndex* index, uint64_t offset, const BlockHeader* header);
+
+/*
+* Function: find_block
+* --------------------
+*  Binary searches the BlockIndex for the block holding a decoded offset.
+*
+*  index: Pointer to the BlockIndex.
+*  raw_offset: Offset in the decoded data.
+*
+*  returns: Index of the block. If the offset is past the end (index->block_count).
+*/
+size_t find_block(const BlockIndex* index, uint64_t raw_offset);
+
+/*
+* Function: free_block_index
+* --------------------------
+*  Frees the entries of a BlockIndex.
+*
+*  index: Pointer to the BlockIndex.
+*/
+void free_block_index(BlockIndex* index);
+
+/*
+* Function: write_index_entry
+* ---------------------------
+*  Serializes a BlockIndexEntry (the raw offset is not stored).
+*
+*  output: Pointer to INDEX_ENTRY_SIZE bytes.
+*  entry: Pointer to the entry.
+*/
+void write_index_entry(unsigned char* output, const BlockIndexEntry* entry);
+
+/*
+* Function: write_container_trailer
+* ---------------------------------
+*  Serializes the trailer that points at the block index.
+*
+*  output: Pointer to CONTAINER_TRAILER_SIZE bytes.
+*  index_offset: Offset of the first index entry.
+*  block_count: Number of index entries.
+*/
+void write_container_trailer(unsigned char* output, uint64_t index_offset, uint32_t block_count);
+
+/*
+* Function: write_container_end
+* -----------------------------
+*  Writes the BLOCK_END marker, the block index and the trailer.
+*
+*  output_file: Pointer to the output file.
+*  index: Pointer to the BlockIndex of the written blocks.
+*  offset: Current offset in the output file (where BLOCK_END goes).
+*
+*  returns: If failed (0), on success (1)
+*/
+int write_container_end(FILE* output_file, const BlockIndex* index, uint64_t offset);
+
+/*
+* Function: read_block_index
+* --------------------------
+*  Loads the block index of a container through its trailer. The input
+*  file must be seekable; its position is left undefined.
+*
+*  input_file: Pointer to the input file.
+*  container_header: Header of the container, used to validate the entries.
+*  index: Pointer to the BlockIndex to fill (zero initialized).
+*
+*  returns: If failed (0), on success (1)
+*/
+int read_block_index(FILE* input_file, const ContainerHeader* container_header, BlockIndex* index);
+#endif
@@ -0,0 +1,124 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+#include "pool.h"
+#include "rle.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+typedef struct {
+    BufferPool* pool;                  // Pool the buffers come from and go back to (NULL = allocated and freed)
+    CompressionMode compression_mode;
+    size_t buffer_size;                // RLEWriter/RLEReader buffer size
+    size_t chunk_size;                 // Input chunk size of rle_context_encode()/rle_context_decode()
+    unsigned char* buffer;             // RLEWriter/RLEReader buffer (buffer_size bytes, the writer leaves the last as slack)
+    unsigned char* chunk;              // Input chunk (chunk_size bytes)
+    unsigned char* scratch;            // Block scratch of rle_context_decompress() (grown on demand)
+    size_t scratch_size;
+    RLEWriter rle_writer;
+    RLEReader rle_reader;
+} RLEContext;
+
+/*
+* Function: rle_context_create
+* ----------------------------
+*  Creates a reusable codec context. Its buffers are taken once, here, and
+*  kept for every payload coded through it until rle_context_destroy(), so
+*  a server coding many small payloads allocates nothing per request. With
+*  a BufferPool, the buffers of destroyed contexts are handed to the next
+*  ones, so short-lived contexts are cheap too.
+*
+*  ctx: Pointer to the RLEContext to create.
+*  pool: Pointer to the initiated BufferPool (NULL = malloc/free).
+*  compression_mode: Compression algorithm.
+*  buffer_size: RLEWriter/RLEReader buffer size (0 = STREAM_BUFFER_SIZE, else at least 2).
+*  chunk_size: Input chunk size of the FILE functions (0 = STREAM_BUFFER_SIZE).
+*
+*  returns: If failed (0), on success (1)
+*/
+int rle_context_create(RLEContext* ctx, BufferPool* pool, CompressionMode compression_mode, size_t buffer_size,
+                       size_t chunk_size);
+
+/*
+* Function: rle_context_reset
+* ---------------------------
+*  Readies a context for the next payload, keeping its buffers.
+*
+*  ctx: Pointer to the created RLEContext.
+*  compression_mode: Compression algorithm of the next payloads.
+*
+*  returns: If failed (0), on success (1)
+*/
+int rle_context_reset(RLEContext* ctx, CompressionMode compression_mode);
+
+/*
+* Function: rle_context_encode
+* ----------------------------
+*  Same as encode() (legacy .rle stream from the current position of the
+*  input to its end), through the buffers of the context.
+*
+*  ctx: Pointer to the created RLEContext ('basic' or 'advance' mode).
+*  input_file: Pointer to the input file.
+*  output_file: Pointer to the output file.
+*
+*  returns: Encoded bytes count. If failed (-1).
+*/
+ssize_t rle_context_encode(RLEContext* ctx, FILE* input_file, FILE* output_file);
+
+/*
+* Function: rle_context_decode
+* ----------------------------
+*  Same as decode(), but the compression mode byte is read too, through
+*  the buffers of the context.
+*
+*  ctx: Pointer to the created RLEContext.
+*  input_file: Pointer to the legacy .rle stream.
+*  output_file: Pointer to the output file.
+*
+*  returns: Compressed bytes count. If failed (-1).
+*/
+ssize_t rle_context_decode(RLEContext* ctx, FILE* input_file, FILE* output_file);
+
+/*
+* Function: rle_context_compress
+* ------------------------------
+*  Same as rle_compress_buffer() with the compression mode of the context.
+*
+*  ctx: Pointer to the created RLEContext.
+*  src: Pointer to the input.
+*  src_size: Input size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (rle_compress_bound(src_size) always fits).
+*
+*  returns: Size of the container. If failed (-1).
+*/
+ssize_t rle_context_compress(RLEContext* ctx, const unsigned char* src, size_t src_size, unsigned char* dst,
+                             size_t dst_capacity);
+
+/*
+* Function: rle_context_decompress
+* --------------------------------
+*  Same as rle_decompress_buffer(), but the scratch memory of byte plane
+*  and Huffman containers is kept by the context (and only grows).
+*
+*  ctx: Pointer to the created RLEContext.
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (see rle_get_decompressed_size()).
+*
+*  returns: Decoded size. If failed or dst is too small (-1).
+*/
+ssize_t rle_context_decompress(RLEContext* ctx, const unsigned char* src, size_t src_size, unsigned char* dst,
+                               size_t dst_capacity);
+
+/*
+* Function: rle_context_destroy
+* -----------------------------
+*  Gives the buffers of a context back to its pool (or frees them).
+*
+*  ctx: Pointer to the created RLEContext.
+*/
+void rle_context_destroy(RLEContext* ctx);
+#endif
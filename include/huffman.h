@@ -0,0 +1,45 @@
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+* Huffman coded data:
+*  decoded size (4, little-endian) | code length of every byte value (128, two 4-bit lengths per byte,
+*  low nibble first) | canonical codes, packed least significant bit first
+*
+* Codes are at most HUFFMAN_MAX_LENGTH bits, so one lookup in a table of
+* 2^HUFFMAN_MAX_LENGTH entries decodes one symbol, or two when both codes fit.
+*/
+#define HUFFMAN_MAX_LENGTH 11
+#define HUFFMAN_SYMBOLS 256
+#define HUFFMAN_HEADER_SIZE (4 + HUFFMAN_SYMBOLS / 2)
+
+/*
+* Function: huffman_encode
+* ------------------------
+*  Huffman codes bytes into memory.
+*
+*  input: Pointer to the bytes.
+*  size: Number of bytes.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*
+*  returns: Coded size. If it does not fit in output_capacity (-1).
+*/
+ssize_t huffman_encode(const unsigned char* input, size_t size, unsigned char* output, size_t output_capacity);
+
+/*
+* Function: huffman_decode
+* ------------------------
+*  Decodes Huffman coded data into memory.
+*
+*  input: Pointer to the coded data.
+*  size: Coded data size.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*
+*  returns: Decoded size. If the data is corrupted or does not fit in output_capacity (-1).
+*/
+ssize_t huffman_decode(const unsigned char* input, size_t size, unsigned char* output, size_t output_capacity);
+#endif
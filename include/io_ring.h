@@ -0,0 +1,95 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define IO_URING 1
+#endif
+#endif
+
+typedef struct {
+    int write;             // Write (1) or read (0)
+    int fd;
+    unsigned char* data;
+    size_t size;
+    uint64_t offset;       // File offset
+    int buffer_index;      // Registered buffer that holds data (-1 = not registered)
+    ssize_t result;        // Bytes transferred (less than size only at the end of a file), or -errno
+} IORequest;
+
+typedef struct {
+    int fd;                // Ring file descriptor (-1 = no ring)
+    unsigned entries;      // Submission queue entries
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    void* sqes;            // Submission queue entries (struct io_uring_sqe)
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    void* cqes;            // Completion queue entries (struct io_uring_cqe)
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;         // Same as sq_ring when the kernel maps both rings at once
+    size_t cq_ring_size;
+    size_t sqes_size;
+    int registered;        // Buffers are registered
+} IORing;
+
+/*
+* Function: init_io_ring
+* ----------------------
+*  Sets up an io_uring instance with raw system calls (no liburing).
+*
+*  ring: Pointer to the IORing.
+*  entries: Submission queue entries (requests in flight at once).
+*
+*  returns: If io_uring is not available (0), on success (1)
+*/
+int init_io_ring(IORing* ring, unsigned entries);
+
+/*
+* Function: register_io_buffers
+* -----------------------------
+*  Registers count buffers of buffer_size bytes, one after the other from
+*  buffers, with the kernel, so their pages are pinned once instead of on
+*  every request. Requests on a registered buffer give its index.
+*
+*  ring: Pointer to the initiated IORing.
+*  buffers: Pointer to the first buffer.
+*  buffer_size: Size of every buffer.
+*  count: Number of buffers.
+*
+*  returns: If not registered, e.g. over the locked memory limit (0), on success (1)
+*/
+int register_io_buffers(IORing* ring, unsigned char* buffers, size_t buffer_size, size_t count);
+
+/*
+* Function: run_io_requests
+* -------------------------
+*  Submits reads and writes at once, keeping up to ring->entries of them
+*  in flight, and waits until all of them are done. Short transfers are
+*  resubmitted for the rest, so only a read at the end of a file comes
+*  back short.
+*
+*  ring: Pointer to the initiated IORing.
+*  requests: Pointer to the requests (their result fields are set).
+*  count: Number of requests.
+*
+*  returns: If any request failed (0), on success (1)
+*/
+int run_io_requests(IORing* ring, IORequest* requests, size_t count);
+
+/*
+* Function: free_io_ring
+* ----------------------
+*  Unregisters the buffers and closes an IORing.
+*
+*  ring: Pointer to the IORing.
+*/
+void free_io_ring(IORing* ring);
+#endif
@@ -0,0 +1,37 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <stddef.h>
+
+/*
+* Stage function of a Pipeline: reads, codes or writes the slot with the
+* given index.
+*
+* returns: Slot done (1). End of the input, only from the read stage (0). If failed (-1).
+*/
+typedef int (*StageFunction)(void* context, size_t slot);
+
+typedef struct {
+    StageFunction read;   // Fills a free slot
+    StageFunction code;   // Codes a filled slot
+    StageFunction write;  // Writes a coded slot and frees it
+    void* context;        // Passed to every stage
+    size_t slot_count;    // Slots in the ring (at least 1)
+} Pipeline;
+
+/*
+* Function: run_pipeline
+* ----------------------
+*  Runs the read, code and write stages of a Pipeline at the same time: a
+*  reader thread and a writer thread are started, and the calling thread
+*  codes. The stages pass a ring of slot_count reusable slots along in
+*  order, so while slot N is coded, slot N + 1 is read and slot N - 1 is
+*  written. Every stage only touches the slot it is given, so the slots
+*  need no locking of their own. With a single slot, the stages run one
+*  after the other in the calling thread.
+*
+*  pipeline: Pointer to the Pipeline.
+*
+*  returns: If any stage failed (0), on success (1)
+*/
+int run_pipeline(const Pipeline* pipeline);
+#endif
@@ -0,0 +1,65 @@
+#ifndef POOL_H
+#define POOL_H
+#include <pthread.h>
+#include <stddef.h>
+
+#define BUFFER_POOL_CLASSES 32  // Size classes MIN_POOL_BUFFER_SIZE, twice that, ... (larger buffers are not kept)
+
+typedef struct {
+    void* free_lists[BUFFER_POOL_CLASSES];  // Released buffers by size class, linked through their first bytes
+    int huge_pages;     // Back buffers of HUGE_PAGE_SIZE and up with transparent huge pages
+    size_t allocations; // Buffers allocated from the system
+    size_t reuses;      // Buffers handed out again from the free lists
+    pthread_mutex_t lock;
+} BufferPool;
+
+/*
+* Function: init_buffer_pool
+* --------------------------
+*  Initiates an empty BufferPool. Released buffers are kept by size class
+*  (powers of two) and handed out again, so a codec that runs many times
+*  allocates nothing once every size it needs was used once.
+*
+*  pool: Pointer to the BufferPool to initiate.
+*  huge_pages: Align buffers of HUGE_PAGE_SIZE and up to it and ask for
+*              transparent huge pages (madvise), fewer TLB misses on large blocks.
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_buffer_pool(BufferPool* pool, int huge_pages);
+
+/*
+* Function: acquire_buffer
+* ------------------------
+*  Hands out a buffer of at least size bytes, aligned to IO_BUFFER_ALIGNMENT
+*  (or HUGE_PAGE_SIZE), from the free list of its size class, or allocates
+*  it when the list is empty. The content is not cleared.
+*
+*  pool: Pointer to the initiated BufferPool.
+*  size: Buffer size.
+*
+*  returns: Pointer to the buffer. If failed (NULL).
+*/
+void* acquire_buffer(BufferPool* pool, size_t size);
+
+/*
+* Function: release_buffer
+* ------------------------
+*  Gives a buffer of acquire_buffer() back to its size class.
+*
+*  pool: Pointer to the initiated BufferPool.
+*  buffer: Pointer to the buffer (NULL is ignored).
+*  size: Size the buffer was acquired with.
+*/
+void release_buffer(BufferPool* pool, void* buffer, size_t size);
+
+/*
+* Function: free_buffer_pool
+* --------------------------
+*  Frees the released buffers of a BufferPool (acquired buffers must be
+*  released first).
+*
+*  pool: Pointer to the initiated BufferPool.
+*/
+void free_buffer_pool(BufferPool* pool);
+#endif
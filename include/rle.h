@@ -1,13 +1,20 @@
 #ifndef RLE_H
 #define RLE_H
+#include "stats.h"
+
 #include <stdio.h>
 
 #define BASIC_COMPRESSION_LIMIT 255
 #define ADVANCE_COMPRESSION_LIMIT 128
+#define VARINT_MAX_SIZE 10
+#define MAX_ELEMENT_WIDTH 8
 
 typedef enum {
     basic,
-    advance
+    advance,
+    varint,   // Block containers only: run and sequence lengths are varints, never split
+    pattern,  // Block containers only: varint runs of multi-byte elements (e.g. pixels)
+    adaptive  // Block containers only: every block is encoded in the smallest of the modes above
 } CompressionMode;
 
 typedef struct {
@@ -20,14 +27,25 @@ typedef struct {
     size_t buffer_size;
     ssize_t counter_pos;
     size_t flag_byte_count;
+    RLEStats* stats;  // Token and flush counters (optional, NULL to disable)
+    int owns_buffer;  // The buffer was allocated by init_writer() (freed by free_writer())
 } RLEWriter;
 
+typedef enum {
+    read_counter,
+    read_run_byte,
+    read_literal
+} ReaderState;
+
 typedef struct {
     unsigned char* buffer;
     FILE* file;
     CompressionMode compression_mode;
     size_t buffer_pos;
     size_t buffer_size;
+    ReaderState state;
+    size_t token_remaining;
+    int owns_buffer;  // The buffer was allocated by init_reader() (freed by free_reader())
 } RLEReader;
 
 /*
@@ -44,6 +62,39 @@ typedef struct {
 */
 int init_writer(RLEWriter* rle_writer, FILE* file, size_t writer_buffer_size, CompressionMode compression_mode);
 
+/*
+* Function: init_writer_with_buffer
+* ---------------------------------
+*  Same as init_writer(), but the output buffer is caller owned (e.g. kept
+*  by an RLEContext between payloads), so nothing is allocated.
+*
+*  rle_writer: Pointer to the RLEWriter to initiate.
+*  file: Pointer to the output file.
+*  buffer: Pointer to the output buffer (writer_buffer_size + 1 bytes).
+*  writer_buffer_size: RLEWriter buffer (output buffer) size
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_writer_with_buffer(RLEWriter* rle_writer, FILE* file, unsigned char* buffer, size_t writer_buffer_size,
+                            CompressionMode compression_mode);
+
+/*
+* Function: init_memory_writer
+* ----------------------------
+*  Initiates an RLEWriter that writes into a caller owned buffer instead of
+*  a file. Nothing is allocated, and writing fails once the buffer is full.
+*
+*  rle_writer: Pointer to the RLEWriter to initiate.
+*  output: Pointer to the output buffer.
+*  output_size: Output buffer size.
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_memory_writer(RLEWriter* rle_writer, unsigned char* output, size_t output_size,
+                       CompressionMode compression_mode);
+
 /*
 * Function: init_reader
 * ---------------------
@@ -58,6 +109,59 @@ int init_writer(RLEWriter* rle_writer, FILE* file, size_t writer_buffer_size, Co
 */
 int init_reader(RLEReader* rle_reader, FILE* file, size_t reader_buffer_size, CompressionMode compression_mode);
 
+/*
+* Function: init_reader_with_buffer
+* ---------------------------------
+*  Same as init_reader(), but the output buffer is caller owned (e.g. kept
+*  by an RLEContext between payloads), so nothing is allocated.
+*
+*  rle_reader: Pointer to the RLEReader to initiate.
+*  file: Pointer to the output file.
+*  buffer: Pointer to the output buffer (reader_buffer_size bytes).
+*  reader_buffer_size: RLEReader buffer (output buffer) size
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_reader_with_buffer(RLEReader* rle_reader, FILE* file, unsigned char* buffer, size_t reader_buffer_size,
+                            CompressionMode compression_mode);
+
+/*
+* Function: free_writer
+* ---------------------
+*  Frees the output buffer allocated by init_writer(). Caller owned
+*  buffers (memory writers, init_writer_with_buffer()) are left alone.
+*
+*  rle_writer: Pointer to the RLEWriter.
+*/
+void free_writer(RLEWriter* rle_writer);
+
+/*
+* Function: free_reader
+* ---------------------
+*  Frees the output buffer allocated by init_reader(). Caller owned
+*  buffers (memory readers, init_reader_with_buffer()) are left alone.
+*
+*  rle_reader: Pointer to the RLEReader.
+*/
+void free_reader(RLEReader* rle_reader);
+
+/*
+* Function: init_memory_reader
+* ----------------------------
+*  Initiates an RLEReader that decodes into a caller owned buffer instead of
+*  a file. Nothing is allocated, and decoding fails once the buffer is full.
+*
+*  rle_reader: Pointer to the RLEReader to initiate.
+*  output: Pointer to the output buffer.
+*  output_size: Output buffer size.
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_memory_reader(RLEReader* rle_reader, unsigned char* output, size_t output_size,
+                       CompressionMode compression_mode);
+
 /*
 * Function: write_rle
 * -------------------
@@ -70,6 +174,22 @@ int init_reader(RLEReader* rle_reader, FILE* file, size_t reader_buffer_size, Co
 */
 int write_rle(RLEWriter* rle_writer, unsigned char* chr);
 
+/*
+* Function: write_rle_chunk
+* -------------------------
+*  Encodes and writes RLE for a whole chunk of input. Produces exactly the
+*  same output as calling write_rle() for every byte of the chunk, but scans
+*  runs and uncompressed sequences with the SIMD kernels and emits them in
+*  bulk, in the instance of the loop for the mode of the writer.
+*
+*  rle_writer: Pointer to the initiated RLEWriter.
+*  chunk: Pointer to the input chunk.
+*  chunk_size: Number of bytes in the chunk.
+*
+*  returns: If failed (0), on success (1).
+*/
+int write_rle_chunk(RLEWriter* rle_writer, const unsigned char* chunk, size_t chunk_size);
+
 /*
 * Function: read_rle
 * -------------------
@@ -82,10 +202,162 @@ int write_rle(RLEWriter* rle_writer, unsigned char* chr);
 */
 size_t read_rle(RLEReader* rle_reader, unsigned char* counter_byte);
 
+/*
+* Function: read_rle_chunk
+* ------------------------
+*  Decodes a compressed chunk straight into the RLEReader buffer, expanding
+*  runs with memset and uncompressed sequences with memcpy, in the instance
+*  of the loop for the mode of the reader. A token that is cut off at the
+*  end of the chunk is kept in the RLEReader state and finished by the next
+*  call, so chunks can have any size.
+*
+*  rle_reader: Pointer to the initiated RLEReader.
+*  chunk: Pointer to the compressed chunk.
+*  chunk_size: Number of bytes in the chunk.
+*
+*  returns: Consumed compressed bytes count. If failed (-1).
+*/
+ssize_t read_rle_chunk(RLEReader* rle_reader, const unsigned char* chunk, size_t chunk_size);
+
+/*
+* Function: next_token
+* --------------------
+*  Measures the token at the beginning of a compressed token stream from its
+*  counter byte, without decoding it.
+*
+*  chunk: Pointer to the compressed token stream (without the mode byte).
+*  chunk_size: Number of bytes in the stream.
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*  decoded_size: Pointer to the decoded size of the token (output).
+*
+*  returns: Compressed bytes count of the token. If the token is incomplete (0). If corrupted (-1).
+*/
+ssize_t next_token(const unsigned char* chunk, size_t chunk_size, CompressionMode compression_mode,
+                   size_t* decoded_size);
+
+/*
+* Function: skip_tokens
+* ---------------------
+*  Walks whole tokens of a compressed token stream, reading only the counter
+*  bytes, until at least min_size compressed bytes are covered or the
+*  stream ends. Used to split a stream at token boundaries.
+*
+*  chunk: Pointer to the compressed token stream (without the mode byte).
+*  chunk_size: Number of bytes in the stream.
+*  min_size: Compressed bytes to cover before stopping.
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*  decoded_size: Pointer to the decoded size of the walked tokens (output).
+*
+*  returns: Compressed bytes count of the walked tokens. If the stream is corrupted or truncated (-1).
+*/
+ssize_t skip_tokens(const unsigned char* chunk, size_t chunk_size, size_t min_size, CompressionMode compression_mode,
+                    size_t* decoded_size);
+
+/*
+* Function: get_decoded_size
+* --------------------------
+*  Computes the decoded size of a compressed token stream from its counter
+*  bytes only, without decoding it.
+*
+*  chunk: Pointer to the compressed token stream (without the mode byte).
+*  chunk_size: Number of bytes in the stream.
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: Decoded bytes count. If the stream is corrupted (-1).
+*/
+ssize_t get_decoded_size(const unsigned char* chunk, size_t chunk_size, CompressionMode compression_mode);
+
+/*
+* Function: write_varint_tokens
+* -----------------------------
+*  Encodes a whole buffer into varint tokens. Every run of 2 or more bytes
+*  is a single token (varint((length - 2) << 1), byte) and every stretch of
+*  single bytes is a single uncompressed sequence (varint((length - 1) << 1 | 1),
+*  bytes), so runs and sequences are never split at a counter limit.
+*
+*  input: Pointer to the raw data.
+*  input_size: Number of bytes.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*  stats: Pointer to the RLEStats that counts the tokens (optional, NULL to disable).
+*
+*  returns: Encoded bytes count. If the output buffer is full (-1).
+*/
+ssize_t write_varint_tokens(const unsigned char* input, size_t input_size, unsigned char* output,
+                            size_t output_capacity, RLEStats* stats);
+
+/*
+* Function: read_varint_tokens
+* ----------------------------
+*  Decodes a whole buffer of varint tokens, expanding every run with a
+*  single memset and every uncompressed sequence with a single memcpy.
+*
+*  input: Pointer to the varint tokens.
+*  input_size: Number of bytes.
+*  output: Pointer to the output buffer.
+*  output_size: Output buffer size.
+*
+*  returns: Decoded bytes count. If the tokens are corrupted or do not fit (-1).
+*/
+ssize_t read_varint_tokens(const unsigned char* input, size_t input_size, unsigned char* output,
+                           size_t output_size);
+
+/*
+* Function: write_pattern_tokens
+* ------------------------------
+*  Encodes a whole buffer of multi-byte elements (e.g. 16/24/32-bit pixels):
+*  the element width, then varint tokens over whole elements (see
+*  write_varint_tokens(), lengths count elements), then the bytes after the
+*  last whole element.
+*
+*  input: Pointer to the raw data.
+*  input_size: Number of bytes.
+*  element_width: Element width in bytes (2 to MAX_ELEMENT_WIDTH).
+*  output: Pointer to the output buffer (NULL to only count the encoded size).
+*  output_capacity: Output buffer size.
+*  stats: Pointer to the RLEStats that counts the tokens (optional, NULL to disable).
+*
+*  returns: Encoded bytes count. If the output buffer is full (-1).
+*/
+ssize_t write_pattern_tokens(const unsigned char* input, size_t input_size, size_t element_width,
+                             unsigned char* output, size_t output_capacity, RLEStats* stats);
+
+/*
+* Function: read_pattern_tokens
+* -----------------------------
+*  Decodes a whole buffer written by write_pattern_tokens().
+*
+*  input: Pointer to the encoded data.
+*  input_size: Number of bytes.
+*  output: Pointer to the output buffer.
+*  output_size: Output buffer size (the decoded size).
+*
+*  returns: Decoded bytes count. If the data is corrupted (-1).
+*/
+ssize_t read_pattern_tokens(const unsigned char* input, size_t input_size, unsigned char* output,
+                            size_t output_size);
+
+/*
+* Function: choose_compression_mode
+* ---------------------------------
+*  Picks the compression mode that encodes data smallest. The encoded sizes
+*  of the byte modes are computed in a single pass over the runs (found with
+*  the SIMD kernels), following the token rules of the writers, without
+*  encoding; 'pattern' takes a second pass over the elements.
+*
+*  data: Pointer to the raw data.
+*  size: Number of bytes.
+*  element_width: Element width for 'pattern' (0 to leave 'pattern' out).
+*
+*  returns: 'basic', 'advance', 'varint' or 'pattern' (the first one on a tie).
+*/
+CompressionMode choose_compression_mode(const unsigned char* data, size_t size, size_t element_width);
+
 /*
 * Function: flush_writer
 * ----------------------
-*  Flushes the remaining data in buffer to the output file.
+*  Flushes the remaining data in buffer to the output file. Memory writers
+*  only write out the pending run.
 *
 *  rle_writer: Pointer to the initiated RLEWriter
 *
@@ -107,7 +379,8 @@ int flush_reader(RLEReader* rle_reader);
 /*
 * Function: encode
 * ----------------
-*  Encodes file using RLE technique.
+*  Encodes file using RLE technique. The input is read from its current
+*  position to its end without seeking, so pipes and sockets work too.
 *
 *  input_file: Pointer to the input file.
 *  rle_writer: Pointer to the initiated RLEWriter.
@@ -117,19 +390,50 @@ int flush_reader(RLEReader* rle_reader);
 */
 ssize_t encode(FILE* input_file, RLEWriter* rle_writer, size_t chunk_size);
 
+/*
+* Function: encode_with_buffer
+* ----------------------------
+*  Same as encode(), but the input is read into a caller owned buffer, so
+*  nothing is allocated.
+*
+*  input_file: Pointer to the input file.
+*  rle_writer: Pointer to the initiated RLEWriter.
+*  read_buffer: Pointer to the input buffer (chunk_size bytes).
+*  chunk_size: Input buffer size
+*
+*  returns: Encoded bytes count. If failed (-1).
+*/
+ssize_t encode_with_buffer(FILE* input_file, RLEWriter* rle_writer, unsigned char* read_buffer, size_t chunk_size);
+
 /*
 * Function: decode
 * ----------------
-*  Decodes file using RLE technique.
+*  Decodes file using RLE technique. The input is read from its current
+*  position to its end without seeking, so pipes and sockets work too.
 *
-*  input_file: Pointer to the input file.
+*  input_file: Pointer to the input file (after the compression mode byte).
 *  rle_reader: Pointer to the initiated RLEReader.
 *  chunk_size: Input buffer size
 *
-*  returns: Decoded bytes count. If failed (-1).
+*  returns: Compressed bytes count. If failed (-1).
 */
 ssize_t decode(FILE* input_file, RLEReader* rle_reader, size_t chunk_size);
 
+/*
+* Function: decode_with_buffer
+* ----------------------------
+*  Same as decode(), but the input is read into a caller owned buffer, so
+*  nothing is allocated.
+*
+*  input_file: Pointer to the input file (after the compression mode byte).
+*  rle_reader: Pointer to the initiated RLEReader.
+*  read_buffer: Pointer to the input buffer (chunk_size bytes).
+*  chunk_size: Input buffer size
+*
+*  returns: Compressed bytes count. If failed (-1).
+*/
+ssize_t decode_with_buffer(FILE* input_file, RLEReader* rle_reader, unsigned char* read_buffer, size_t chunk_size);
+
 /*
 * Function: print_buffer
 * ----------------------
@@ -0,0 +1,135 @@
+#ifndef SIMD_H
+#define SIMD_H
+#include <stddef.h>
+
+#define MAX_PLANE_COUNT 16
+
+typedef enum {
+    delta_none,
+    delta_sub,  // Difference to the byte stride bytes earlier
+    delta_xor   // XOR with the byte stride bytes earlier
+} DeltaMode;
+
+/*
+* Function: find_run_length
+* -------------------------
+*  Counts how many leading bytes of data are equal to value. Uses the widest
+*  kernel (AVX-512, AVX2, SSE2 or scalar) supported by the CPU.
+*
+*  data: Pointer to the bytes to scan.
+*  size: Maximum number of bytes to scan.
+*  value: The run byte.
+*
+*  returns: Length of the run at the beginning of data.
+*/
+size_t find_run_length(const unsigned char* data, size_t size, unsigned char value);
+
+/*
+* Function: find_repeat
+* ---------------------
+*  Finds the first position where a byte is equal to the byte after it.
+*  Uses the widest kernel supported by the CPU.
+*
+*  data: Pointer to the bytes to scan.
+*  size: Number of bytes to scan.
+*
+*  returns: Smallest i with data[i] == data[i + 1]. If not found (size).
+*/
+size_t find_repeat(const unsigned char* data, size_t size);
+
+/*
+* Function: find_mismatch
+* -----------------------
+*  Finds the first position where two byte arrays differ. Uses the widest
+*  kernel supported by the CPU.
+*
+*  a: Pointer to the first array.
+*  b: Pointer to the second array (may overlap a).
+*  size: Number of bytes to compare.
+*
+*  returns: Smallest i with a[i] != b[i]. If not found (size).
+*/
+size_t find_mismatch(const unsigned char* a, const unsigned char* b, size_t size);
+
+/*
+* Function: find_element_repeat
+* -----------------------------
+*  Finds the first element (width bytes) that is equal to the element after
+*  it. Element widths 2, 4 and 8 are compared with the widest kernel
+*  supported by the CPU, other widths one element at a time.
+*
+*  data: Pointer to the elements.
+*  count: Number of elements to scan.
+*  width: Element width in bytes.
+*
+*  returns: Smallest k with element k == element k + 1. If not found (count).
+*/
+size_t find_element_repeat(const unsigned char* data, size_t count, size_t width);
+
+/*
+* Function: split_planes
+* ----------------------
+*  Splits elements of count bytes into count byte planes: byte p of every
+*  element goes to plane p, and the planes are stored one after the other.
+*  The size % count tail bytes are copied after the planes. Uses the widest
+*  byte shuffle kernel supported by the CPU.
+*
+*  input: Pointer to the elements.
+*  size: Number of bytes.
+*  count: Number of planes (1 to MAX_PLANE_COUNT).
+*  output: Pointer to size bytes for the planes (must not overlap input).
+*/
+void split_planes(const unsigned char* input, size_t size, size_t count, unsigned char* output);
+
+/*
+* Function: merge_planes
+* ----------------------
+*  Reverses split_planes(): interleaves count byte planes back into
+*  elements of count bytes.
+*
+*  input: Pointer to the planes (and tail bytes).
+*  size: Number of bytes.
+*  count: Number of planes (1 to MAX_PLANE_COUNT).
+*  output: Pointer to size bytes for the elements (must not overlap input).
+*/
+void merge_planes(const unsigned char* input, size_t size, size_t count, unsigned char* output);
+
+/*
+* Function: encode_delta
+* ----------------------
+*  Replaces every byte from stride on with its difference (mode 'delta_sub')
+*  or XOR (mode 'delta_xor') to the byte stride bytes earlier, e.g. the same
+*  channel of the previous pixel or the previous row. The first stride bytes
+*  are copied. Uses the widest kernel supported by the CPU.
+*
+*  input: Pointer to the bytes.
+*  size: Number of bytes.
+*  stride: Distance to the previous byte (at least 1).
+*  mode: 'delta_sub' or 'delta_xor' ('delta_none' copies the bytes).
+*  output: Pointer to size bytes for the deltas (must not overlap input).
+*/
+void encode_delta(const unsigned char* input, size_t size, size_t stride, DeltaMode mode, unsigned char* output);
+
+/*
+* Function: decode_delta
+* ----------------------
+*  Reverses encode_delta() in place: a running sum (or XOR) of every
+*  stride-th byte. Strides below the vector width are decoded with byte
+*  shuffle prefix steps.
+*
+*  data: Pointer to the deltas, replaced by the bytes.
+*  size: Number of bytes.
+*  stride: Distance to the previous byte (at least 1).
+*  mode: 'delta_sub' or 'delta_xor' ('delta_none' leaves the bytes as they are).
+*/
+void decode_delta(unsigned char* data, size_t size, size_t stride, DeltaMode mode);
+
+/*
+* Function: simd_kernel_name
+* --------------------------
+*  Returns the name of the kernel set selected for this CPU.
+*
+*  returns: "avx512", "avx2", "sse2" or "scalar".
+*/
+const char* simd_kernel_name(void);
+#endif
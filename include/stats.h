@@ -0,0 +1,64 @@
+#ifndef STATS_H
+#define STATS_H
+#include <stddef.h>
+#include <stdio.h>
+
+#define RUN_HISTOGRAM_SIZE 8
+
+typedef struct {
+    size_t bytes_in;
+    size_t bytes_out;
+    size_t run_tokens;
+    size_t literal_tokens;
+    size_t run_histogram[RUN_HISTOGRAM_SIZE];  // Run tokens by length: 1, 2-3, 4-7, ..., 128+
+    size_t stored_blocks;                      // Blocks stored raw, since RLE did not shrink them
+    size_t huffman_blocks;                     // Blocks whose tokens are Huffman coded
+    size_t output_writes;                      // fwrite calls (buffer flushes and block writes)
+    size_t ring_requests;                      // Reads and writes submitted through io_uring
+    double read_time;                          // Wall clock seconds spent in fread
+    double codec_time;                         // Wall clock seconds spent encoding/decoding (or waiting for the workers)
+    double write_time;                         // Wall clock seconds spent in fwrite/flush
+    double total_time;
+} RLEStats;
+
+/*
+* Function: init_stats
+* --------------------
+*  Zeroes every counter of an RLEStats.
+*
+*  stats: Pointer to the RLEStats.
+*/
+void init_stats(RLEStats* stats);
+
+/*
+* Function: count_run_token
+* -------------------------
+*  Counts a run token and adds its length to the histogram.
+*
+*  stats: Pointer to the RLEStats.
+*  length: Run length.
+*/
+void count_run_token(RLEStats* stats, size_t length);
+
+/*
+* Function: merge_stats
+* ---------------------
+*  Adds the counters of one RLEStats to another (timings are not added,
+*  since parallel jobs overlap).
+*
+*  stats: Pointer to the RLEStats to add to.
+*  other: Pointer to the RLEStats to add.
+*/
+void merge_stats(RLEStats* stats, const RLEStats* other);
+
+/*
+* Function: print_stats
+* ---------------------
+*  Prints the counters, the run length histogram and the time spent in
+*  every phase.
+*
+*  stream: Output stream.
+*  stats: Pointer to the RLEStats.
+*/
+void print_stats(FILE* stream, const RLEStats* stats);
+#endif
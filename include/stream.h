@@ -0,0 +1,116 @@
+#ifndef STREAM_H
+#define STREAM_H
+#include "rle.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef enum {
+    stream_compress,
+    stream_decompress
+} StreamDirection;
+
+typedef enum {
+    stream_no_flush,
+    stream_finish
+} StreamFlush;
+
+typedef struct {
+    StreamDirection direction;
+    CompressionMode compression_mode;
+    RLEWriter rle_writer;
+    unsigned char* buffer;         // Encoded bytes waiting for output room (compression)
+    size_t buffer_drained;         // Bytes of the writer buffer already handed out
+    unsigned char token[BASIC_COMPRESSION_LIMIT];    // Decoded token waiting for output room
+    size_t token_size;
+    size_t token_pos;
+    unsigned char carry[ADVANCE_COMPRESSION_LIMIT];  // Incomplete token from the end of the last input
+    size_t carry_size;
+    int started;                   // The compression mode byte is written/read
+    int finished;
+    size_t input_consumed;         // Input bytes consumed by the last call
+    size_t total_in;
+    size_t total_out;
+} RLEStream;
+
+/*
+* Function: rle_stream_init
+* -------------------------
+*  Initiates a streaming codec context. The stream format is the legacy
+*  .rle token stream (compression mode byte, then tokens), which can be
+*  produced and consumed without knowing the input size and without
+*  seeking, so it works on pipes and sockets.
+*
+*  stream: Pointer to the RLEStream to initiate.
+*  direction: 'stream_compress' or 'stream_decompress'.
+*  compression_mode: Compression algorithm (compression only; decompression reads it from the stream).
+*
+*  returns: If failed (0), on success (1)
+*/
+int rle_stream_init(RLEStream* stream, StreamDirection direction, CompressionMode compression_mode);
+
+/*
+* Function: rle_stream_compress
+* -----------------------------
+*  Compresses as much input as fits in the output. Encoded bytes that do
+*  not fit are kept in the context and handed out by the next call.
+*  stream->input_consumed is set to the input bytes consumed; the caller
+*  passes the rest again. With 'stream_finish', the pending run is ended
+*  once all input is consumed; call again until it returns 0.
+*
+*  stream: Pointer to the initiated RLEStream.
+*  input: Pointer to the input.
+*  input_size: Input size.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*  flush: 'stream_no_flush' or 'stream_finish' (no more input follows).
+*
+*  returns: Output bytes count. If failed (-1).
+*/
+ssize_t rle_stream_compress(RLEStream* stream, const unsigned char* input, size_t input_size, unsigned char* output,
+                            size_t output_capacity, StreamFlush flush);
+
+/*
+* Function: rle_stream_decompress
+* -------------------------------
+*  Decompresses as much input as fits in the output. Tokens are decoded
+*  straight into the output; a token cut off at the end of the input is
+*  kept in the context until the next call. stream->input_consumed is set
+*  to the input bytes consumed; the caller passes the rest again. With
+*  'stream_finish', an incomplete token is reported as a truncated stream.
+*
+*  stream: Pointer to the initiated RLEStream.
+*  input: Pointer to the compressed input.
+*  input_size: Input size.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*  flush: 'stream_no_flush' or 'stream_finish' (no more input follows).
+*
+*  returns: Output bytes count. If failed (-1).
+*/
+ssize_t rle_stream_decompress(RLEStream* stream, const unsigned char* input, size_t input_size, unsigned char* output,
+                              size_t output_capacity, StreamFlush flush);
+
+/*
+* Function: rle_stream_reset
+* --------------------------
+*  Readies a streaming codec context for the next stream, keeping its
+*  buffer, so a context serving many streams allocates nothing per stream.
+*
+*  stream: Pointer to the initiated RLEStream.
+*  direction: 'stream_compress' or 'stream_decompress'.
+*  compression_mode: Compression algorithm (compression only; decompression reads it from the stream).
+*
+*  returns: If failed (0), on success (1)
+*/
+int rle_stream_reset(RLEStream* stream, StreamDirection direction, CompressionMode compression_mode);
+
+/*
+* Function: rle_stream_end
+* ------------------------
+*  Frees the buffers of a streaming codec context.
+*
+*  stream: Pointer to the initiated RLEStream.
+*/
+void rle_stream_end(RLEStream* stream);
+#endif
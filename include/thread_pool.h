@@ -0,0 +1,123 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <pthread.h>
+#include <stddef.h>
+
+typedef void (*TaskFunction)(void* arg);
+
+typedef struct {
+    size_t pending;  // Tasks of the group that have not finished yet
+} TaskGroup;
+
+typedef struct {
+    TaskFunction function;
+    void* arg;
+    TaskGroup* group;  // NULL if the task is not in a group
+} Task;
+
+typedef struct {
+    Task* tasks;  // Ring, oldest task at the head
+    size_t capacity;
+    size_t head;
+    size_t count;
+    pthread_mutex_t lock;
+} TaskQueue;
+
+typedef struct {
+    pthread_t* threads;
+    size_t thread_count;
+    TaskQueue* queues;    // One queue per worker thread
+    size_t next_queue;    // Queue for the next task submitted from outside the pool
+    size_t started_count; // Workers that picked their queue so far
+    size_t task_count;    // Tasks waiting in the queues
+    size_t active_count;  // Tasks being run
+    size_t group_waiters; // Threads helping out in wait_task_group()
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t task_ready;
+    pthread_cond_t tasks_done;
+} ThreadPool;
+
+/*
+* Function: get_cpu_count
+* -----------------------
+*  Returns the number of online CPUs.
+*
+*  returns: CPU count (at least 1).
+*/
+size_t get_cpu_count(void);
+
+/*
+* Function: init_thread_pool
+* --------------------------
+*  Starts the worker threads of a ThreadPool. Every worker has a queue of
+*  its own, where the tasks it submits stay; when its queue is empty, it
+*  steals the oldest task of another worker's queue.
+*
+*  pool: Pointer to the ThreadPool to initiate.
+*  thread_count: Number of worker threads (0 = one per CPU).
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_thread_pool(ThreadPool* pool, size_t thread_count);
+
+/*
+* Function: submit_task
+* ---------------------
+*  Queues a task to be run by one of the worker threads. A task submitted
+*  by a worker goes to the worker's own queue, other tasks are spread over
+*  the queues in turn.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*  function: Task function.
+*  arg: Argument passed to the task function.
+*
+*  returns: If failed (0), on success (1)
+*/
+int submit_task(ThreadPool* pool, TaskFunction function, void* arg);
+
+/*
+* Function: submit_group_task
+* ---------------------------
+*  Same as submit_task(), but the task is added to a TaskGroup, so
+*  wait_task_group() can wait for it.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*  group: Pointer to the TaskGroup (zero initiated before its first task).
+*  function: Task function.
+*  arg: Argument passed to the task function.
+*
+*  returns: If failed (0), on success (1)
+*/
+int submit_group_task(ThreadPool* pool, TaskGroup* group, TaskFunction function, void* arg);
+
+/*
+* Function: wait_task_group
+* -------------------------
+*  Blocks until every task of a TaskGroup has finished. While waiting, the
+*  calling thread runs queued tasks itself, so tasks of the pool may wait
+*  for groups of their own without tying up the workers.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*  group: Pointer to the TaskGroup.
+*/
+void wait_task_group(ThreadPool* pool, TaskGroup* group);
+
+/*
+* Function: wait_thread_pool
+* --------------------------
+*  Blocks until every submitted task has finished.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*/
+void wait_thread_pool(ThreadPool* pool);
+
+/*
+* Function: free_thread_pool
+* --------------------------
+*  Finishes the queued tasks, stops the worker threads and frees the pool.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*/
+void free_thread_pool(ThreadPool* pool);
+#endif
@@ -24,6 +24,20 @@ void err(const char* func_name, const char* message);
 */
 FILE* open_file(const char* path, const char* mode);
 
+/*
+* Function open_stream
+* --------------------
+*  Same as open_file(), but the path "-" stands for stdin (read modes) or
+*  stdout (write modes). When stdout carries the data, the logs printed on
+*  stdout are moved to stderr so they don't mix with it.
+*
+*  path: File path or "-"
+*  mode: fopen modes
+*
+*  returns: Pointer to the file. If failed, returns NULL
+*/
+FILE* open_stream(const char* path, const char* mode);
+
 /*
 * Function: extract_filename_format
 * ---------------------------------
@@ -48,6 +62,73 @@ int extract_filename_format(const char *filepath, char **filename, char **filefo
 */
 size_t get_file_size(FILE* file);
 
+/*
+* Function: is_regular_file
+* -------------------------
+*  Checks if the file is a regular (seekable, mappable) file, rather than a
+*  pipe, socket or terminal.
+*
+*  file: Pointer to the file
+*
+*  returns: Regular file (1), otherwise (0)
+*/
+int is_regular_file(FILE* file);
+
+/*
+* Function: is_directory
+* ----------------------
+*  Checks if a path names a directory.
+*
+*  path: Path
+*
+*  returns: Directory (1), otherwise (0)
+*/
+int is_directory(const char* path);
+
+/*
+* Function: parse_size
+* --------------------
+*  Parses a size in bytes, with an optional K, M or G suffix (powers of
+*  1024, either case, optionally followed by B or iB), e.g. 4096, 64K or 4MB.
+*
+*  text: Size text
+*  size: Pointer to the parsed size
+*
+*  returns: If the text is not a size, or overflows (0), on success (1)
+*/
+int parse_size(const char* text, size_t* size);
+
+/*
+* Function: get_io_block_size
+* ---------------------------
+*  Returns the preferred I/O size of a file (st_blksize).
+*
+*  file: Pointer to the file
+*
+*  returns: I/O size (DEFAULT_IO_BLOCK_SIZE if unknown).
+*/
+size_t get_io_block_size(FILE* file);
+
+/*
+* Function: get_l2_cache_size
+* ---------------------------
+*  Returns the size of the L2 cache of the first CPU, from sysconf() or
+*  sysfs.
+*
+*  returns: Cache size (DEFAULT_L2_CACHE_SIZE if unknown).
+*/
+size_t get_l2_cache_size(void);
+
+/*
+* Function: get_wall_time
+* -----------------------
+*  Returns the monotonic wall clock time. Unlike clock() (CPU time of the
+*  process), it includes the time spent waiting for I/O.
+*
+*  returns: Time in seconds.
+*/
+double get_wall_time(void);
+
 /*
 * Function get_line
 * -----------------
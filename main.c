@@ -1,8 +1,14 @@
+#include "include/batch.h"
 #include "include/constants.h"
+#include "include/container.h"
+#include "include/pool.h"
 #include "include/rle.h"
+#include "include/simd.h"
+#include "include/stats.h"
 #include "include/utils.h"
 #include "include/compressor.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,14 +23,26 @@ int main(int argc, char* argv[])
     int decompress_mode = 0;
     int output_file_mode = 0;
     CompressionMode compression_mode = basic;
-    // int verbose_mode = 0;
-    size_t compressed_buffer_size = COMPRESSED_BUFFER_SIZE;
-    size_t decompressed_buffer_size = DECOMPRESSED_BUFFER_SIZE;
+    int verbose_mode = 0;
+    size_t compressed_buffer_size = 0;    // 0 = chosen for every file
+    size_t decompressed_buffer_size = 0;
+    size_t block_size = DEFAULT_BLOCK_SIZE;
+    size_t element_width = DEFAULT_ELEMENT_WIDTH;
+    size_t plane_count = 0;
+    DeltaMode delta_mode = delta_none;
+    size_t delta_stride = 0;
+    int huffman = 0;
+    int io_uring = 0;
+    int huge_pages = 0;
+    size_t thread_count = 0;
+    int range_mode = 0;
+    uint64_t range_offset = 0;
+    uint64_t range_length = 0;
     char* output_file_path = NULL;
     char* input_file_path = NULL;
 
     // Setting up the CLI
-    while ((opt = getopt(argc, argv, "c:d:o:b:B:va")) != -1) {
+    while ((opt = getopt(argc, argv, "c:d:o:b:B:s:t:r:valp:AP:D:X:HUM")) != -1) {
         switch (opt) {
             case 'c':
                 if (decompress_mode) {
@@ -66,43 +84,198 @@ int main(int argc, char* argv[])
                 strcpy(output_file_path, optarg);
                 break;
             case 'v':
-                // verbose_mode = 1;
+                verbose_mode = 1;
                 break;
             case 'a':
                 compression_mode = advance;
                 break;
-            case 'b': {
-                size_t c_buffer_size = 0;
-                if (scanf(optarg, "%zu", &c_buffer_size) == 1) {
-                    compressed_buffer_size = c_buffer_size;
+            case 'l':
+                compression_mode = varint;
+                break;
+            case 'p': {
+                size_t p_element_width = 0;
+                if (sscanf(optarg, "%zu", &p_element_width) != 1 || p_element_width < 2 ||
+                    p_element_width > MAX_ELEMENT_WIDTH) {
+                    err("main", "Invalid element width!"
+                                "\n\tUse -p 2 to 8 (bytes per element, e.g. 3 for 24-bit pixels).\n");
+                    return EXIT_FAILURE;
+                }
+                element_width = p_element_width;
+                if (compression_mode != adaptive) {
+                    compression_mode = pattern;
+                }
+                break;
+            }
+            case 'A':
+                compression_mode = adaptive;
+                break;
+            case 'H':
+                huffman = 1;
+                break;
+            case 'U':
+                io_uring = 1;
+                break;
+            case 'M':
+                huge_pages = 1;
+                break;
+            case 'P': {
+                size_t p_plane_count = 0;
+                if (sscanf(optarg, "%zu", &p_plane_count) != 1 || p_plane_count < 2 ||
+                    p_plane_count > MAX_PLANE_COUNT) {
+                    err("main", "Invalid plane count!"
+                                "\n\tUse -P 2 to 16 (bytes per element, e.g. 3 for 24-bit pixels).\n");
+                    return EXIT_FAILURE;
+                }
+                plane_count = p_plane_count;
+                break;
+            }
+            case 'D':
+            case 'X': {
+                size_t d_delta_stride = 0;
+                if (sscanf(optarg, "%zu", &d_delta_stride) != 1 || d_delta_stride < 1 || d_delta_stride > UINT32_MAX) {
+                    err("main", "Invalid delta stride!"
+                                "\n\tUse -D or -X with the distance to the previous byte (e.g. 3 for the previous"
+                                "\n\t24-bit pixel, or the row size in bytes for the previous row).\n");
+                    return EXIT_FAILURE;
                 }
+                delta_mode = opt == 'D' ? delta_sub : delta_xor;
+                delta_stride = d_delta_stride;
                 break;
             }
+            case 'b':
             case 'B': {
-                size_t d_buffer_size = 0;
-                if (scanf(optarg, "%zu", &d_buffer_size) == 1) {
-                    decompressed_buffer_size = d_buffer_size;
+                size_t b_buffer_size = 0;
+                if (!parse_size(optarg, &b_buffer_size) || b_buffer_size < 1 || b_buffer_size > MAX_BUFFER_SIZE) {
+                    err("main", "Invalid buffer size!"
+                                "\n\tUse -b or -B with 1 byte to 256M (e.g. 65536, 64K or 4M).\n");
+                    return EXIT_FAILURE;
+                }
+                if (opt == 'b') {
+                    compressed_buffer_size = b_buffer_size;
+                } else {
+                    decompressed_buffer_size = b_buffer_size;
+                }
+                break;
+            }
+            case 's': {
+                size_t s_block_size = 0;
+                if (!parse_size(optarg, &s_block_size) || s_block_size < 1 || s_block_size > MAX_BLOCK_SIZE) {
+                    err("main", "Invalid block size!"
+                                "\n\tUse -s with 1 byte to 1G (e.g. 1048576, 1024K or 1M).\n");
+                    return EXIT_FAILURE;
                 }
+                block_size = s_block_size;
                 break;
             }
+            case 't': {
+                size_t t_thread_count = 0;
+                if (sscanf(optarg, "%zu", &t_thread_count) == 1) {
+                    thread_count = t_thread_count;
+                }
+                break;
+            }
+            case 'r':
+                if (sscanf(optarg, "%" SCNu64 ":%" SCNu64, &range_offset, &range_length) != 2) {
+                    err("main", "Invalid range!"
+                                "\n\tUse -r offset:length.\n");
+                    return EXIT_FAILURE;
+                }
+                range_mode = 1;
+                break;
             default:
-                fprintf(stderr, "[USAGE]: %s [-c filename] [-d filename] [-o output_file_name] [-a or -b] [-v]"
-                                "\n\t-c: compress file"
-                                "\n\t-d: decompress file"
-                                "\n\t-o: output file"
+                fprintf(stderr, "[USAGE]: %s [-c path ...] [-d path ...] [-o output_file_name] [-a, -l, -p width or -A] [-P planes] [-D or -X stride] [-H] [-U] [-M] [-v]"
+                                "\n\t-c: compress file (- for stdin)"
+                                "\n\t-d: decompress file (- for stdin)"
+                                "\n\t-o: output file (- for stdout)"
+                                "\n\t    Several paths or a directory (walked recursively) are run as a batch on one"
+                                "\n\t    thread pool, and -o names the output directory (default: next to the inputs)"
                                 "\n\t-a: use advance RLE algorithm (default: basic)"
-                                "\n\t-b: compressed buffer (reader/writer buffer) size (default: %d bytes)"
-                                "\n\t-B: decompressed buffer (chunck reader) size (default: %d bytes)"
-                                "\n\t-v: print logs\n\r", 
-                        argv[0], (COMPRESSED_BUFFER_SIZE), (DECOMPRESSED_BUFFER_SIZE));
+                                "\n\t-l: use varint run lengths (long runs are never split)"
+                                "\n\t-p: use runs of width byte elements, e.g. 3 for 24-bit pixels (with -A: also try them)"
+                                "\n\t-A: pick basic, advance, varint or pattern for every block, whichever is smallest"
+                                "\n\t-P: split every block into byte planes first, e.g. 3 for the B, G and R channels of 24-bit pixels"
+                                "\n\t-D: store every byte as the difference to the byte stride bytes earlier (e.g. the previous row)"
+                                "\n\t-X: store every byte XORed with the byte stride bytes earlier"
+                                "\n\t-H: Huffman code the RLE tokens of every block it shrinks"
+                                "\n\t-b: legacy .rle decode only: output buffer size, e.g. 64K or 4M (default: from the L2 cache size and st_blksize)"
+                                "\n\t-B: legacy .rle decode only: chunk reader size (default: from the L2 cache size, st_blksize and the file size)"
+                                "\n\t-s: block size, e.g. 256K (default: %d bytes)"
+                                "\n\t-t: worker threads (default: one per CPU)"
+                                "\n\t-U: read and write regular files through io_uring instead of mmap (Linux, falls back to stdio)"
+                                "\n\t-M: back the block buffers with 2 MiB transparent huge pages (Linux, a hint only)"
+                                "\n\t-r: decompress only the decoded bytes offset:length"
+                                "\n\t-v: print stats (token counts, run lengths, time per phase)\n\r", 
+                        argv[0], (DEFAULT_BLOCK_SIZE));
                 return EXIT_FAILURE;
         }
     }
 
+    CompressorOptions options;
+    init_compressor_options(&options);
+    options.compression_mode = compression_mode;
+    options.block_size = block_size;
+    options.element_width = element_width;
+    options.plane_count = plane_count;
+    options.delta_mode = delta_mode;
+    options.delta_stride = delta_stride;
+    options.huffman = huffman;
+    options.io_uring = io_uring;
+    options.thread_count = thread_count;
+    options.buffer_size = compressed_buffer_size;
+    options.chunk_size = decompressed_buffer_size;
+    RLEStats stats;
+    init_stats(&stats);
+    if (verbose_mode) {
+        options.stats = &stats;
+    }
+    BufferPool buffer_pool;
+    if (huge_pages && init_buffer_pool(&buffer_pool, 1)) {
+        options.buffer_pool = &buffer_pool;
+    }
+
+    // Batch mode: the paths after the flags are added to the -c/-d path, and directories are walked
+    if ((compress_mode || decompress_mode) && (optind < argc || is_directory(input_file_path))) {
+        if (range_mode || strcmp(input_file_path, "-") == 0 || (output_file_mode && strcmp(output_file_path, "-") == 0)) {
+            err("main", "Invalid flag combination!"
+                        "\n\tCan't use -r, stdin or stdout with several files.\n");
+            return EXIT_FAILURE;
+        }
+
+        Batch batch;
+        init_batch(&batch, compress_mode, output_file_path);
+        int result = add_batch_path(&batch, input_file_path);
+        for (int i = optind; result && i < argc; i++) {
+            result = add_batch_path(&batch, argv[i]);
+        }
+        if (result) {
+            result = run_batch(&batch, &options);
+            print_batch_report(stdout, &batch, verbose_mode);
+        }
+        printf("\n\t--->> Batch %s %s!\n\n\r", compress_mode ? "compression" : "decompression",
+               result ? "completed" : "failed");
+        free_batch(&batch);
+        if (options.buffer_pool != NULL) {
+            free_buffer_pool(options.buffer_pool);
+        }
+        free(output_file_path);
+        free(input_file_path);
+        return result ? 0 : EXIT_FAILURE;
+    }
+
+    // Exit status of the single-file modes below
+    int exit_status = 0;
+
     // Compression mode:
     if (compress_mode && !decompress_mode) {
         // If user did not specify an output path, add '.rle' at the end of the input file
-        if (!output_file_mode) {
+        // (or write to stdout when reading stdin)
+        if (!output_file_mode && strcmp(input_file_path, "-") == 0) {
+            output_file_path = strdup("-");
+            if (output_file_path == NULL) {
+                err("main", "Unable to allocate memory for output file name!\n");
+                return EXIT_FAILURE;
+            }
+        } else if (!output_file_mode) {
             size_t output_file_size = strlen(input_file_path) + strlen(".rle") + 1;
             output_file_path = malloc(output_file_size);
             if (output_file_path == NULL) {
@@ -113,22 +286,31 @@ int main(int argc, char* argv[])
             output_file_path[output_file_size - 1] = '\0';
         }
 
-        FILE* input_file = open_file(input_file_path, "rb");
-        FILE* output_file = open_file(output_file_path, "wb");
+        FILE* input_file = open_stream(input_file_path, "rb");
+        FILE* output_file = open_stream(output_file_path, "w+b");
 
         if (input_file == NULL || output_file == NULL) {
             return EXIT_FAILURE;
         }
 
-        int result = compress(input_file, output_file, compressed_buffer_size, decompressed_buffer_size, compression_mode);
+        // Regular input files are compressed through memory mappings (unless io_uring is asked for)
+        int result = is_regular_file(input_file) && !io_uring
+                   ? compress_mapped(input_file, output_file, &options)
+                   : compress(input_file, output_file, &options);
         fclose(input_file);
         fclose(output_file);
+        exit_status = result ? 0 : EXIT_FAILURE;
         printf("\n\t--->> Compression ");
         if (result) {
             printf("completed!\n");
+            if (verbose_mode) {
+                print_stats(stdout, &stats);
+            }
         } else {
             printf("failed!\n");
-            remove(output_file_path);
+            if (strcmp(output_file_path, "-") != 0) {
+                remove(output_file_path);
+            }
         }
 
     } 
@@ -137,7 +319,14 @@ int main(int argc, char* argv[])
         // If user did not specify an output path:
         //  - If file has .rle at the end, remove it
         //  - Or use the same path as input
-        if (!output_file_mode) {
+        //  - Or write to stdout when reading stdin
+        if (!output_file_mode && strcmp(input_file_path, "-") == 0) {
+            output_file_path = strdup("-");
+            if (output_file_path == NULL) {
+                err("main", "Unable to allocate memory for output file name!\n");
+                return EXIT_FAILURE;
+            }
+        } else if (!output_file_mode) {
             char* filename = NULL;
             char* file_extention = NULL;
 
@@ -165,27 +354,46 @@ int main(int argc, char* argv[])
             }
         }
 
-        FILE* input_file = open_file(input_file_path, "rb");
-        FILE* output_file = open_file(output_file_path, "wb");
+        FILE* input_file = open_stream(input_file_path, "rb");
+        FILE* output_file = open_stream(output_file_path, "w+b");
 
         if (input_file == NULL || output_file == NULL) {
             return EXIT_FAILURE;
         }
 
-        int result = decompress(input_file, output_file, compressed_buffer_size, decompressed_buffer_size);
+        // Regular files on both ends are decompressed through memory mappings (unless io_uring is asked for)
+        // (stdout is write-only, so it is not mapped even when redirected to a file)
+        int result = 0;
+        if (range_mode) {
+            result = decompress_range(input_file, output_file, range_offset, range_length, &options);
+        } else if (is_regular_file(input_file) && is_regular_file(output_file) && strcmp(output_file_path, "-") != 0 &&
+                   !io_uring) {
+            result = decompress_mapped(input_file, output_file, &options);
+        } else {
+            result = decompress(input_file, output_file, &options);
+        }
         fclose(input_file);
         fclose(output_file);
+        exit_status = result ? 0 : EXIT_FAILURE;
         printf("\n\t--->> Decompression ");
         if (result) {
             printf("completed!\n");
+            if (verbose_mode && !range_mode) {
+                print_stats(stdout, &stats);
+            }
         } else {
             printf("failed!\n");
-            remove(output_file_path);
+            if (strcmp(output_file_path, "-") != 0) {
+                remove(output_file_path);
+            }
         }
     }
 
     printf("\n\r");
+    if (options.buffer_pool != NULL) {
+        free_buffer_pool(options.buffer_pool);
+    }
     free(output_file_path);
     free(input_file_path);
-    return 0;
+    return exit_status;
 }
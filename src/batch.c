@@ -0,0 +1,497 @@
+#include "../include/batch.h"
+#include "../include/constants.h"
+#include "../include/pool.h"
+#include "../include/thread_pool.h"
+#include "../include/utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define INITIAL_FILE_CAPACITY 64
+
+typedef struct {
+    Batch* batch;
+    const CompressorOptions* options;
+    const size_t* files;  // Indexes of the files of the group
+    size_t file_count;
+} BatchGroup;
+
+/*
+* Function: init_batch
+* --------------------
+*  Initiates an empty Batch.
+*
+*  batch: Pointer to the Batch.
+*  compress_mode: Compress (1) or decompress (0) the files.
+*  output_dir: Directory the outputs are written to, created if missing (NULL = next to the inputs).
+*/
+void init_batch(Batch* batch, int compress_mode, const char* output_dir) {
+    batch->files = NULL;
+    batch->file_count = 0;
+    batch->file_capacity = 0;
+    batch->compress_mode = compress_mode;
+    batch->output_dir = output_dir;
+    batch->total_time = 0;
+}
+
+/*
+* Function: has_rle_extension
+* ---------------------------
+*  Checks if a path ends with ".rle" (in any case).
+*/
+static int has_rle_extension(const char* path) {
+    size_t length = strlen(path);
+    return length > 4 && strcasecmp(&path[length - 4], ".rle") == 0;
+}
+
+/*
+* Function: join_path
+* -------------------
+*  Returns "directory/name" in a new string.
+*
+*  returns: Pointer to the path. If failed (NULL).
+*/
+static char* join_path(const char* directory, const char* name) {
+    size_t directory_length = strlen(directory);
+    while (directory_length > 1 && directory[directory_length - 1] == '/') {
+        directory_length--;
+    }
+    char* path = malloc(directory_length + 1 + strlen(name) + 1);
+    if (path != NULL) {
+        memcpy(path, directory, directory_length);
+        path[directory_length] = '/';
+        strcpy(&path[directory_length + 1], name);
+    }
+    return path;
+}
+
+/*
+* Function: add_file
+* ------------------
+*  Adds a regular file to a Batch. relative_path is the part of the path
+*  that is kept under output_dir.
+*
+*  returns: If failed (0), on success (1)
+*/
+static int add_file(Batch* batch, const char* path, const char* relative_path, size_t size) {
+    if (batch->file_count == batch->file_capacity) {
+        size_t new_capacity = batch->file_capacity > 0 ? 2 * batch->file_capacity : INITIAL_FILE_CAPACITY;
+        BatchFile* files = realloc(batch->files, new_capacity * sizeof(BatchFile));
+        if (files == NULL) {
+            err("add_batch_path", "Unable to allocate memory for the file list!");
+            return 0;
+        }
+        batch->files = files;
+        batch->file_capacity = new_capacity;
+    }
+
+    BatchFile* file = &batch->files[batch->file_count];
+    file->input_path = strdup(path);
+    file->output_path = NULL;
+    file->input_size = size;
+    file->error = NULL;
+    file->result = 0;
+    init_stats(&file->stats);
+    if (file->input_path == NULL) {
+        err("add_batch_path", "Unable to allocate memory for the file list!");
+        return 0;
+    }
+
+    const char* name = batch->output_dir != NULL ? relative_path : path;
+    if (!batch->compress_mode && !has_rle_extension(name)) {
+        file->error = "Not a .rle file";
+    } else {
+        // Same names as in single file mode: "file" -> "file.rle" -> "file"
+        size_t base_length = batch->compress_mode ? strlen(name) : strlen(name) - strlen(".rle");
+        char* output_name = malloc(base_length + strlen(".rle") + 1);
+        if (output_name != NULL) {
+            memcpy(output_name, name, base_length);
+            strcpy(&output_name[base_length], batch->compress_mode ? ".rle" : "");
+            if (batch->output_dir != NULL) {
+                file->output_path = join_path(batch->output_dir, output_name);
+                free(output_name);
+            } else {
+                file->output_path = output_name;
+            }
+        }
+        if (file->output_path == NULL) {
+            err("add_batch_path", "Unable to allocate memory for the file list!");
+            free(file->input_path);
+            return 0;
+        }
+    }
+    batch->file_count++;
+    return 1;
+}
+
+/*
+* Function: add_directory
+* -----------------------
+*  Adds the files under a directory to a Batch, recursively. root_length
+*  is the length of the directory path that was given to add_batch_path().
+*
+*  returns: If failed (0), on success (1)
+*/
+static int add_directory(Batch* batch, const char* directory, size_t root_length) {
+    DIR* dir = opendir(directory);
+    if (dir == NULL) {
+        fprintf(stderr, "\n[ERROR]: add_batch_path() {} -> Unable to open '%s'!\n", directory);
+        return 0;
+    }
+
+    int result = 1;
+    struct dirent* entry;
+    while (result && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char* path = join_path(directory, entry->d_name);
+        struct stat st;
+        if (path == NULL) {
+            err("add_batch_path", "Unable to allocate memory for the file list!");
+            result = 0;
+        } else if (lstat(path, &st) != 0) {
+            fprintf(stderr, "\n[ERROR]: add_batch_path() {} -> Unable to open '%s'!\n", path);
+            result = 0;
+        } else if (S_ISDIR(st.st_mode)) {
+            // Symbolic links to directories are not followed, so the walk cannot loop
+            result = add_directory(batch, path, root_length);
+        } else if ((S_ISREG(st.st_mode) || (S_ISLNK(st.st_mode) && stat(path, &st) == 0 && S_ISREG(st.st_mode))) &&
+                   (batch->compress_mode ? !has_rle_extension(entry->d_name) : has_rle_extension(entry->d_name))) {
+            const char* relative_path = &path[root_length];
+            while (*relative_path == '/') {
+                relative_path++;
+            }
+            result = add_file(batch, path, relative_path, st.st_size);
+        }
+        free(path);
+    }
+    closedir(dir);
+    return result;
+}
+
+/*
+* Function: add_batch_path
+* ------------------------
+*  Adds a file, or every file under a directory (recursively), to a Batch.
+*  When compressing, directories are walked without their .rle files; when
+*  decompressing, only their .rle files are taken. The output of a file is
+*  named like in single file mode (.rle added or removed), and placed in
+*  output_dir under its path relative to the directory it was found in.
+*
+*  batch: Pointer to the Batch.
+*  path: File or directory path.
+*
+*  returns: If failed (0), on success (1)
+*/
+int add_batch_path(Batch* batch, const char* path) {
+    if (batch == NULL || path == NULL) {
+        err("add_batch_path", "Required parameters are NULL!");
+        return 0;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "\n[ERROR]: add_batch_path() {} -> Unable to open '%s'!\n", path);
+        return 0;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return add_directory(batch, path, strlen(path));
+    }
+    if (!S_ISREG(st.st_mode)) {
+        fprintf(stderr, "\n[ERROR]: add_batch_path() {} -> '%s' is not a regular file!\n", path);
+        return 0;
+    }
+    const char* name = strrchr(path, '/');
+    return add_file(batch, path, name != NULL ? name + 1 : path, st.st_size);
+}
+
+/*
+* Function: compare_output_paths
+* ------------------------------
+*  qsort() comparator: orders BatchFile pointers by output path.
+*/
+static int compare_output_paths(const void* a, const void* b) {
+    const BatchFile* file_a = *(BatchFile* const*) a;
+    const BatchFile* file_b = *(BatchFile* const*) b;
+    return strcmp(file_a->output_path, file_b->output_path);
+}
+
+/*
+* Function: mark_duplicate_outputs
+* --------------------------------
+*  Fails every file whose output path is already taken by another file
+*  (e.g. two inputs with the same name in one output directory), so no two
+*  workers write the same file.
+*
+*  returns: If failed (0), on success (1)
+*/
+static int mark_duplicate_outputs(Batch* batch) {
+    BatchFile** files = malloc(batch->file_count * sizeof(BatchFile*) + 1);
+    if (files == NULL) {
+        err("run_batch", "Unable to allocate memory for the file list!");
+        return 0;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < batch->file_count; i++) {
+        if (batch->files[i].output_path != NULL) {
+            files[count++] = &batch->files[i];
+        }
+    }
+    qsort(files, count, sizeof(BatchFile*), compare_output_paths);
+    for (size_t i = 1; i < count; i++) {
+        if (strcmp(files[i - 1]->output_path, files[i]->output_path) == 0) {
+            files[i]->error = "Output path is taken by another file";
+        }
+    }
+    free(files);
+    return 1;
+}
+
+/*
+* Function: make_parent_directories
+* ---------------------------------
+*  Creates the missing directories of a file path.
+*
+*  returns: If failed (0), on success (1)
+*/
+static int make_parent_directories(const char* path) {
+    char* directory = strdup(path);
+    if (directory == NULL) {
+        return 0;
+    }
+    int result = 1;
+    for (char* slash = strchr(&directory[1], '/'); result && slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        result = mkdir(directory, 0755) == 0 || errno == EEXIST;
+        *slash = '/';
+    }
+    free(directory);
+    return result;
+}
+
+/*
+* Function: run_file
+* ------------------
+*  (De)compresses one file of a Batch through memory mappings (or through
+*  io_uring for files larger than a block when options->io_uring is set,
+*  since setting up a ring costs more than a small file takes) and records
+*  its result.
+*/
+static void run_file(const Batch* batch, BatchFile* file, const CompressorOptions* options) {
+    if (file->error != NULL) {
+        return;
+    }
+
+    double start_time = get_wall_time();
+    CompressorOptions file_options = *options;
+    file_options.stats = &file->stats;
+    FILE* input_file = open_file(file->input_path, "rb");
+    if (input_file == NULL) {
+        file->error = "Unable to open the input file";
+        return;
+    }
+    FILE* output_file = make_parent_directories(file->output_path) ? open_file(file->output_path, "w+b") : NULL;
+    if (output_file == NULL) {
+        file->error = "Unable to create the output file";
+        fclose(input_file);
+        return;
+    }
+
+    if (options->io_uring && file->input_size > options->block_size) {
+        file->result = batch->compress_mode ? compress(input_file, output_file, &file_options)
+                                            : decompress(input_file, output_file, &file_options);
+    } else {
+        file->result = batch->compress_mode ? compress_mapped(input_file, output_file, &file_options)
+                                            : decompress_mapped(input_file, output_file, &file_options);
+    }
+    fclose(input_file);
+    fclose(output_file);
+    if (!file->result) {
+        remove(file->output_path);
+    }
+    file->stats.total_time = get_wall_time() - start_time;
+}
+
+/*
+* Function: run_group_task
+* ------------------------
+*  Thread pool task: (de)compresses the small files of a BatchGroup one
+*  after the other.
+*/
+static void run_group_task(void* arg) {
+    BatchGroup* group = arg;
+    for (size_t i = 0; i < group->file_count; i++) {
+        run_file(group->batch, &group->batch->files[group->files[i]], group->options);
+    }
+}
+
+/*
+* Function: run_batch
+* -------------------
+*  (De)compresses every file of a Batch on one shared work-stealing pool.
+*  Files larger than a block are run one after the other, each split into
+*  blocks over the whole pool; smaller files are grouped into tasks of
+*  about a block of input each that run between them, so every worker stays
+*  busy whatever the file sizes are. A file that fails does not stop the
+*  others. The block buffers of finished files are reused by the next ones
+*  through options->buffer_pool, or a BufferPool of the batch without one.
+*
+*  batch: Pointer to the Batch.
+*  options: Compression options (options->pool and options->stats are ignored).
+*
+*  returns: If any file failed (0), on success (1)
+*/
+int run_batch(Batch* batch, const CompressorOptions* options) {
+    if (batch == NULL || options == NULL) {
+        err("run_batch", "Required parameters are NULL!");
+        return 0;
+    }
+
+    double start_time = get_wall_time();
+    size_t* order = malloc(batch->file_count * sizeof(size_t) + 1);
+    BatchGroup* groups = malloc(batch->file_count * sizeof(BatchGroup) + 1);
+    ThreadPool pool;
+    if (order == NULL || groups == NULL || !mark_duplicate_outputs(batch) ||
+        init_thread_pool(&pool, options->thread_count) == 0) {
+        err("run_batch", "Unable to start the batch!");
+        free(order);
+        free(groups);
+        return 0;
+    }
+
+    BufferPool own_buffer_pool;
+    BufferPool* buffer_pool = options->buffer_pool;
+    if (buffer_pool == NULL && init_buffer_pool(&own_buffer_pool, 0)) {
+        buffer_pool = &own_buffer_pool;
+    }
+
+    CompressorOptions file_options = *options;
+    file_options.pool = &pool;
+    file_options.buffer_pool = buffer_pool;
+    file_options.stats = NULL;
+    file_options.quiet = 1;
+
+    // Small files first (grouped), then the large ones
+    size_t block_size = options->block_size > 0 ? options->block_size : DEFAULT_BLOCK_SIZE;
+    size_t small_count = 0;
+    for (size_t i = 0; i < batch->file_count; i++) {
+        if (batch->files[i].input_size <= block_size) {
+            order[small_count++] = i;
+        }
+    }
+    size_t large_count = 0;
+    for (size_t i = 0; i < batch->file_count; i++) {
+        if (batch->files[i].input_size > block_size) {
+            order[small_count + large_count++] = i;
+        }
+    }
+
+    // Every group holds about a block of input, or BATCH_GROUP_FILES files
+    TaskGroup tasks = {0};
+    size_t group_count = 0;
+    size_t group_start = 0;
+    size_t group_size = 0;
+    for (size_t i = 0; i < small_count; i++) {
+        group_size += batch->files[order[i]].input_size;
+        if (group_size >= block_size || i + 1 - group_start == BATCH_GROUP_FILES || i + 1 == small_count) {
+            BatchGroup* group = &groups[group_count++];
+            group->batch = batch;
+            group->options = &file_options;
+            group->files = &order[group_start];
+            group->file_count = i + 1 - group_start;
+            if (submit_group_task(&pool, &tasks, run_group_task, group) == 0) {
+                run_group_task(group);
+            }
+            group_start = i + 1;
+            group_size = 0;
+        }
+    }
+
+    // Large files are split into blocks over the whole pool, while the workers fill the gaps with groups
+    for (size_t i = small_count; i < small_count + large_count; i++) {
+        run_file(batch, &batch->files[order[i]], &file_options);
+    }
+    wait_task_group(&pool, &tasks);
+    free_thread_pool(&pool);
+    if (buffer_pool == &own_buffer_pool) {
+        free_buffer_pool(&own_buffer_pool);
+    }
+    free(order);
+    free(groups);
+
+    batch->total_time = get_wall_time() - start_time;
+    int result = 1;
+    for (size_t i = 0; i < batch->file_count; i++) {
+        result = result && batch->files[i].result;
+    }
+    return result;
+}
+
+/*
+* Function: print_batch_report
+* ----------------------------
+*  Prints the result of every file of a finished Batch, and the totals.
+*
+*  stream: Output stream.
+*  batch: Pointer to the Batch.
+*  verbose: Also print the stats of all the files together.
+*/
+void print_batch_report(FILE* stream, const Batch* batch, int verbose) {
+    RLEStats total;
+    init_stats(&total);
+    size_t failed = 0;
+    for (size_t i = 0; i < batch->file_count; i++) {
+        const BatchFile* file = &batch->files[i];
+        if (file->result) {
+            fprintf(stream, "\n\t[OK] %s -> %s: %zu bytes -> %zu bytes (%f s)", file->input_path, file->output_path,
+                    file->stats.bytes_in, file->stats.bytes_out, file->stats.total_time);
+            merge_stats(&total, &file->stats);
+            total.bytes_in += file->stats.bytes_in;
+            total.bytes_out += file->stats.bytes_out;
+            total.read_time += file->stats.read_time;
+            total.codec_time += file->stats.codec_time;
+            total.write_time += file->stats.write_time;
+        } else {
+            const char* error = file->error != NULL ? file->error
+                                : batch->compress_mode ? "Compression failed"
+                                                       : "Decompression failed";
+            fprintf(stream, "\n\t[FAILED] %s: %s", file->input_path, error);
+            failed++;
+        }
+    }
+    total.total_time = batch->total_time;
+
+    fprintf(stream, "\n\n[BATCH]: %zu files, %zu completed, %zu failed (%f s): %zu bytes -> %zu bytes\n",
+            batch->file_count, batch->file_count - failed, failed, batch->total_time, total.bytes_in,
+            total.bytes_out);
+    if (verbose) {
+        print_stats(stream, &total);
+    }
+}
+
+/*
+* Function: free_batch
+* --------------------
+*  Frees the files of a Batch.
+*
+*  batch: Pointer to the Batch.
+*/
+void free_batch(Batch* batch) {
+    if (batch == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < batch->file_count; i++) {
+        free(batch->files[i].input_path);
+        free(batch->files[i].output_path);
+    }
+    free(batch->files);
+    batch->files = NULL;
+    batch->file_count = 0;
+    batch->file_capacity = 0;
+}
@@ -0,0 +1,294 @@
+#include "../include/buffer.h"
+#include "../include/constants.h"
+#include "../include/container.h"
+#include "../include/rle.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+* Function: next_block
+* --------------------
+*  Parses the block header at offset of an in-memory container and checks
+*  that the block data is inside the buffer.
+*
+*  returns: On a block (1). On BLOCK_END (0). If corrupted (-1).
+*/
+static int next_block(const unsigned char* src, size_t src_size, size_t offset, const ContainerHeader* container_header,
+                      BlockHeader* header) {
+    if (offset >= src_size) {
+        return -1;
+    }
+    if (src[offset] == BLOCK_END) {
+        return 0;
+    }
+    if (src_size - offset < BLOCK_HEADER_SIZE || read_block_header(&src[offset], header, container_header) == 0 ||
+        src_size - offset - BLOCK_HEADER_SIZE < header->compressed_size) {
+        return -1;
+    }
+    return 1;
+}
+
+/*
+* Function: rle_compress_bound
+* ----------------------------
+*  Returns the largest possible size of the container rle_compress_buffer()
+*  writes for an input of src_size bytes. Blocks that RLE does not shrink
+*  are stored raw, so the bound is src_size plus 33 bytes, plus 25 bytes
+*  for every DEFAULT_BLOCK_SIZE block.
+*
+*  src_size: Input size.
+*
+*  returns: Output buffer size that always fits.
+*/
+size_t rle_compress_bound(size_t src_size) {
+    size_t block_count = (src_size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+    return CONTAINER_HEADER_SIZE + block_count * (BLOCK_HEADER_SIZE + INDEX_ENTRY_SIZE) +
+           get_block_bound(src_size, CONTAINER_VERSION) + 1 + CONTAINER_TRAILER_SIZE;
+}
+
+/*
+* Function: rle_compress_buffer
+* -----------------------------
+*  Compresses a buffer into a block container (DEFAULT_BLOCK_SIZE blocks)
+*  in another buffer. The blocks are encoded straight into dst and the
+*  block index is built by walking the written block headers, so nothing
+*  is allocated and no FILE is used.
+*
+*  src: Pointer to the input.
+*  src_size: Input size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (rle_compress_bound(src_size) always fits).
+*  compression_mode: Compression algorithm (any mode; 'pattern' uses DEFAULT_ELEMENT_WIDTH).
+*
+*  returns: Size of the container. If failed (-1).
+*/
+ssize_t rle_compress_buffer(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_capacity,
+                            CompressionMode compression_mode) {
+    if ((src == NULL && src_size > 0) || dst == NULL) {
+        fprintf(stderr, "\n[ERROR]: rle_compress_buffer() {} -> Required parameters are NULL!\n");
+        return -1;
+    }
+    if (compression_mode > adaptive) {
+        fprintf(stderr, "\n[ERROR]: rle_compress_buffer() {} -> Invalid compression mode!\n");
+        return -1;
+    }
+
+    ContainerHeader header = {CONTAINER_VERSION, compression_mode, 0, DEFAULT_BLOCK_SIZE, 0, delta_none, 0};
+    if (dst_capacity < CONTAINER_HEADER_SIZE) {
+        fprintf(stderr, "\n[ERROR]: rle_compress_buffer() {} -> Output buffer is too small!\n");
+        return -1;
+    }
+    write_container_header(dst, &header);
+
+    size_t offset = CONTAINER_HEADER_SIZE;
+    size_t processed = 0;
+    size_t block_count = 0;
+    while (processed < src_size) {
+        size_t raw_size = src_size - processed < DEFAULT_BLOCK_SIZE ? src_size - processed : DEFAULT_BLOCK_SIZE;
+        BlockHeader block_header;
+        if (dst_capacity - offset < BLOCK_HEADER_SIZE ||
+            encode_block(&src[processed], raw_size, &dst[offset + BLOCK_HEADER_SIZE],
+                         dst_capacity - offset - BLOCK_HEADER_SIZE, compression_mode, DEFAULT_ELEMENT_WIDTH, NULL, &block_header, NULL) == 0) {
+            fprintf(stderr, "\n[ERROR]: rle_compress_buffer() {} -> Output buffer is too small!\n");
+            return -1;
+        }
+        write_block_header(&dst[offset], &block_header);
+        offset += BLOCK_HEADER_SIZE + block_header.compressed_size;
+        processed += raw_size;
+        block_count++;
+    }
+
+    if (dst_capacity - offset < 1 + block_count * INDEX_ENTRY_SIZE + CONTAINER_TRAILER_SIZE) {
+        fprintf(stderr, "\n[ERROR]: rle_compress_buffer() {} -> Output buffer is too small!\n");
+        return -1;
+    }
+    dst[offset] = BLOCK_END;
+
+    // Build the index from the block headers that were just written
+    size_t index_offset = offset + 1;
+    size_t entry_offset = index_offset;
+    size_t block_offset = CONTAINER_HEADER_SIZE;
+    for (size_t i = 0; i < block_count; i++) {
+        BlockHeader block_header;
+        read_block_header(&dst[block_offset], &block_header, &header);
+        BlockIndexEntry entry = {block_offset, 0, block_header.raw_size, block_header.compressed_size};
+        write_index_entry(&dst[entry_offset], &entry);
+        entry_offset += INDEX_ENTRY_SIZE;
+        block_offset += BLOCK_HEADER_SIZE + block_header.compressed_size;
+    }
+    write_container_trailer(&dst[entry_offset], index_offset, block_count);
+    return entry_offset + CONTAINER_TRAILER_SIZE;
+}
+
+/*
+* Function: rle_get_decompressed_size
+* -----------------------------------
+*  Returns the decoded size of a block container (from its block headers)
+*  or of a legacy .rle stream (from its counter bytes).
+*
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*
+*  returns: Decoded size. If the data is corrupted (-1).
+*/
+ssize_t rle_get_decompressed_size(const unsigned char* src, size_t src_size) {
+    if (src == NULL || src_size < 1) {
+        fprintf(stderr, "\n[ERROR]: rle_get_decompressed_size() {} -> Data is corrupted!\n");
+        return -1;
+    }
+
+    if (src[0] != CONTAINER_MAGIC[0]) {
+        CompressionMode compression_mode = (CompressionMode) src[0];
+        if (compression_mode != basic && compression_mode != advance) {
+            fprintf(stderr, "\n[ERROR]: rle_get_decompressed_size() {} -> Data is corrupted!\n");
+            return -1;
+        }
+        return get_decoded_size(&src[1], src_size - 1, compression_mode);
+    }
+
+    ContainerHeader header;
+    if (src_size < CONTAINER_HEADER_SIZE || read_container_header(src, &header) == 0) {
+        return -1;
+    }
+    size_t offset = CONTAINER_HEADER_SIZE;
+    size_t decoded_size = 0;
+    BlockHeader block_header;
+    int status;
+    while ((status = next_block(src, src_size, offset, &header, &block_header)) == 1) {
+        decoded_size += block_header.raw_size;
+        offset += BLOCK_HEADER_SIZE + block_header.compressed_size;
+    }
+    if (status < 0) {
+        fprintf(stderr, "\n[ERROR]: rle_get_decompressed_size() {} -> Data is corrupted!\n");
+        return -1;
+    }
+    return decoded_size;
+}
+
+/*
+* Function: rle_get_scratch_size
+* ------------------------------
+*  Returns the scratch memory rle_decompress_buffer_with_scratch() needs
+*  for the compressed data: one block for containers split into byte planes
+*  (-P) or with Huffman coded blocks (-H), nothing otherwise.
+*
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*
+*  returns: Scratch size. If the data is corrupted (-1).
+*/
+ssize_t rle_get_scratch_size(const unsigned char* src, size_t src_size) {
+    if (src == NULL || src_size < 1) {
+        fprintf(stderr, "\n[ERROR]: rle_get_scratch_size() {} -> Data is corrupted!\n");
+        return -1;
+    }
+    if (src[0] != CONTAINER_MAGIC[0]) {
+        return 0;
+    }
+    ContainerHeader header;
+    if (src_size < CONTAINER_HEADER_SIZE || read_container_header(src, &header) == 0) {
+        return -1;
+    }
+    return header.plane_count > 1 || header.huffman ? (ssize_t) header.block_size : 0;
+}
+
+/*
+* Function: rle_decompress_buffer_with_scratch
+* --------------------------------------------
+*  Same as rle_decompress_buffer(), but the scratch memory is caller owned
+*  (e.g. kept by an RLEContext between payloads), so nothing is allocated.
+*
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (see rle_get_decompressed_size()).
+*  scratch: Pointer to the scratch memory (NULL if none is needed).
+*  scratch_size: Scratch memory size (see rle_get_scratch_size()).
+*
+*  returns: Decoded size. If failed, dst is too small or the scratch memory is (-1).
+*/
+ssize_t rle_decompress_buffer_with_scratch(const unsigned char* src, size_t src_size, unsigned char* dst,
+                                           size_t dst_capacity, unsigned char* scratch, size_t scratch_size) {
+    if (src == NULL || src_size < 1 || (dst == NULL && dst_capacity > 0)) {
+        fprintf(stderr, "\n[ERROR]: rle_decompress_buffer() {} -> Required parameters are NULL!\n");
+        return -1;
+    }
+
+    // Legacy stream: the first byte is the compression mode
+    if (src[0] != CONTAINER_MAGIC[0]) {
+        CompressionMode compression_mode = (CompressionMode) src[0];
+        RLEReader rle_reader;
+        if ((compression_mode != basic && compression_mode != advance) ||
+            init_memory_reader(&rle_reader, dst, dst_capacity, compression_mode) == 0 ||
+            read_rle_chunk(&rle_reader, &src[1], src_size - 1) < 0 || rle_reader.state != read_counter) {
+            fprintf(stderr, "\n[ERROR]: rle_decompress_buffer() {} -> Data is corrupted!\n");
+            return -1;
+        }
+        return rle_reader.buffer_pos;
+    }
+
+    ContainerHeader header;
+    if (src_size < CONTAINER_HEADER_SIZE || read_container_header(src, &header) == 0) {
+        return -1;
+    }
+    BlockFilter filter = {header.plane_count, header.delta_mode, header.delta_stride, 0, scratch};
+    if ((filter.plane_count > 1 || header.huffman) && (scratch == NULL || scratch_size < header.block_size)) {
+        fprintf(stderr, "\n[ERROR]: rle_decompress_buffer() {} -> Scratch memory is too small!\n");
+        return -1;
+    }
+    size_t offset = CONTAINER_HEADER_SIZE;
+    size_t decoded_size = 0;
+    BlockHeader block_header;
+    int status;
+    while ((status = next_block(src, src_size, offset, &header, &block_header)) == 1) {
+        if (dst_capacity - decoded_size < block_header.raw_size) {
+            fprintf(stderr, "\n[ERROR]: rle_decompress_buffer() {} -> Output buffer is too small!\n");
+            break;
+        }
+        if (decode_block(&block_header, &src[offset + BLOCK_HEADER_SIZE], &dst[decoded_size], &filter) == 0) {
+            break;
+        }
+        decoded_size += block_header.raw_size;
+        offset += BLOCK_HEADER_SIZE + block_header.compressed_size;
+    }
+    if (status < 0) {
+        fprintf(stderr, "\n[ERROR]: rle_decompress_buffer() {} -> Data is corrupted!\n");
+        return -1;
+    }
+    // Stopped on a block that did not fit or did not decode
+    if (status == 1) {
+        return -1;
+    }
+    return decoded_size;
+}
+
+/*
+* Function: rle_decompress_buffer
+* -------------------------------
+*  Decompresses a block container or a legacy .rle stream from a buffer
+*  into another buffer, without any FILE. Nothing is allocated, except one
+*  block of scratch memory for containers split into byte planes (-P) or
+*  with Huffman coded blocks (-H).
+*
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (see rle_get_decompressed_size()).
+*
+*  returns: Decoded size. If failed or dst is too small (-1).
+*/
+ssize_t rle_decompress_buffer(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_capacity) {
+    ssize_t scratch_size = rle_get_scratch_size(src, src_size);
+    if (scratch_size < 0) {
+        return -1;
+    }
+    unsigned char* scratch = NULL;
+    if (scratch_size > 0 && (scratch = malloc(scratch_size)) == NULL) {
+        fprintf(stderr, "\n[ERROR]: rle_decompress_buffer() {} -> Unable to allocate memory for the planes!\n");
+        return -1;
+    }
+    ssize_t decoded_size = rle_decompress_buffer_with_scratch(src, src_size, dst, dst_capacity, scratch, scratch_size);
+    free(scratch);
+    return decoded_size;
+}
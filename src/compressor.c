@@ -1,72 +1,1590 @@
 #include "../include/compressor.h"
+#include "../include/constants.h"
+#include "../include/container.h"
+#include "../include/io_ring.h"
+#include "../include/pipeline.h"
+#include "../include/pool.h"
 #include "../include/rle.h"
+#include "../include/simd.h"
+#include "../include/stats.h"
+#include "../include/thread_pool.h"
 #include "../include/utils.h"
 
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_IO 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    const unsigned char* input;
+    unsigned char* output;
+    size_t output_capacity;
+    CompressionMode compression_mode;
+    size_t element_width;
+    BlockFilter filter;
+    BlockHeader header;
+    RLEStats stats;
+    int result;
+} BlockJob;
+
+typedef struct {
+    BlockHeader header;
+    const unsigned char* input;
+    unsigned char* output;
+    BlockFilter filter;
+    int result;
+} DecodeJob;
 
 /*
-* Function: compress
-* ------------------
-* Compresses the input file using huffman coding
+* Function: encode_block_task
+* ---------------------------
+* Thread pool task: encodes the block of a BlockJob.
+*/
+static void encode_block_task(void* arg) {
+    BlockJob* job = arg;
+    job->result = encode_block(job->input, job->header.raw_size, job->output, job->output_capacity,
+                               job->compression_mode, job->element_width, &job->filter, &job->header, &job->stats);
+}
+
+/*
+* Function: decode_block_task
+* ---------------------------
+* Thread pool task: decodes the block of a DecodeJob into its own region
+* of the output.
+*/
+static void decode_block_task(void* arg) {
+    DecodeJob* job = arg;
+    job->result = decode_block(&job->header, job->input, job->output, &job->filter);
+}
+
+/*
+* Function: acquire_pool
+* ----------------------
+* Returns the shared pool of the options, or starts own_pool with
+* options->thread_count workers when there is none.
 *
-* input_file: Pointer to the input_file
+* returns: Pointer to the pool. If failed (NULL).
+*/
+static ThreadPool* acquire_pool(const CompressorOptions* options, ThreadPool* own_pool) {
+    if (options->pool != NULL) {
+        return options->pool;
+    }
+    return init_thread_pool(own_pool, options->thread_count) ? own_pool : NULL;
+}
+
+/*
+* Function: release_pool
+* ----------------------
+* Stops the pool if it was started by acquire_pool().
+*/
+static void release_pool(ThreadPool* pool, ThreadPool* own_pool) {
+    if (pool == own_pool) {
+        free_thread_pool(own_pool);
+    }
+}
+
+/*
+* Function: alloc_io_buffer
+* -------------------------
+* Allocates a codec buffer aligned to IO_BUFFER_ALIGNMENT, so io_uring
+* requests on it pin whole pages.
+*
+* returns: Pointer to the buffer. If failed (NULL).
+*/
+static unsigned char* alloc_io_buffer(size_t size) {
+#ifdef MAPPED_IO
+    void* buffer = NULL;
+    return posix_memalign(&buffer, IO_BUFFER_ALIGNMENT, size) == 0 ? buffer : NULL;
+#else
+    return malloc(size);
+#endif
+}
+
+/*
+* Function: acquire_codec_buffer
+* ------------------------------
+* Takes a codec buffer from the shared buffer pool of the options, or
+* allocates it with alloc_io_buffer() when there is none.
+*
+* returns: Pointer to the buffer. If failed (NULL).
+*/
+static unsigned char* acquire_codec_buffer(const CompressorOptions* options, size_t size) {
+    if (options->buffer_pool != NULL) {
+        return acquire_buffer(options->buffer_pool, size);
+    }
+    return alloc_io_buffer(size);
+}
+
+/*
+* Function: release_codec_buffer
+* ------------------------------
+* Gives a buffer of acquire_codec_buffer() back to the shared buffer pool,
+* or frees it when there is none.
+*/
+static void release_codec_buffer(const CompressorOptions* options, unsigned char* buffer, size_t size) {
+    if (options->buffer_pool != NULL) {
+        release_buffer(options->buffer_pool, buffer, size);
+    } else {
+        free(buffer);
+    }
+}
+
+/*
+* Function: open_io_ring
+* ----------------------
+* Sets up an io_uring instance for a regular file and registers the codec
+* buffers its requests use. Pipes, terminals, stdout and append-only
+* outputs cannot be written at offsets, so they keep the stdio path, as
+* does everything when io_uring is not available.
+*
+* ring: Pointer to the IORing to set up.
+* file: Pointer to the file the requests go to.
+* writing: Requests write to the file.
+* buffers: count buffers of buffer_size bytes, one after the other.
+*
+* returns: Pointer to the ring. If the file keeps the stdio path (NULL).
+*/
+static IORing* open_io_ring(IORing* ring, FILE* file, int writing, unsigned char* buffers, size_t buffer_size,
+                            size_t count) {
+#ifdef MAPPED_IO
+    if (!is_regular_file(file) || (writing && (file == stdout || (fcntl(fileno(file), F_GETFL) & O_APPEND) != 0))) {
+        return NULL;
+    }
+    if (!init_io_ring(ring, IO_RING_ENTRIES)) {
+        return NULL;
+    }
+    // Unregistered buffers still work, they are only pinned on every request
+    register_io_buffers(ring, buffers, buffer_size, count);
+    return ring;
+#else
+    (void) ring;
+    (void) file;
+    (void) writing;
+    (void) buffers;
+    (void) buffer_size;
+    (void) count;
+    return NULL;
+#endif
+}
+
+/*
+* Function: close_io_ring
+* -----------------------
+* Frees a ring opened by open_io_ring() (NULL is ignored).
+*/
+static void close_io_ring(IORing* ring) {
+    if (ring != NULL) {
+        free_io_ring(ring);
+    }
+}
+
+/*
+* Function: fit_io_size
+* ---------------------
+* Rounds a buffer size down to whole I/O blocks (at least one).
+*/
+static size_t fit_io_size(size_t size, size_t io_block_size) {
+    size -= size % io_block_size;
+    return size > io_block_size ? size : io_block_size;
+}
+
+/*
+* Function: choose_buffer_sizes
+* -----------------------------
+* Resolves the reader buffer (output buffer) and chunk sizes of a legacy
+* stream decode: the sizes set in the options, or, where they are 0, sizes
+* that keep the chunk and the decoded buffer in the L2 cache together (a
+* quarter and a half of it), in whole st_blksize blocks of their file. A
+* chunk is never larger than a regular input file.
+*/
+static void choose_buffer_sizes(const CompressorOptions* options, FILE* input_file, FILE* output_file,
+                                size_t* buffer_size, size_t* chunk_size) {
+    size_t l2_cache_size = options->buffer_size == 0 || options->chunk_size == 0 ? get_l2_cache_size() : 0;
+    *buffer_size = options->buffer_size;
+    if (*buffer_size == 0) {
+        *buffer_size = fit_io_size(l2_cache_size / 2, get_io_block_size(output_file));
+    }
+    *chunk_size = options->chunk_size;
+    if (*chunk_size == 0) {
+        size_t io_block_size = get_io_block_size(input_file);
+        *chunk_size = fit_io_size(l2_cache_size / 4, io_block_size);
+        if (is_regular_file(input_file)) {
+            size_t input_size = get_file_size(input_file);
+            size_t input_blocks = fit_io_size(input_size + io_block_size - 1, io_block_size);
+            *chunk_size = input_blocks < *chunk_size ? input_blocks : *chunk_size;
+        }
+    }
+    *buffer_size = *buffer_size < MAX_BUFFER_SIZE ? *buffer_size : MAX_BUFFER_SIZE;
+    *chunk_size = *chunk_size < MAX_BUFFER_SIZE ? *chunk_size : MAX_BUFFER_SIZE;
+}
+
+/*
+* Function: finish_stats
+* ----------------------
+* Sets the sizes and the wall clock time of a finished job, prints the
+* summary and copies the stats to options->stats when it is set.
+*/
+static void finish_stats(RLEStats* stats, double start_time, size_t input_size, size_t output_size, int show_rate,
+                         const CompressorOptions* options) {
+    stats->bytes_in = input_size;
+    stats->bytes_out = output_size;
+    stats->total_time = get_wall_time() - start_time;
+    if (options->quiet) {
+        // Batch mode prints a summary of its own
+    } else if (show_rate) {
+        double compression_rate = input_size > 0 ? ((double) output_size - input_size) / input_size * 100 : 0;
+        printf("\rFinished processing (%f s): %zu bytes -> %zu bytes (%+.2f%%)\n", stats->total_time, input_size,
+               output_size, compression_rate);
+    } else {
+        printf("\rFinished Processing (%f s): %zu bytes -> %zu bytes\n", stats->total_time, input_size, output_size);
+    }
+    if (options->stats != NULL) {
+        *options->stats = *stats;
+    }
+}
+
+typedef struct {
+    FILE* input_file;
+    const unsigned char* input_map;  // Mapped input, or NULL
+    size_t input_size;
+    FILE* output_file;
+    const CompressorOptions* options;
+    ContainerHeader header;
+    ThreadPool* pool;
+    size_t job_count;                // Blocks in every slot
+    size_t buffer_size;              // Input and scratch buffer size of a block
+    size_t block_bound;
+    size_t output_stride;            // Block header and encoded block size
+    BlockJob* jobs;                  // job_count jobs for every slot
+    size_t* batch_sizes;             // Blocks read into every slot
+    unsigned char* input_buffers;    // job_count blocks for every slot (unless mapped)
+    unsigned char* output_buffers;   // job_count block headers and encoded blocks for every slot
+    unsigned char* filter_buffers;   // Scratch memory of the slot being encoded
+    IORing* input_ring;              // Reader: io_uring instance of the input, or NULL (stdio)
+    IORequest* read_requests;        // Reader: job_count requests
+    uint64_t input_offset;           // Reader: file offset of the first block (io_uring)
+    uint64_t input_end;              // Reader: file size (io_uring)
+    size_t read_ring_requests;       // Reader: io_uring reads (added to stats once the stages are joined)
+    size_t processed;                // Reader: bytes read
+    int done;                        // Reader: end of the input
+    IORing* output_ring;             // Writer: io_uring instance of the output, or NULL (stdio)
+    IORequest* write_requests;       // Writer: job_count requests
+    uint64_t output_offset;          // Writer: file offset of the container (io_uring)
+    size_t write_ring_requests;      // Writer: io_uring writes (added to stats once the stages are joined)
+    size_t written;                  // Writer: bytes written out as blocks
+    uint64_t offset;                 // Writer: output offset of the next block
+    BlockIndex index;                // Writer: blocks written so far
+    RLEStats stats;
+} EncodePipeline;
+
+/*
+* Function: read_encode_ring
+* --------------------------
+* Reads up to a batch of blocks into a slot with io_uring requests that
+* are all in flight at once. Blocks past the end of the file (as it was
+* when the pipeline started) are not requested, but one is still sent at
+* the end, so a file that grew is read on.
+*
+* returns: Number of requests (their results are the block sizes). If failed (SIZE_MAX).
+*/
+static size_t read_encode_ring(EncodePipeline* pipeline, size_t slot) {
+    size_t block_size = pipeline->header.block_size;
+    uint64_t offset = pipeline->input_offset + pipeline->processed;
+    uint64_t remaining = pipeline->input_end > offset ? pipeline->input_end - offset : 0;
+    size_t count = remaining / block_size + (remaining % block_size != 0);
+    count = count < 1 ? 1 : count > pipeline->job_count ? pipeline->job_count : count;
+    for (size_t i = 0; i < count; i++) {
+        size_t index = slot * pipeline->job_count + i;
+        IORequest request = {0, fileno(pipeline->input_file), &pipeline->input_buffers[index * pipeline->buffer_size],
+                             block_size, offset + (uint64_t) i * block_size, (int) index, 0};
+        pipeline->read_requests[i] = request;
+    }
+    pipeline->read_ring_requests += count;
+    if (!run_io_requests(pipeline->input_ring, pipeline->read_requests, count)) {
+        err("compress_blocks", "Unable to read the input file!");
+        return SIZE_MAX;
+    }
+    return count;
+}
+
+/*
+* Function: read_encode_slot
+* --------------------------
+* Pipeline read stage: reads (or maps) a batch of blocks into a slot.
+*/
+static int read_encode_slot(void* context, size_t slot) {
+    EncodePipeline* pipeline = context;
+    size_t block_size = pipeline->header.block_size;
+    BlockJob* jobs = &pipeline->jobs[slot * pipeline->job_count];
+    size_t batch = 0;
+    size_t ring_count = 0;
+    double read_start = get_wall_time();
+    if (pipeline->input_ring != NULL && !pipeline->done) {
+        ring_count = read_encode_ring(pipeline, slot);
+        if (ring_count == SIZE_MAX) {
+            return -1;
+        }
+    }
+    while (batch < pipeline->job_count && !pipeline->done) {
+        BlockJob* job = &jobs[batch];
+        size_t raw_size = 0;
+        if (pipeline->input_map != NULL) {
+            size_t remaining = pipeline->input_size - pipeline->processed;
+            raw_size = remaining < block_size ? remaining : block_size;
+            job->input = &pipeline->input_map[pipeline->processed];
+        } else {
+            unsigned char* input = &pipeline->input_buffers[(slot * pipeline->job_count + batch) * pipeline->buffer_size];
+            if (pipeline->input_ring != NULL) {
+                raw_size = batch < ring_count ? (size_t) pipeline->read_requests[batch].result : 0;
+            } else {
+                raw_size = fread(input, sizeof(unsigned char), block_size, pipeline->input_file);
+                if (ferror(pipeline->input_file)) {
+                    err("compress_blocks", "Unable to read the input file!");
+                    return -1;
+                }
+            }
+            job->input = input;
+        }
+        pipeline->processed += raw_size;
+        if (raw_size < block_size) {
+            pipeline->done = 1;
+        }
+        if (raw_size == 0) {
+            break;
+        }
+
+        // The block header goes right in front of the encoded block, so both are written at once
+        job->output = &pipeline->output_buffers[(slot * pipeline->job_count + batch) * pipeline->output_stride +
+                                                BLOCK_HEADER_SIZE];
+        job->output_capacity = pipeline->block_bound;
+        job->compression_mode = pipeline->options->compression_mode;
+        job->element_width = pipeline->options->element_width;
+        job->filter.plane_count = pipeline->header.plane_count;
+        job->filter.delta_mode = pipeline->header.delta_mode;
+        job->filter.delta_stride = pipeline->header.delta_stride;
+        job->filter.huffman = pipeline->header.huffman;
+        job->header.raw_size = raw_size;
+        batch++;
+    }
+    pipeline->stats.read_time += get_wall_time() - read_start;
+    pipeline->batch_sizes[slot] = batch;
+    return batch > 0;
+}
+
+/*
+* Function: encode_slot
+* ---------------------
+* Pipeline code stage: encodes the blocks of a slot on the thread pool.
+*/
+static int encode_slot(void* context, size_t slot) {
+    EncodePipeline* pipeline = context;
+    BlockJob* jobs = &pipeline->jobs[slot * pipeline->job_count];
+    TaskGroup group = {0};
+    int result = 1;
+    double codec_start = get_wall_time();
+    for (size_t i = 0; result && i < pipeline->batch_sizes[slot]; i++) {
+        BlockJob* job = &jobs[i];
+        job->filter.scratch = pipeline->filter_buffers != NULL ? &pipeline->filter_buffers[i * pipeline->buffer_size]
+                                                               : NULL;
+        job->result = 0;
+        init_stats(&job->stats);
+        result = submit_group_task(pipeline->pool, &group, encode_block_task, job);
+    }
+    wait_task_group(pipeline->pool, &group);
+    pipeline->stats.codec_time += get_wall_time() - codec_start;
+    return result ? 1 : -1;
+}
+
+/*
+* Function: write_encode_slot
+* ---------------------------
+* Pipeline write stage: writes the encoded blocks of a slot in order and
+* adds them to the block index. With io_uring, every block is written at
+* its own offset and the whole slot is in flight at once.
+*/
+static int write_encode_slot(void* context, size_t slot) {
+    EncodePipeline* pipeline = context;
+    BlockJob* jobs = &pipeline->jobs[slot * pipeline->job_count];
+    size_t count = pipeline->batch_sizes[slot];
+    int result = 1;
+    double write_start = get_wall_time();
+    for (size_t i = 0; i < count; i++) {
+        BlockJob* job = &jobs[i];
+        merge_stats(&pipeline->stats, &job->stats);
+        unsigned char* block = job->output - BLOCK_HEADER_SIZE;
+        size_t block_size = BLOCK_HEADER_SIZE + job->header.compressed_size;
+        write_block_header(block, &job->header);
+        if (!job->result || !add_index_entry(&pipeline->index, pipeline->offset, &job->header)) {
+            err("compress_blocks", "Unable to write the block!");
+            result = 0;
+            break;
+        }
+        if (pipeline->output_ring != NULL) {
+            IORequest request = {1, fileno(pipeline->output_file), block, block_size,
+                                 pipeline->output_offset + pipeline->offset, (int) (slot * pipeline->job_count + i), 0};
+            pipeline->write_requests[i] = request;
+        } else if (fwrite(block, sizeof(unsigned char), block_size, pipeline->output_file) < block_size) {
+            err("compress_blocks", "Unable to write the block!");
+            result = 0;
+            break;
+        } else {
+            pipeline->stats.output_writes++;
+        }
+        pipeline->offset += block_size;
+        pipeline->written += job->header.raw_size;
+    }
+    if (result && pipeline->output_ring != NULL) {
+        pipeline->write_ring_requests += count;
+        if (!run_io_requests(pipeline->output_ring, pipeline->write_requests, count)) {
+            err("compress_blocks", "Unable to write the block!");
+            result = 0;
+        }
+    }
+    pipeline->stats.write_time += get_wall_time() - write_start;
+    if (!pipeline->options->quiet) {
+        printf("\rProcessing: %zu bytes...", pipeline->written);
+    }
+    return result ? 1 : -1;
+}
+
+/*
+* Function: compress_blocks
+* -------------------------
+* Writes a block container. Blocks are read from input_file (or taken from
+* input_map when it is not NULL), encoded in batches on a thread pool and
+* written to output_file in order. Reading, encoding and writing run at the
+* same time on a ring of PIPELINE_SLOTS batches (see run_pipeline()). A
+* mapped input that fits in one batch is encoded without the ring. With
+* options->io_uring, the batches of regular files are read and written
+* through io_uring (see open_io_ring()).
+*
+* input_file: Pointer to the input_file (unused if input_map is set)
+* input_map: Pointer to the mapped input, or NULL
+* input_size: Size of the mapped input
 * output_file: Pointer to the output_file
-* writer_buffer_size: RLEWriter buffer (output buffer) size 
-* compressor_buffer_size: Compressor input buffer size
-* compression_mode: "basic" or "advance" algorithm
+* options: Compression mode, block size and thread count
 *
 * returns: If failed (0), On success (1)
 */
-int compress(FILE* input_file, FILE* output_file, size_t writer_buffer_size, size_t compressor_buffer_size,
-             CompressionMode compression_mode) {    
-    if (input_file == NULL || output_file == NULL) {
-        err("compress", "Input/output file is NULL!");
+static int compress_blocks(FILE* input_file, const unsigned char* input_map, size_t input_size, FILE* output_file,
+                           const CompressorOptions* options) {
+    size_t block_size = options->block_size;
+    if (block_size == 0 || block_size > MAX_BLOCK_SIZE) {
+        err("compress_blocks", "Invalid block size!");
+        return 0;
+    }
+    size_t element_width = options->element_width;
+    if ((options->compression_mode == pattern || options->compression_mode == adaptive) &&
+        (element_width < 2 || element_width > MAX_ELEMENT_WIDTH)) {
+        err("compress_blocks", "Invalid element width!");
+        return 0;
+    }
+    size_t plane_count = options->plane_count;
+    if (plane_count > MAX_PLANE_COUNT) {
+        err("compress_blocks", "Invalid plane count!");
+        return 0;
+    }
+    if (options->delta_mode > delta_xor ||
+        (options->delta_mode != delta_none && (options->delta_stride == 0 || options->delta_stride > UINT32_MAX))) {
+        err("compress_blocks", "Invalid delta filter!");
+        return 0;
+    }
+    int filtered = plane_count > 1 || options->delta_mode != delta_none || options->huffman;
+
+    // Keep every block aligned to whole elements and whole plane strides
+    size_t alignment = options->compression_mode == pattern || options->compression_mode == adaptive ? element_width : 1;
+    size_t block_alignment = alignment;
+    while (plane_count > 1 && block_alignment % plane_count != 0) {
+        block_alignment += alignment;
+    }
+    block_size -= block_size % block_alignment;
+    if (block_size == 0) {
+        block_size = block_alignment;
+    }
+
+    ThreadPool own_pool;
+    ThreadPool* pool = acquire_pool(options, &own_pool);
+    if (pool == NULL) {
+        return 0;
+    }
+
+    EncodePipeline pipeline = {0};
+    pipeline.input_file = input_file;
+    pipeline.input_map = input_map;
+    pipeline.input_size = input_size;
+    pipeline.output_file = output_file;
+    pipeline.options = options;
+    pipeline.pool = pool;
+    pipeline.job_count = pool->thread_count * BLOCKS_PER_THREAD;
+    pipeline.buffer_size = block_size;
+    size_t slot_count = PIPELINE_SLOTS;
+    if (input_map != NULL && input_size <= pipeline.job_count * block_size) {
+        // Small mapped inputs (e.g. in batch mode) only get the buffers their blocks need
+        pipeline.job_count = input_size > 0 ? (input_size + block_size - 1) / block_size : 1;
+        pipeline.buffer_size = input_size >= block_size ? block_size : input_size > 0 ? input_size : 1;
+        slot_count = 1;
+    }
+    pipeline.block_bound = get_block_bound(pipeline.buffer_size, CONTAINER_VERSION);
+    pipeline.output_stride = BLOCK_HEADER_SIZE + pipeline.block_bound;
+    size_t slot_blocks = slot_count * pipeline.job_count;
+    pipeline.jobs = calloc(slot_blocks, sizeof(BlockJob));
+    pipeline.batch_sizes = calloc(slot_count, sizeof(size_t));
+    pipeline.input_buffers = input_map == NULL ? acquire_codec_buffer(options, slot_blocks * pipeline.buffer_size) : NULL;
+    pipeline.output_buffers = acquire_codec_buffer(options, slot_blocks * pipeline.output_stride);
+    pipeline.filter_buffers = filtered ? acquire_codec_buffer(options, pipeline.job_count * pipeline.buffer_size) : NULL;
+    pipeline.read_requests = options->io_uring ? calloc(pipeline.job_count, sizeof(IORequest)) : NULL;
+    pipeline.write_requests = options->io_uring ? calloc(pipeline.job_count, sizeof(IORequest)) : NULL;
+    int result = pipeline.jobs != NULL && pipeline.batch_sizes != NULL &&
+                 (input_map != NULL || pipeline.input_buffers != NULL) && pipeline.output_buffers != NULL &&
+                 (!filtered || pipeline.filter_buffers != NULL) &&
+                 (!options->io_uring || (pipeline.read_requests != NULL && pipeline.write_requests != NULL));
+    if (!result) {
+        err("compress_blocks", "Unable to allocate memory for the blocks!");
+    }
+
+    IORing input_ring;
+    IORing output_ring;
+    if (result && options->io_uring) {
+        long input_offset = input_map == NULL ? ftell(input_file) : -1;
+        long output_offset = ftell(output_file);
+        if (input_offset >= 0) {
+            pipeline.input_ring = open_io_ring(&input_ring, input_file, 0, pipeline.input_buffers,
+                                               pipeline.buffer_size, slot_blocks);
+            pipeline.input_offset = (uint64_t) input_offset;
+            pipeline.input_end = pipeline.input_ring != NULL ? get_file_size(input_file) : 0;
+        }
+        if (output_offset >= 0) {
+            pipeline.output_ring = open_io_ring(&output_ring, output_file, 1, pipeline.output_buffers,
+                                                pipeline.output_stride, slot_blocks);
+            pipeline.output_offset = (uint64_t) output_offset;
+        }
+    }
+
+    init_stats(&pipeline.stats);
+    double start_time = get_wall_time();
+    unsigned char header_bytes[CONTAINER_HEADER_SIZE];
+    ContainerHeader header = {CONTAINER_VERSION, options->compression_mode, options->huffman != 0, block_size,
+                              (unsigned char) plane_count, options->delta_mode,
+                              options->delta_mode != delta_none ? options->delta_stride : 0};
+    pipeline.header = header;
+    write_container_header(header_bytes, &header);
+    if (result && fwrite(header_bytes, sizeof(unsigned char), CONTAINER_HEADER_SIZE, output_file) < CONTAINER_HEADER_SIZE) {
+        err("compress_blocks", "Unable to write the container header!");
+        result = 0;
+    }
+    // The blocks written through io_uring go after the header in the file, not in the stdio buffer
+    if (result && pipeline.output_ring != NULL && fflush(output_file) != 0) {
+        err("compress_blocks", "Unable to write the container header!");
+        result = 0;
+    }
+
+    pipeline.offset = CONTAINER_HEADER_SIZE;
+    Pipeline stages = {read_encode_slot, encode_slot, write_encode_slot, &pipeline, slot_count};
+    result = result && run_pipeline(&stages);
+    // The reader and the writer count their own requests, so they never write the same field
+    pipeline.stats.ring_requests += pipeline.read_ring_requests + pipeline.write_ring_requests;
+
+    RLEStats* stats = &pipeline.stats;
+    if (result && pipeline.output_ring != NULL &&
+        fseek(output_file, (long) (pipeline.output_offset + pipeline.offset), SEEK_SET) != 0) {
+        err("compress_blocks", "Unable to write the block index!");
+        result = 0;
+    }
+    if (result) {
+        double write_start = get_wall_time();
+        result = write_container_end(output_file, &pipeline.index, pipeline.offset);
+        stats->write_time += get_wall_time() - write_start;
+        stats->output_writes++;
+        pipeline.offset += 1 + pipeline.index.block_count * INDEX_ENTRY_SIZE + CONTAINER_TRAILER_SIZE;
+    }
+    if (result) {
+        finish_stats(stats, start_time, pipeline.processed, pipeline.offset, 1, options);
+    }
+
+    release_pool(pool, &own_pool);
+    close_io_ring(pipeline.input_ring);
+    close_io_ring(pipeline.output_ring);
+    free_block_index(&pipeline.index);
+    free(pipeline.jobs);
+    free(pipeline.batch_sizes);
+    release_codec_buffer(options, pipeline.input_buffers, slot_blocks * pipeline.buffer_size);
+    release_codec_buffer(options, pipeline.output_buffers, slot_blocks * pipeline.output_stride);
+    release_codec_buffer(options, pipeline.filter_buffers, pipeline.job_count * pipeline.buffer_size);
+    free(pipeline.read_requests);
+    free(pipeline.write_requests);
+    return result;
+}
+
+typedef struct {
+    FILE* input_file;
+    FILE* output_file;
+    const CompressorOptions* options;
+    ContainerHeader header;
+    ThreadPool* pool;
+    size_t job_count;                  // Blocks in every slot
+    size_t block_bound;
+    size_t compressed_stride;          // Block header and encoded block size
+    DecodeJob* jobs;                   // job_count jobs for every slot
+    size_t* batch_sizes;               // Blocks read into every slot
+    unsigned char* raw_buffers;        // job_count decoded blocks for every slot
+    unsigned char* compressed_buffers; // job_count block headers and encoded blocks for every slot
+    unsigned char* filter_buffers;     // Scratch memory of the slot being decoded
+    IORing* input_ring;                // Reader: io_uring instance of the input, or NULL (stdio)
+    IORequest* read_requests;          // Reader: job_count requests
+    BlockIndex index;                  // Reader: blocks of the container (io_uring)
+    size_t next_block;                 // Reader: index entry of the next block (io_uring)
+    size_t read_ring_requests;         // Reader: io_uring reads (added to stats once the stages are joined)
+    size_t processed;                  // Reader: bytes read
+    int done;                          // Reader: end of the blocks
+    IORing* output_ring;               // Writer: io_uring instance of the output, or NULL (stdio)
+    IORequest* write_requests;         // Writer: job_count requests
+    uint64_t output_offset;            // Writer: file offset of the decoded data (io_uring)
+    size_t write_ring_requests;        // Writer: io_uring writes (added to stats once the stages are joined)
+    size_t decoded;                    // Writer: bytes written
+    RLEStats stats;
+} DecodePipeline;
+
+/*
+* Function: read_decode_ring
+* --------------------------
+* Reads the next batch of blocks of the block index into a slot with
+* io_uring requests that are all in flight at once, header and encoded
+* block in one read each.
+*
+* returns: Number of blocks read. If failed (SIZE_MAX).
+*/
+static size_t read_decode_ring(DecodePipeline* pipeline, size_t slot) {
+    size_t remaining = pipeline->index.block_count - pipeline->next_block;
+    size_t count = remaining < pipeline->job_count ? remaining : pipeline->job_count;
+    for (size_t i = 0; i < count; i++) {
+        const BlockIndexEntry* entry = &pipeline->index.entries[pipeline->next_block + i];
+        size_t index = slot * pipeline->job_count + i;
+        IORequest request = {0, fileno(pipeline->input_file), &pipeline->compressed_buffers[index * pipeline->compressed_stride],
+                             BLOCK_HEADER_SIZE + (size_t) entry->compressed_size, entry->offset, (int) index, 0};
+        pipeline->read_requests[i] = request;
+    }
+    pipeline->read_ring_requests += count;
+    if (!run_io_requests(pipeline->input_ring, pipeline->read_requests, count)) {
+        err("decompress_blocks", "Unable to read the input file!");
+        return SIZE_MAX;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if ((size_t) pipeline->read_requests[i].result < pipeline->read_requests[i].size) {
+            fprintf(stderr, "\n[ERROR]: decompress() {} -> File is truncated!\n");
+            return SIZE_MAX;
+        }
+    }
+    pipeline->next_block += count;
+    return count;
+}
+
+/*
+* Function: read_decode_slot
+* --------------------------
+* Pipeline read stage: reads a batch of encoded blocks into a slot.
+*/
+static int read_decode_slot(void* context, size_t slot) {
+    DecodePipeline* pipeline = context;
+    ContainerHeader* header = &pipeline->header;
+    DecodeJob* jobs = &pipeline->jobs[slot * pipeline->job_count];
+    int result = 1;
+    size_t batch = 0;
+    size_t ring_count = 0;
+    double read_start = get_wall_time();
+    if (pipeline->input_ring != NULL) {
+        ring_count = read_decode_ring(pipeline, slot);
+        if (ring_count == SIZE_MAX) {
+            return -1;
+        }
+    }
+    while (batch < pipeline->job_count && !pipeline->done) {
+        DecodeJob* job = &jobs[batch];
+        size_t index = slot * pipeline->job_count + batch;
+        unsigned char* block_header_bytes = &pipeline->compressed_buffers[index * pipeline->compressed_stride];
+        unsigned char* compressed = &block_header_bytes[BLOCK_HEADER_SIZE];
+        if (pipeline->input_ring != NULL) {
+            if (batch == ring_count) {
+                pipeline->done = 1;  // A short batch holds the last blocks of the index
+                break;
+            }
+            // The index sizes were checked when it was loaded, the header has to agree with them
+            const BlockIndexEntry* entry = &pipeline->index.entries[pipeline->next_block - ring_count + batch];
+            if (read_block_header(block_header_bytes, &job->header, header) == 0 ||
+                job->header.raw_size != entry->raw_size || job->header.compressed_size != entry->compressed_size) {
+                fprintf(stderr, "\n[ERROR]: decompress() {} -> File is corrupted!\n");
+                result = 0;
+                break;
+            }
+        } else if (fread(block_header_bytes, sizeof(unsigned char), 1, pipeline->input_file) < 1) {
+            fprintf(stderr, "\n[ERROR]: decompress() {} -> File is truncated!\n");
+            result = 0;
+            break;
+        } else if (block_header_bytes[0] == BLOCK_END) {
+            pipeline->done = 1;
+            break;
+        } else if (fread(&block_header_bytes[1], sizeof(unsigned char), BLOCK_HEADER_SIZE - 1, pipeline->input_file) < BLOCK_HEADER_SIZE - 1 ||
+                   read_block_header(block_header_bytes, &job->header, header) == 0 ||
+                   fread(compressed, sizeof(unsigned char), job->header.compressed_size, pipeline->input_file) < job->header.compressed_size) {
+            fprintf(stderr, "\n[ERROR]: decompress() {} -> File is corrupted!\n");
+            result = 0;
+            break;
+        }
+        job->input = compressed;
+        job->output = &pipeline->raw_buffers[index * header->block_size];
+        job->filter.plane_count = header->plane_count;
+        job->filter.delta_mode = header->delta_mode;
+        job->filter.delta_stride = header->delta_stride;
+        job->filter.huffman = 0;
+        pipeline->processed += BLOCK_HEADER_SIZE + job->header.compressed_size;
+        batch++;
+    }
+    pipeline->stats.read_time += get_wall_time() - read_start;
+    pipeline->batch_sizes[slot] = batch;
+    return result ? batch > 0 : -1;
+}
+
+/*
+* Function: decode_slot
+* ---------------------
+* Pipeline code stage: decodes the blocks of a slot on the thread pool
+* into their own output slots.
+*/
+static int decode_slot(void* context, size_t slot) {
+    DecodePipeline* pipeline = context;
+    DecodeJob* jobs = &pipeline->jobs[slot * pipeline->job_count];
+    TaskGroup group = {0};
+    int result = 1;
+    double codec_start = get_wall_time();
+    for (size_t i = 0; result && i < pipeline->batch_sizes[slot]; i++) {
+        DecodeJob* job = &jobs[i];
+        job->filter.scratch = pipeline->filter_buffers != NULL ? &pipeline->filter_buffers[i * pipeline->header.block_size]
+                                                               : NULL;
+        job->result = 0;
+        result = submit_group_task(pipeline->pool, &group, decode_block_task, job);
+    }
+    wait_task_group(pipeline->pool, &group);
+    pipeline->stats.codec_time += get_wall_time() - codec_start;
+    return result ? 1 : -1;
+}
+
+/*
+* Function: write_decode_slot
+* ---------------------------
+* Pipeline write stage: writes the decoded blocks of a slot in order. With
+* io_uring, every block is written at its own offset and the whole slot is
+* in flight at once.
+*/
+static int write_decode_slot(void* context, size_t slot) {
+    DecodePipeline* pipeline = context;
+    DecodeJob* jobs = &pipeline->jobs[slot * pipeline->job_count];
+    size_t count = pipeline->batch_sizes[slot];
+    int result = 1;
+    double write_start = get_wall_time();
+    for (size_t i = 0; result && i < count; i++) {
+        DecodeJob* job = &jobs[i];
+        if (!job->result) {
+            fprintf(stderr, "\n[ERROR]: decompress() {} -> File is corrupted!\n");
+            result = 0;
+        } else if (pipeline->output_ring != NULL) {
+            IORequest request = {1, fileno(pipeline->output_file), job->output, job->header.raw_size,
+                                 pipeline->output_offset + pipeline->decoded, (int) (slot * pipeline->job_count + i), 0};
+            pipeline->write_requests[i] = request;
+        } else if (fwrite(job->output, sizeof(unsigned char), job->header.raw_size, pipeline->output_file) < job->header.raw_size) {
+            err("decompress_blocks", "Unable to write the output file!");
+            result = 0;
+        } else {
+            pipeline->stats.output_writes++;
+        }
+        pipeline->decoded += job->header.raw_size;
+    }
+    if (result && pipeline->output_ring != NULL) {
+        pipeline->write_ring_requests += count;
+        if (!run_io_requests(pipeline->output_ring, pipeline->write_requests, count)) {
+            err("decompress_blocks", "Unable to write the output file!");
+            result = 0;
+        }
+    }
+    pipeline->stats.write_time += get_wall_time() - write_start;
+    if (!pipeline->options->quiet) {
+        printf("\rProcessing: %zu bytes...", pipeline->decoded);
+    }
+    return result ? 1 : -1;
+}
+
+/*
+* Function: decompress_blocks
+* ---------------------------
+* Decodes a block container from a stream. Batches of blocks are read in
+* order, decoded in parallel on a thread pool into their own output slots,
+* and written in order. Reading, decoding and writing run at the same time
+* on a ring of PIPELINE_SLOTS batches (see run_pipeline()). With
+* options->io_uring, the batches of regular files are read and written
+* through io_uring (see open_io_ring()).
+*
+* input_file: Pointer to the input_file, positioned after the first byte
+* output_file: Pointer to the output_file
+* first_byte: The first byte of the file (already read)
+* options: Thread count
+*
+* returns: If failed (0), On success (1)
+*/
+static int decompress_blocks(FILE* input_file, FILE* output_file, unsigned char first_byte,
+                             const CompressorOptions* options) {
+    unsigned char header_bytes[CONTAINER_HEADER_SIZE];
+    ContainerHeader header;
+    header_bytes[0] = first_byte;
+    if (fread(&header_bytes[1], sizeof(unsigned char), CONTAINER_HEADER_SIZE - 1, input_file) < CONTAINER_HEADER_SIZE - 1 ||
+        read_container_header(header_bytes, &header) == 0) {
+        fprintf(stderr, "\n[ERROR]: decompress() {} -> File is corrupted!\n");
         return 0;
     }
 
-    RLEWriter rle_writer;
-    int error = init_writer(&rle_writer, output_file, writer_buffer_size, compression_mode);
-    if (error == 0) {
-        err("compress", "Unable to initiate RLEWriter");
+    ThreadPool own_pool;
+    ThreadPool* pool = acquire_pool(options, &own_pool);
+    if (pool == NULL) {
         return 0;
     }
 
-    int result = encode(input_file, &rle_writer, compressor_buffer_size);
+    DecodePipeline pipeline = {0};
+    pipeline.input_file = input_file;
+    pipeline.output_file = output_file;
+    pipeline.options = options;
+    pipeline.header = header;
+    pipeline.pool = pool;
+    pipeline.job_count = pool->thread_count * BLOCKS_PER_THREAD;
+    pipeline.block_bound = get_block_bound(header.block_size, header.version);
+    pipeline.compressed_stride = BLOCK_HEADER_SIZE + pipeline.block_bound;
+    size_t slot_blocks = PIPELINE_SLOTS * pipeline.job_count;
+    pipeline.jobs = calloc(slot_blocks, sizeof(DecodeJob));
+    pipeline.batch_sizes = calloc(PIPELINE_SLOTS, sizeof(size_t));
+    pipeline.raw_buffers = acquire_codec_buffer(options, slot_blocks * header.block_size);
+    pipeline.compressed_buffers = acquire_codec_buffer(options, slot_blocks * pipeline.compressed_stride);
+    int filtered = header.plane_count > 1 || header.huffman;
+    pipeline.filter_buffers = filtered ? acquire_codec_buffer(options, pipeline.job_count * header.block_size) : NULL;
+    pipeline.read_requests = options->io_uring ? calloc(pipeline.job_count, sizeof(IORequest)) : NULL;
+    pipeline.write_requests = options->io_uring ? calloc(pipeline.job_count, sizeof(IORequest)) : NULL;
+    int result = pipeline.jobs != NULL && pipeline.batch_sizes != NULL && pipeline.raw_buffers != NULL &&
+                 pipeline.compressed_buffers != NULL && (!filtered || pipeline.filter_buffers != NULL) &&
+                 (!options->io_uring || (pipeline.read_requests != NULL && pipeline.write_requests != NULL));
+    if (!result) {
+        err("decompress_blocks", "Unable to allocate memory for the blocks!");
+    }
+
+    // Blocks are read through io_uring at the offsets of the block index, so the
+    // container has to start the file (like for decompress_range())
+    IORing input_ring;
+    IORing output_ring;
+    if (result && options->io_uring) {
+        if (ftell(input_file) == CONTAINER_HEADER_SIZE) {
+            pipeline.input_ring = open_io_ring(&input_ring, input_file, 0, pipeline.compressed_buffers,
+                                               pipeline.compressed_stride, slot_blocks);
+        }
+        if (pipeline.input_ring != NULL && read_block_index(input_file, &header, &pipeline.index) == 0) {
+            result = 0;
+        }
+        long output_offset = fflush(output_file) == 0 ? ftell(output_file) : -1;
+        if (output_offset >= 0) {
+            pipeline.output_ring = open_io_ring(&output_ring, output_file, 1, pipeline.raw_buffers, header.block_size,
+                                                slot_blocks);
+            pipeline.output_offset = (uint64_t) output_offset;
+        }
+    }
+
+    init_stats(&pipeline.stats);
+    double start_time = get_wall_time();
+    pipeline.processed = CONTAINER_HEADER_SIZE;
+    Pipeline stages = {read_decode_slot, decode_slot, write_decode_slot, &pipeline, PIPELINE_SLOTS};
+    result = result && run_pipeline(&stages);
+    pipeline.stats.ring_requests += pipeline.read_ring_requests + pipeline.write_ring_requests;
+
+    // Leave the output positioned after the decoded data, as the stdio path does
+    if (result && pipeline.output_ring != NULL &&
+        fseek(output_file, (long) (pipeline.output_offset + pipeline.decoded), SEEK_SET) != 0) {
+        err("decompress_blocks", "Unable to write the output file!");
+        result = 0;
+    }
+    if (result) {
+        finish_stats(&pipeline.stats, start_time, pipeline.processed, pipeline.decoded, 0, options);
+    }
+    release_pool(pool, &own_pool);
+    close_io_ring(pipeline.input_ring);
+    close_io_ring(pipeline.output_ring);
+    free_block_index(&pipeline.index);
+    free(pipeline.jobs);
+    free(pipeline.batch_sizes);
+    release_codec_buffer(options, pipeline.raw_buffers, slot_blocks * header.block_size);
+    release_codec_buffer(options, pipeline.compressed_buffers, slot_blocks * pipeline.compressed_stride);
+    release_codec_buffer(options, pipeline.filter_buffers, pipeline.job_count * header.block_size);
+    free(pipeline.read_requests);
+    free(pipeline.write_requests);
     return result;
 }
 
+/*
+* Function: init_compressor_options
+* ---------------------------------
+* Fills CompressorOptions with the defaults: basic mode, DEFAULT_BLOCK_SIZE
+* blocks, DEFAULT_ELEMENT_WIDTH elements, no filters, one thread per CPU,
+* reader/chunk buffer sizes (used for legacy .rle streams) chosen for every
+* file, no stats, no shared thread or buffer pool and stdio reads and writes.
+*
+* options: Pointer to the CompressorOptions
+*/
+void init_compressor_options(CompressorOptions* options) {
+    options->compression_mode = basic;
+    options->block_size = DEFAULT_BLOCK_SIZE;
+    options->element_width = DEFAULT_ELEMENT_WIDTH;
+    options->plane_count = 0;
+    options->delta_mode = delta_none;
+    options->delta_stride = 0;
+    options->huffman = 0;
+    options->thread_count = 0;
+    options->buffer_size = 0;
+    options->chunk_size = 0;
+    options->stats = NULL;
+    options->pool = NULL;
+    options->buffer_pool = NULL;
+    options->quiet = 0;
+    options->io_uring = 0;
+}
+
+/*
+* Function: compress
+* ------------------
+* Compresses the input file into a block container. The input is split into
+* options->block_size blocks that are encoded in parallel on a thread pool
+* and written in order. With options->io_uring, a regular input and output
+* are read and written with io_uring requests, a batch of blocks in flight
+* at once.
+*
+* input_file: Pointer to the input_file
+* output_file: Pointer to the output_file
+* options: Compression mode, block size and thread count
+*
+* returns: If failed (0), On success (1)
+*/
+int compress(FILE* input_file, FILE* output_file, const CompressorOptions* options) {
+    if (input_file == NULL || output_file == NULL || options == NULL) {
+        err("compress", "Input/output file is NULL!");
+        return 0;
+    }
+
+    return compress_blocks(input_file, NULL, 0, output_file, options);
+}
+
 /*
 * Function: decompress
 * ------------------
-* Decompresses the input file using huffman coding
+* Decompresses a block container or a legacy .rle stream. With
+* options->io_uring, the blocks of a container in a regular file are read
+* through its block index, and a regular output is written, with io_uring
+* requests, a batch of blocks in flight at once.
 *
 * input_file: Pointer to the input_file
 * output_file: Pointer to the output_file
-* reader_buffer_size: RLEReader buffer (output buffer) size 
-* decompressor_buffer_size: Compressor input buffer size
+* options: Reader buffer (output buffer) and chunk sizes for legacy streams
 *
 * returns: If failed (0), On success (1)
 */
-int decompress(FILE* input_file, FILE* output_file, size_t reader_buffer_size, size_t decompressor_buffer_size) {    
-    if (input_file == NULL || output_file == NULL) {
+int decompress(FILE* input_file, FILE* output_file, const CompressorOptions* options) {
+    if (input_file == NULL || output_file == NULL || options == NULL) {
         err("decompress", "Input/output file is NULL!");
         return 0;
     }
 
-    CompressionMode compression_mode;
-    int read_result = fread(&compression_mode, sizeof(unsigned char), 1, input_file);
-    if (read_result < 1 || (compression_mode != basic && compression_mode != advance)) {
+    unsigned char first_byte = 0;
+    if (fread(&first_byte, sizeof(unsigned char), 1, input_file) < 1) {
         fprintf(stderr, "\n[ERROR]: decompress() {} -> File is corrupted!\n");
         return 0;
     }
-    
+    if (first_byte == CONTAINER_MAGIC[0]) {
+        return decompress_blocks(input_file, output_file, first_byte, options);
+    }
+
+    // Legacy stream: the first byte is the compression mode
+    CompressionMode compression_mode = (CompressionMode) first_byte;
+    if (compression_mode != basic && compression_mode != advance) {
+        fprintf(stderr, "\n[ERROR]: decompress() {} -> File is corrupted!\n");
+        return 0;
+    }
+
+    size_t buffer_size = 0;
+    size_t chunk_size = 0;
+    choose_buffer_sizes(options, input_file, output_file, &buffer_size, &chunk_size);
+    unsigned char* reader_buffer = acquire_codec_buffer(options, buffer_size);
+    unsigned char* chunk = acquire_codec_buffer(options, chunk_size);
     RLEReader rle_reader;
-    int error = init_reader(&rle_reader, output_file, reader_buffer_size, compression_mode);
-    if (error == 0) {
+    if (reader_buffer == NULL || chunk == NULL ||
+        init_reader_with_buffer(&rle_reader, output_file, reader_buffer, buffer_size, compression_mode) == 0) {
         err("decompress", "Unable to initiate RLEReader");
+        release_codec_buffer(options, reader_buffer, buffer_size);
+        release_codec_buffer(options, chunk, chunk_size);
+        return 0;
+    }
+
+    RLEStats stats;
+    init_stats(&stats);
+    double start_time = get_wall_time();
+    long output_start = ftell(output_file);
+    ssize_t processed = decode_with_buffer(input_file, &rle_reader, chunk, chunk_size);
+    long output_end = ftell(output_file);
+    release_codec_buffer(options, reader_buffer, buffer_size);
+    release_codec_buffer(options, chunk, chunk_size);
+    if (processed < 0) {
+        return 0;
+    }
+    if (options->stats != NULL) {
+        stats.bytes_in = processed + 1;
+        stats.bytes_out = output_start >= 0 && output_end >= output_start ? (size_t)(output_end - output_start) : 0;
+        stats.total_time = get_wall_time() - start_time;
+        *options->stats = stats;
+    }
+    return 1;
+}
+
+/*
+* Function: write_range
+* ---------------------
+* Writes the part of a decoded region that falls inside [start, end).
+*
+* returns: If failed (0), On success (1)
+*/
+static int write_range(FILE* output_file, const unsigned char* data, uint64_t data_offset, size_t data_size,
+                       uint64_t start, uint64_t end) {
+    uint64_t from = start > data_offset ? start : data_offset;
+    uint64_t to = end < data_offset + data_size ? end : data_offset + data_size;
+    if (from >= to) {
+        return 1;
+    }
+    if (fwrite(&data[from - data_offset], sizeof(unsigned char), to - from, output_file) < to - from) {
+        err("decompress_range", "Unable to write the output file!");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+* Function: decompress_range_blocks
+* ---------------------------------
+* Decodes [start, end) of a block container. The block index is loaded
+* through the trailer, the first block is found with a binary search, and
+* only the blocks overlapping the range are read and decoded.
+*/
+static int decompress_range_blocks(FILE* input_file, FILE* output_file, unsigned char first_byte, uint64_t start,
+                                   uint64_t end, const CompressorOptions* options) {
+    unsigned char header_bytes[CONTAINER_HEADER_SIZE];
+    ContainerHeader header;
+    header_bytes[0] = first_byte;
+    if (fread(&header_bytes[1], sizeof(unsigned char), CONTAINER_HEADER_SIZE - 1, input_file) < CONTAINER_HEADER_SIZE - 1 ||
+        read_container_header(header_bytes, &header) == 0) {
+        fprintf(stderr, "\n[ERROR]: decompress_range() {} -> File is corrupted!\n");
+        return 0;
+    }
+
+    BlockIndex index = {0};
+    if (read_block_index(input_file, &header, &index) == 0) {
+        return 0;
+    }
+
+    size_t block_bound = get_block_bound(header.block_size, header.version);
+    unsigned char* raw = acquire_codec_buffer(options, header.block_size);
+    unsigned char* compressed = acquire_codec_buffer(options, block_bound);
+    int filtered = header.plane_count > 1 || header.huffman;
+    BlockFilter filter = {header.plane_count, header.delta_mode, header.delta_stride, 0,
+                          filtered ? acquire_codec_buffer(options, header.block_size) : NULL};
+    int result = raw != NULL && compressed != NULL && (!filtered || filter.scratch != NULL);
+    if (!result) {
+        err("decompress_range", "Unable to allocate memory for the blocks!");
+    }
+
+    for (size_t i = find_block(&index, start); result && i < index.block_count; i++) {
+        const BlockIndexEntry* entry = &index.entries[i];
+        unsigned char block_header_bytes[BLOCK_HEADER_SIZE];
+        BlockHeader block_header;
+        if (entry->raw_offset >= end) {
+            break;
+        }
+        result = fseek(input_file, (long) entry->offset, SEEK_SET) == 0 &&
+                 fread(block_header_bytes, sizeof(unsigned char), BLOCK_HEADER_SIZE, input_file) == BLOCK_HEADER_SIZE &&
+                 read_block_header(block_header_bytes, &block_header, &header) &&
+                 block_header.raw_size == entry->raw_size &&
+                 block_header.compressed_size == entry->compressed_size &&
+                 fread(compressed, sizeof(unsigned char), block_header.compressed_size, input_file) == block_header.compressed_size &&
+                 decode_block(&block_header, compressed, raw, &filter);
+        if (!result) {
+            fprintf(stderr, "\n[ERROR]: decompress_range() {} -> File is corrupted!\n");
+            break;
+        }
+        result = write_range(output_file, raw, entry->raw_offset, entry->raw_size, start, end);
+    }
+
+    release_codec_buffer(options, raw, header.block_size);
+    release_codec_buffer(options, compressed, block_bound);
+    release_codec_buffer(options, filter.scratch, header.block_size);
+    free_block_index(&index);
+    return result;
+}
+
+/*
+* Function: decompress_range_stream
+* ---------------------------------
+* Decodes [start, end) of a legacy .rle stream. Legacy streams have no
+* index, so the tokens before the range are skipped by their counter bytes
+* (without being expanded), the tokens inside it are decoded, and reading
+* stops at the end of the range. The tokens cut by the range boundaries
+* are decoded on their own and cropped.
+*/
+static int decompress_range_stream(FILE* input_file, FILE* output_file, CompressionMode compression_mode,
+                                   uint64_t start, uint64_t end, const CompressorOptions* options) {
+    size_t buffer_size = 0;
+    size_t chunk_size = 0;
+    choose_buffer_sizes(options, input_file, output_file, &buffer_size, &chunk_size);
+    unsigned char* chunk = acquire_codec_buffer(options, chunk_size + ADVANCE_COMPRESSION_LIMIT);
+    unsigned char* reader_buffer = acquire_codec_buffer(options, buffer_size);
+    unsigned char token[BASIC_COMPRESSION_LIMIT];
+    RLEReader rle_reader;
+    if (chunk == NULL || reader_buffer == NULL ||
+        init_reader_with_buffer(&rle_reader, output_file, reader_buffer, buffer_size, compression_mode) == 0) {
+        err("decompress_range", "Unable to initiate RLEReader");
+        release_codec_buffer(options, chunk, chunk_size + ADVANCE_COMPRESSION_LIMIT);
+        release_codec_buffer(options, reader_buffer, buffer_size);
         return 0;
     }
 
-    int result = decode(input_file, &rle_reader, decompressor_buffer_size);
+    int result = 1;
+    uint64_t position = 0;
+    size_t carry = 0;
+    while (result && position < end) {
+        size_t chunk_end = carry + fread(&chunk[carry], sizeof(unsigned char), chunk_size, input_file);
+        if (chunk_end == carry) {
+            if (carry > 0) {
+                fprintf(stderr, "\n[ERROR]: decompress_range() {} -> File is truncated!\n");
+                result = 0;
+            }
+            break;
+        }
+
+        // Tokens fully inside the range are decoded in runs of consecutive tokens
+        size_t pos = 0;
+        size_t pending = 0;
+        while (result && position < end) {
+            size_t decoded_size = 0;
+            ssize_t token_size = next_token(&chunk[pos], chunk_end - pos, compression_mode, &decoded_size);
+            if (token_size < 0) {
+                fprintf(stderr, "\n[ERROR]: decompress_range() {} -> File is corrupted!\n");
+                result = 0;
+            } else if (token_size == 0) {
+                break;
+            } else if (position + decoded_size <= start) {
+                pending = pos + token_size;
+            } else if (position >= start && position + decoded_size <= end) {
+                // Inside the range: joins the pending run
+            } else {
+                RLEReader token_reader;
+                result = read_rle_chunk(&rle_reader, &chunk[pending], pos - pending) >= 0 &&
+                         flush_reader(&rle_reader) >= 0 &&
+                         init_memory_reader(&token_reader, token, sizeof(token), compression_mode) &&
+                         read_rle_chunk(&token_reader, &chunk[pos], token_size) >= 0 &&
+                         write_range(output_file, token, position, decoded_size, start, end);
+                pending = pos + token_size;
+            }
+            position += decoded_size;
+            pos += token_size;
+        }
+        if (result && read_rle_chunk(&rle_reader, &chunk[pending], pos - pending) < 0) {
+            result = 0;
+        }
+
+        carry = chunk_end - pos;
+        memmove(chunk, &chunk[pos], carry);
+    }
+
+    if (result && flush_reader(&rle_reader) < 0) {
+        result = 0;
+    }
+    release_codec_buffer(options, reader_buffer, buffer_size);
+    release_codec_buffer(options, chunk, chunk_size + ADVANCE_COMPRESSION_LIMIT);
+    return result;
+}
+
+/*
+* Function: decompress_range
+* --------------------------
+* Decompresses only the bytes [offset, offset + length) of the decoded data.
+* Block containers are served through their block index: only the blocks
+* overlapping the range are read and decoded. Legacy .rle streams have no
+* index and are walked from the start, but the tokens before the range are
+* skipped without being expanded. A range past the end of the data is cut
+* short.
+*
+* input_file: Pointer to the input_file (must be seekable for block containers)
+* output_file: Pointer to the output_file
+* offset: First decoded byte to output
+* length: Number of decoded bytes to output
+* options: Reader buffer (output buffer) and chunk sizes for legacy streams
+*
+* returns: If failed (0), On success (1)
+*/
+int decompress_range(FILE* input_file, FILE* output_file, uint64_t offset, uint64_t length,
+                     const CompressorOptions* options) {
+    if (input_file == NULL || output_file == NULL || options == NULL) {
+        err("decompress_range", "Input/output file is NULL!");
+        return 0;
+    }
+
+    uint64_t end = length > UINT64_MAX - offset ? UINT64_MAX : offset + length;
+    unsigned char first_byte = 0;
+    if (fread(&first_byte, sizeof(unsigned char), 1, input_file) < 1) {
+        fprintf(stderr, "\n[ERROR]: decompress_range() {} -> File is corrupted!\n");
+        return 0;
+    }
+    if (first_byte == CONTAINER_MAGIC[0]) {
+        return decompress_range_blocks(input_file, output_file, first_byte, offset, end, options);
+    }
+
+    CompressionMode compression_mode = (CompressionMode) first_byte;
+    if (compression_mode != basic && compression_mode != advance) {
+        fprintf(stderr, "\n[ERROR]: decompress_range() {} -> File is corrupted!\n");
+        return 0;
+    }
+    return decompress_range_stream(input_file, output_file, compression_mode, offset, end, options);
+}
+
+/*
+* Function: compress_mapped
+* -------------------------
+* Same as compress(), but the input is memory mapped read-only, so the
+* blocks are encoded straight from the page cache without read buffers.
+* Falls back to compress() where mmap is not available.
+*
+* input_file: Pointer to the input_file (regular file)
+* output_file: Pointer to the output_file
+* options: Compression mode, block size and thread count
+*
+* returns: If failed (0), On success (1)
+*/
+int compress_mapped(FILE* input_file, FILE* output_file, const CompressorOptions* options) {
+    if (input_file == NULL || output_file == NULL || options == NULL) {
+        err("compress_mapped", "Input/output file is NULL!");
+        return 0;
+    }
+#ifndef MAPPED_IO
+    return compress(input_file, output_file, options);
+#else
+    int input_fd = fileno(input_file);
+    struct stat st;
+    if (fstat(input_fd, &st) != 0) {
+        err("compress_mapped", "Unable to get the input file size!");
+        return 0;
+    }
+
+    size_t input_size = st.st_size;
+    unsigned char* input = NULL;
+    if (input_size > 0) {
+        input = mmap(NULL, input_size, PROT_READ, MAP_PRIVATE, input_fd, 0);
+        if (input == MAP_FAILED) {
+            err("compress_mapped", "Unable to map the input file!");
+            return 0;
+        }
+        madvise(input, input_size, MADV_SEQUENTIAL);
+    }
+
+    // An empty input still needs a non-NULL map so compress_blocks() does not read input_file
+    static const unsigned char empty_input[1];
+    int result = compress_blocks(NULL, input != NULL ? input : empty_input, input_size, output_file, options);
+    if (input != NULL) {
+        munmap(input, input_size);
+    }
+    return result;
+#endif
+}
+
+#ifdef MAPPED_IO
+/*
+* Function: map_output
+* --------------------
+* Pre-sizes the output file with ftruncate and maps it writable.
+*
+* returns: Pointer to the mapped output (NULL for an empty output). If failed (MAP_FAILED).
+*/
+static unsigned char* map_output(int output_fd, size_t output_size) {
+    if (ftruncate(output_fd, output_size) != 0) {
+        err("map_output", "Unable to resize the output file!");
+        return MAP_FAILED;
+    }
+    if (output_size == 0) {
+        return NULL;
+    }
+    unsigned char* output = mmap(NULL, output_size, PROT_READ | PROT_WRITE, MAP_SHARED, output_fd, 0);
+    if (output == MAP_FAILED) {
+        err("map_output", "Unable to map the output file!");
+    }
+    return output;
+}
+
+/*
+* Function: decode_jobs
+* ---------------------
+* Decodes DecodeJobs in parallel on a thread pool. Every job writes its own
+* disjoint region of the output, so no ordering is needed. Jobs that need
+* scratch_size bytes of scratch memory (byte planes, Huffman coding) are run in batches
+* that reuse the same scratch buffers.
+*
+* returns: If failed (0), On success (1)
+*/
+static int decode_jobs(DecodeJob* jobs, size_t job_count, const CompressorOptions* options, size_t scratch_size) {
+    ThreadPool own_pool;
+    ThreadPool* pool = acquire_pool(options, &own_pool);
+    if (pool == NULL) {
+        return 0;
+    }
+
+    size_t batch_size = scratch_size > 0 ? pool->thread_count * BLOCKS_PER_THREAD : job_count;
+    if (batch_size > job_count) {
+        batch_size = job_count;
+    }
+    unsigned char* scratch = scratch_size > 0 ? acquire_codec_buffer(options, batch_size * scratch_size) : NULL;
+    int result = scratch_size == 0 || scratch != NULL;
+    if (!result) {
+        err("decode_jobs", "Unable to allocate memory for the block filters!");
+    }
+    TaskGroup group = {0};
+    for (size_t batch_start = 0; result && batch_start < job_count; batch_start += batch_size) {
+        for (size_t i = batch_start; result && i < job_count && i < batch_start + batch_size; i++) {
+            jobs[i].result = 0;
+            if (scratch != NULL) {
+                jobs[i].filter.scratch = &scratch[(i - batch_start) * scratch_size];
+            }
+            result = submit_group_task(pool, &group, decode_block_task, &jobs[i]);
+        }
+        wait_task_group(pool, &group);
+    }
+    release_pool(pool, &own_pool);
+    release_codec_buffer(options, scratch, batch_size * scratch_size);
+
+    for (size_t i = 0; result && i < job_count; i++) {
+        result = jobs[i].result;
+    }
+    return result;
+}
+
+/*
+* Function: decompress_mapped_stream
+* ----------------------------------
+* Decodes a mapped legacy .rle stream into a pre-sized mapped output. A
+* pass over the counter bytes splits the stream into segments at token
+* boundaries and gives the output offset of each one; the segments are
+* then decoded in parallel.
+*/
+static int decompress_mapped_stream(const unsigned char* input, size_t input_size, int output_fd,
+                                    const CompressorOptions* options) {
+    RLEStats stats;
+    init_stats(&stats);
+    double start_time = get_wall_time();
+    CompressionMode compression_mode = (CompressionMode) input[0];
+    if (compression_mode != basic && compression_mode != advance) {
+        fprintf(stderr, "\n[ERROR]: decompress_mapped() {} -> File is corrupted!\n");
+        return 0;
+    }
+
+    const unsigned char* tokens = &input[1];
+    size_t tokens_size = input_size - 1;
+    size_t thread_count = options->pool != NULL ? options->pool->thread_count
+                        : options->thread_count > 0 ? options->thread_count : get_cpu_count();
+    size_t segment_size = tokens_size / (thread_count * BLOCKS_PER_THREAD);
+    if (segment_size < MIN_SEGMENT_SIZE) {
+        segment_size = MIN_SEGMENT_SIZE;
+    } else if (segment_size > MAX_SEGMENT_SIZE) {
+        segment_size = MAX_SEGMENT_SIZE;
+    }
+
+    // Split at token boundaries
+    size_t job_capacity = tokens_size / segment_size + 1;
+    DecodeJob* jobs = malloc(job_capacity * sizeof(DecodeJob));
+    if (jobs == NULL) {
+        err("decompress_mapped", "Unable to allocate memory for the segments!");
+        return 0;
+    }
+    size_t job_count = 0;
+    size_t decoded_size = 0;
+    size_t offset = 0;
+    while (offset < tokens_size) {
+        size_t segment_decoded = 0;
+        ssize_t segment = skip_tokens(&tokens[offset], tokens_size - offset, segment_size, compression_mode,
+                                      &segment_decoded);
+        if (segment < 0) {
+            fprintf(stderr, "\n[ERROR]: decompress_mapped() {} -> File is corrupted!\n");
+            free(jobs);
+            return 0;
+        }
+        DecodeJob* job = &jobs[job_count++];
+        job->header.block_type = (unsigned char) compression_mode;
+        job->header.raw_size = segment_decoded;
+        job->header.compressed_size = segment;
+        job->input = &tokens[offset];
+        job->filter.plane_count = 0;
+        job->filter.delta_mode = delta_none;
+        job->filter.delta_stride = 0;
+        job->filter.huffman = 0;
+        job->filter.scratch = NULL;
+        offset += segment;
+        decoded_size += segment_decoded;
+    }
+
+    unsigned char* output = map_output(output_fd, decoded_size);
+    int result = output != MAP_FAILED;
+    if (result) {
+        // Output offsets are the prefix sums of the decoded segment sizes
+        size_t output_offset = 0;
+        for (size_t i = 0; i < job_count; i++) {
+            jobs[i].output = &output[output_offset];
+            output_offset += jobs[i].header.raw_size;
+        }
+        double codec_start = get_wall_time();
+        result = decode_jobs(jobs, job_count, options, 0);
+        stats.codec_time = get_wall_time() - codec_start;
+        if (output != NULL) {
+            munmap(output, decoded_size);
+        }
+    }
+    if (result) {
+        finish_stats(&stats, start_time, input_size, decoded_size, 0, options);
+    }
+    free(jobs);
+    return result;
+}
+
+/*
+* Function: decompress_mapped_blocks
+* ----------------------------------
+* Decodes a mapped block container into a pre-sized mapped output. The
+* block headers are walked first to get the output size and the output
+* offset of every block; the blocks are then decoded in parallel.
+*/
+static int decompress_mapped_blocks(const unsigned char* input, size_t input_size, int output_fd,
+                                    const CompressorOptions* options) {
+    RLEStats stats;
+    init_stats(&stats);
+    double start_time = get_wall_time();
+    ContainerHeader header;
+    if (input_size < CONTAINER_HEADER_SIZE || read_container_header(input, &header) == 0) {
+        fprintf(stderr, "\n[ERROR]: decompress_mapped() {} -> File is corrupted!\n");
+        return 0;
+    }
+
+    BlockIndex index = {0};
+    size_t offset = CONTAINER_HEADER_SIZE;
+    size_t decoded_size = 0;
+    int result = 1;
+    while (result) {
+        BlockHeader block_header;
+        if (offset >= input_size) {
+            result = 0;
+        } else if (input[offset] == BLOCK_END) {
+            break;
+        } else {
+            result = offset + BLOCK_HEADER_SIZE <= input_size &&
+                     read_block_header(&input[offset], &block_header, &header) &&
+                     offset + BLOCK_HEADER_SIZE + block_header.compressed_size <= input_size &&
+                     add_index_entry(&index, offset, &block_header);
+            offset += BLOCK_HEADER_SIZE + block_header.compressed_size;
+            decoded_size += block_header.raw_size;
+        }
+    }
+    if (!result) {
+        fprintf(stderr, "\n[ERROR]: decompress_mapped() {} -> File is corrupted!\n");
+        free_block_index(&index);
+        return 0;
+    }
+
+    DecodeJob* jobs = malloc((index.block_count + 1) * sizeof(DecodeJob));
+    unsigned char* output = jobs != NULL ? map_output(output_fd, decoded_size) : MAP_FAILED;
+    result = output != MAP_FAILED;
+    if (result) {
+        // Output offsets are the prefix sums of the raw block sizes
+        size_t output_offset = 0;
+        for (size_t i = 0; i < index.block_count; i++) {
+            DecodeJob* job = &jobs[i];
+            read_block_header(&input[index.entries[i].offset], &job->header, &header);
+            job->input = &input[index.entries[i].offset + BLOCK_HEADER_SIZE];
+            job->output = &output[output_offset];
+            job->filter.plane_count = header.plane_count;
+            job->filter.delta_mode = header.delta_mode;
+            job->filter.delta_stride = header.delta_stride;
+            job->filter.huffman = 0;
+            job->filter.scratch = NULL;
+            output_offset += job->header.raw_size;
+        }
+        double codec_start = get_wall_time();
+        result = decode_jobs(jobs, index.block_count, options,
+                             header.plane_count > 1 || header.huffman ? header.block_size : 0);
+        stats.codec_time = get_wall_time() - codec_start;
+        if (output != NULL) {
+            munmap(output, decoded_size);
+        }
+    }
+
+    free(jobs);
+    free_block_index(&index);
+    if (result) {
+        finish_stats(&stats, start_time, input_size, decoded_size, 0, options);
+    }
+    return result;
+}
+#endif
+
+/*
+* Function: decompress_mapped
+* ---------------------------
+* Decompresses a regular file through memory mappings. The decoded size is
+* computed from the block headers (or the counter bytes of a legacy stream),
+* the output is pre-sized with ftruncate, and the tokens are expanded
+* straight into the mapped output.
+* Falls back to decompress() where mmap is not available.
+*
+* input_file: Pointer to the input_file (regular file)
+* output_file: Pointer to the output_file (regular file, opened for reading and writing)
+* options: Reader buffer (output buffer) and chunk sizes for legacy streams
+*
+* returns: If failed (0), On success (1)
+*/
+int decompress_mapped(FILE* input_file, FILE* output_file, const CompressorOptions* options) {
+    if (input_file == NULL || output_file == NULL || options == NULL) {
+        err("decompress_mapped", "Input/output file is NULL!");
+        return 0;
+    }
+#ifndef MAPPED_IO
+    return decompress(input_file, output_file, options);
+#else
+    int input_fd = fileno(input_file);
+    struct stat st;
+    if (fstat(input_fd, &st) != 0 || st.st_size < 1) {
+        fprintf(stderr, "\n[ERROR]: decompress_mapped() {} -> File is corrupted!\n");
+        return 0;
+    }
+
+    size_t input_size = st.st_size;
+    unsigned char* input = mmap(NULL, input_size, PROT_READ, MAP_PRIVATE, input_fd, 0);
+    if (input == MAP_FAILED) {
+        err("decompress_mapped", "Unable to map the input file!");
+        return 0;
+    }
+    madvise(input, input_size, MADV_SEQUENTIAL);
+
+    int result = input[0] == CONTAINER_MAGIC[0] ? decompress_mapped_blocks(input, input_size, fileno(output_file), options)
+                                                : decompress_mapped_stream(input, input_size, fileno(output_file), options);
+    munmap(input, input_size);
+    if (result) {
+        fseek(output_file, 0, SEEK_END);
+    }
     return result;
+#endif
 }
@@ -0,0 +1,552 @@
+#include "../include/container.h"
+#include "../include/huffman.h"
+#include "../include/rle.h"
+#include "../include/simd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* Function: put_u32
+* -----------------
+*  Stores a 32-bit integer as little-endian.
+*/
+static void put_u32(unsigned char* output, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        output[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+/*
+* Function: put_u64
+* -----------------
+*  Stores a 64-bit integer as little-endian.
+*/
+static void put_u64(unsigned char* output, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        output[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+/*
+* Function: get_u32
+* -----------------
+*  Loads a little-endian 32-bit integer.
+*/
+static uint32_t get_u32(const unsigned char* input) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | input[i];
+    }
+    return value;
+}
+
+/*
+* Function: get_u64
+* -----------------
+*  Loads a little-endian 64-bit integer.
+*/
+static uint64_t get_u64(const unsigned char* input) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | input[i];
+    }
+    return value;
+}
+
+/*
+* Function: write_container_header
+* --------------------------------
+*  Serializes a ContainerHeader.
+*
+*  output: Pointer to CONTAINER_HEADER_SIZE bytes.
+*  header: Pointer to the header.
+*/
+void write_container_header(unsigned char* output, const ContainerHeader* header) {
+    memset(output, 0, CONTAINER_HEADER_SIZE);
+    memcpy(output, CONTAINER_MAGIC, 4);
+    output[4] = header->version;
+    output[5] = (unsigned char) (header->compression_mode | (header->huffman ? BLOCK_HUFFMAN : 0));
+    output[6] = header->plane_count;
+    output[7] = (unsigned char) header->delta_mode;
+    put_u32(&output[8], header->block_size);
+    put_u32(&output[12], header->delta_stride);
+}
+
+/*
+* Function: read_container_header
+* -------------------------------
+*  Parses and validates a serialized ContainerHeader.
+*
+*  input: Pointer to CONTAINER_HEADER_SIZE bytes.
+*  header: Pointer to the header to fill.
+*
+*  returns: If invalid (0), on success (1)
+*/
+int read_container_header(const unsigned char* input, ContainerHeader* header) {
+    if (memcmp(input, CONTAINER_MAGIC, 4) != 0) {
+        fprintf(stderr, "\n[ERROR]: read_container_header() {} -> Not an RLE container!\n");
+        return 0;
+    }
+
+    header->version = input[4];
+    header->huffman = header->version >= 7 && (input[5] & BLOCK_HUFFMAN) != 0;
+    header->compression_mode = (CompressionMode) (header->huffman ? input[5] & ~BLOCK_HUFFMAN : input[5]);
+    header->block_size = get_u32(&input[8]);
+    header->plane_count = header->version >= 5 ? input[6] : 0;
+    header->delta_mode = header->version >= 6 ? (DeltaMode) input[7] : delta_none;
+    header->delta_stride = header->version >= 6 ? get_u32(&input[12]) : 0;
+    if (header->version < 1 || header->version > CONTAINER_VERSION) {
+        fprintf(stderr, "\n[ERROR]: read_container_header() {} -> Unsupported container version (%d)!\n",
+                header->version);
+        return 0;
+    }
+    if (header->block_size == 0 || header->block_size > MAX_BLOCK_SIZE) {
+        fprintf(stderr, "\n[ERROR]: read_container_header() {} -> Invalid block size!\n");
+        return 0;
+    }
+    if (header->plane_count > MAX_PLANE_COUNT) {
+        fprintf(stderr, "\n[ERROR]: read_container_header() {} -> Invalid plane count!\n");
+        return 0;
+    }
+    if (header->delta_mode > delta_xor || (header->delta_mode != delta_none && header->delta_stride == 0)) {
+        fprintf(stderr, "\n[ERROR]: read_container_header() {} -> Invalid delta filter!\n");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+* Function: write_block_header
+* ----------------------------
+*  Serializes a BlockHeader.
+*
+*  output: Pointer to BLOCK_HEADER_SIZE bytes.
+*  header: Pointer to the header.
+*/
+void write_block_header(unsigned char* output, const BlockHeader* header) {
+    output[0] = header->block_type;
+    put_u32(&output[1], header->raw_size);
+    put_u32(&output[5], header->compressed_size);
+}
+
+/*
+* Function: read_block_header
+* ---------------------------
+*  Parses a serialized BlockHeader. Only the block type byte is read for
+*  BLOCK_END.
+*
+*  input: Pointer to BLOCK_HEADER_SIZE bytes.
+*  header: Pointer to the header to fill.
+*  container_header: Header of the container, used to validate the sizes.
+*
+*  returns: If invalid (0), on success (1)
+*/
+int read_block_header(const unsigned char* input, BlockHeader* header, const ContainerHeader* container_header) {
+    header->block_type = input[0];
+    header->raw_size = 0;
+    header->compressed_size = 0;
+    if (header->block_type == BLOCK_END) {
+        return 1;
+    }
+
+    header->raw_size = get_u32(&input[1]);
+    header->compressed_size = get_u32(&input[5]);
+    int stored = header->block_type == BLOCK_STORED && container_header->version >= 2;
+    int huffman_coded = (header->block_type & BLOCK_HUFFMAN) != 0 && !stored && container_header->huffman;
+    unsigned char token_type = huffman_coded ? header->block_type & ~BLOCK_HUFFMAN : header->block_type;
+    int varint_tokens = token_type == varint && container_header->version >= 3;
+    int pattern_tokens = token_type == pattern && container_header->version >= 4;
+    if ((token_type != basic && token_type != advance && !varint_tokens && !pattern_tokens && !stored) ||
+        (stored && header->compressed_size != header->raw_size) ||
+        header->raw_size > container_header->block_size ||
+        header->compressed_size > get_block_bound(header->raw_size, container_header->version)) {
+        fprintf(stderr, "\n[ERROR]: read_block_header() {} -> Invalid block header!\n");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+* Function: get_block_bound
+* -------------------------
+*  Returns the largest possible compressed size of a block. Version 1
+*  containers have no stored blocks, so their blocks may take 2 bytes for
+*  every raw byte; later versions store a block that does not shrink.
+*
+*  raw_size: Raw (uncompressed) block size.
+*  version: Container version.
+*
+*  returns: Compressed size upper bound.
+*/
+size_t get_block_bound(size_t raw_size, unsigned char version) {
+    // Both modes spend at most 2 bytes on every raw byte, stored blocks cap that at 1
+    return version < 2 ? 2 * raw_size : raw_size;
+}
+
+/*
+* Function: encode_block
+* ----------------------
+*  Encodes one block into memory. A block whose tokens would not be smaller
+*  than the block itself is stored raw (BLOCK_STORED) instead.
+*
+*  input: Pointer to the raw block.
+*  raw_size: Raw block size.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size (raw_size always fits).
+*  compression_mode: Compression algorithm ('basic', 'advance', 'varint', 'pattern', or 'adaptive'
+*                    to pick the smallest one for this block; the block type records the choice).
+*  element_width: Element width for 'pattern' (and for 'adaptive' to try it), in bytes.
+*  filter: Pointer to the BlockFilter that delta encodes and splits the block first and Huffman codes the
+*          tokens (optional, NULL to disable). With both filters, the output buffer must hold raw_size bytes.
+*  header: Pointer to the BlockHeader to fill.
+*  stats: Pointer to the RLEStats that counts the tokens (optional, NULL to disable).
+*
+*  returns: If failed (0), on success (1)
+*/
+int encode_block(const unsigned char* input, size_t raw_size, unsigned char* output, size_t output_capacity,
+                 CompressionMode compression_mode, size_t element_width, const BlockFilter* filter,
+                 BlockHeader* header, RLEStats* stats) {
+    // Token blocks are encoded from the filtered bytes, stored blocks keep the raw bytes
+    const unsigned char* tokens_input = input;
+    int split = filter != NULL && filter->plane_count > 1;
+    if (filter != NULL && filter->delta_mode != delta_none) {
+        // Before a split, the deltas are staged in the output buffer (the tokens overwrite them afterwards)
+        if (split && output_capacity < raw_size) {
+            fprintf(stderr, "\n[ERROR]: encode_block() {} -> Output buffer is too small!\n");
+            return 0;
+        }
+        unsigned char* deltas = split ? output : filter->scratch;
+        encode_delta(input, raw_size, filter->delta_stride, filter->delta_mode, deltas);
+        tokens_input = deltas;
+    }
+    if (split) {
+        split_planes(tokens_input, raw_size, filter->plane_count, filter->scratch);
+        tokens_input = filter->scratch;
+    }
+    if (compression_mode == adaptive) {
+        compression_mode = choose_compression_mode(tokens_input, raw_size, element_width);
+    }
+
+    // The tokens only get room for less than raw_size bytes, the writer stops once it is full
+    size_t encode_capacity = raw_size > 0 ? raw_size - 1 : 0;
+    if (encode_capacity > output_capacity) {
+        encode_capacity = output_capacity;
+    }
+    RLEStats block_stats;
+    init_stats(&block_stats);
+    ssize_t encoded_size = -1;
+    if (compression_mode == varint) {
+        encoded_size = write_varint_tokens(tokens_input, raw_size, output, encode_capacity, stats != NULL ? &block_stats : NULL);
+    } else if (compression_mode == pattern) {
+        encoded_size = write_pattern_tokens(tokens_input, raw_size, element_width, output, encode_capacity,
+                                            stats != NULL ? &block_stats : NULL);
+    } else {
+        RLEWriter rle_writer;
+        if (init_memory_writer(&rle_writer, output, encode_capacity, compression_mode) == 0) {
+            fprintf(stderr, "\n[ERROR]: encode_block() {} -> Unable to encode the block!\n");
+            return 0;
+        }
+        rle_writer.stats = stats != NULL ? &block_stats : NULL;
+        if (write_rle_chunk(&rle_writer, tokens_input, raw_size) && flush_writer(&rle_writer) >= 0) {
+            encoded_size = rle_writer.buffer_pos;
+        }
+    }
+
+    header->raw_size = raw_size;
+    if (encoded_size >= 0) {
+        header->block_type = (unsigned char) compression_mode;
+
+        // The scratch memory is free again once the tokens are written
+        ssize_t coded_size = -1;
+        if (filter != NULL && filter->huffman && encoded_size > 0) {
+            coded_size = huffman_encode(output, encoded_size, filter->scratch, encoded_size - 1);
+        }
+        if (coded_size >= 0) {
+            memcpy(output, filter->scratch, coded_size);
+            encoded_size = coded_size;
+            header->block_type |= BLOCK_HUFFMAN;
+            block_stats.huffman_blocks++;
+        }
+        header->compressed_size = encoded_size;
+        if (stats != NULL) {
+            merge_stats(stats, &block_stats);
+        }
+        return 1;
+    }
+
+    // Not smaller than the raw block: store it
+    if (output_capacity < raw_size) {
+        fprintf(stderr, "\n[ERROR]: encode_block() {} -> Output buffer is too small!\n");
+        return 0;
+    }
+    memcpy(output, input, raw_size);
+    header->block_type = BLOCK_STORED;
+    header->compressed_size = raw_size;
+    if (stats != NULL) {
+        stats->stored_blocks++;
+    }
+    return 1;
+}
+
+/*
+* Function: decode_block
+* ----------------------
+*  Decodes one block into memory.
+*
+*  header: Pointer to the BlockHeader of the block.
+*  input: Pointer to the compressed block data.
+*  output: Pointer to the output buffer (header->raw_size bytes).
+*  filter: Pointer to the BlockFilter that merges the planes and decodes the deltas (optional, NULL to disable;
+*          Huffman coded blocks need its scratch memory).
+*
+*  returns: If failed (0), on success (1)
+*/
+int decode_block(const BlockHeader* header, const unsigned char* input, unsigned char* output,
+                 const BlockFilter* filter) {
+    if (header->block_type == BLOCK_STORED) {
+        if (header->compressed_size != header->raw_size) {
+            fprintf(stderr, "\n[ERROR]: decode_block() {} -> Block is corrupted!\n");
+            return 0;
+        }
+        memcpy(output, input, header->raw_size);
+        return 1;
+    }
+
+    // Token blocks of a split container decode to byte planes, which are merged into the output
+    // (the deltas are decoded in place after that)
+    unsigned char* tokens_output = output;
+    if (filter != NULL && filter->plane_count > 1) {
+        tokens_output = filter->scratch;
+    }
+
+    // Huffman coded tokens are decoded into whichever of the output and the scratch memory is free
+    const unsigned char* tokens = input;
+    size_t tokens_size = header->compressed_size;
+    unsigned char token_type = header->block_type;
+    if (header->block_type & BLOCK_HUFFMAN) {
+        if (filter == NULL || filter->scratch == NULL) {
+            fprintf(stderr, "\n[ERROR]: decode_block() {} -> No scratch memory for a Huffman coded block!\n");
+            return 0;
+        }
+        unsigned char* huffman_output = tokens_output == output ? filter->scratch : output;
+        ssize_t huffman_size = huffman_decode(input, header->compressed_size, huffman_output, header->raw_size);
+        if (huffman_size < 0) {
+            fprintf(stderr, "\n[ERROR]: decode_block() {} -> Block is corrupted!\n");
+            return 0;
+        }
+        tokens = huffman_output;
+        tokens_size = huffman_size;
+        token_type &= ~BLOCK_HUFFMAN;
+    }
+
+    int decoded = 0;
+    if (token_type == varint || token_type == pattern) {
+        ssize_t decoded_size = token_type == varint
+                             ? read_varint_tokens(tokens, tokens_size, tokens_output, header->raw_size)
+                             : read_pattern_tokens(tokens, tokens_size, tokens_output, header->raw_size);
+        decoded = decoded_size == header->raw_size;
+    } else {
+        RLEReader rle_reader;
+        decoded = init_memory_reader(&rle_reader, tokens_output, header->raw_size, (CompressionMode) token_type) &&
+                  read_rle_chunk(&rle_reader, tokens, tokens_size) >= 0 &&
+                  rle_reader.state == read_counter && rle_reader.buffer_pos == header->raw_size;
+    }
+    if (!decoded) {
+        fprintf(stderr, "\n[ERROR]: decode_block() {} -> Block is corrupted!\n");
+        return 0;
+    }
+    if (tokens_output != output) {
+        merge_planes(tokens_output, header->raw_size, filter->plane_count, output);
+    }
+    if (filter != NULL) {
+        decode_delta(output, header->raw_size, filter->delta_stride, filter->delta_mode);
+    }
+    return 1;
+}
+
+/*
+* Function: add_index_entry
+* -------------------------
+*  Appends a block to the BlockIndex.
+*
+*  index: Pointer to the BlockIndex (zero initialized before first use).
+*  offset: Offset of the block header in the file.
+*  header: Pointer to the BlockHeader of the block.
+*
+*  returns: If failed (0), on success (1)
+*/
+int add_index_entry(BlockIndex* index, uint64_t offset, const BlockHeader* header) {
+    if (index->block_count == index->capacity) {
+        size_t new_capacity = index->capacity > 0 ? 2 * index->capacity : 64;
+        BlockIndexEntry* entries = realloc(index->entries, new_capacity * sizeof(BlockIndexEntry));
+        if (entries == NULL) {
+            fprintf(stderr, "\n[ERROR]: add_index_entry() {} -> Unable to allocate memory for the index!\n");
+            return 0;
+        }
+        index->entries = entries;
+        index->capacity = new_capacity;
+    }
+
+    BlockIndexEntry* entry = &index->entries[index->block_count];
+    entry->raw_offset = index->block_count > 0 ? entry[-1].raw_offset + entry[-1].raw_size : 0;
+    index->block_count++;
+    entry->offset = offset;
+    entry->raw_size = header->raw_size;
+    entry->compressed_size = header->compressed_size;
+    return 1;
+}
+
+/*
+* Function: find_block
+* --------------------
+*  Binary searches the BlockIndex for the block holding a decoded offset.
+*
+*  index: Pointer to the BlockIndex.
+*  raw_offset: Offset in the decoded data.
+*
+*  returns: Index of the block. If the offset is past the end (index->block_count).
+*/
+size_t find_block(const BlockIndex* index, uint64_t raw_offset) {
+    size_t low = 0;
+    size_t high = index->block_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        const BlockIndexEntry* entry = &index->entries[middle];
+        if (raw_offset < entry->raw_offset) {
+            high = middle;
+        } else if (raw_offset >= entry->raw_offset + entry->raw_size) {
+            low = middle + 1;
+        } else {
+            return middle;
+        }
+    }
+    return index->block_count;
+}
+
+/*
+* Function: free_block_index
+* --------------------------
+*  Frees the entries of a BlockIndex.
+*
+*  index: Pointer to the BlockIndex.
+*/
+void free_block_index(BlockIndex* index) {
+    free(index->entries);
+    index->entries = NULL;
+    index->block_count = 0;
+    index->capacity = 0;
+}
+
+/*
+* Function: write_index_entry
+* ---------------------------
+*  Serializes a BlockIndexEntry (the raw offset is not stored).
+*
+*  output: Pointer to INDEX_ENTRY_SIZE bytes.
+*  entry: Pointer to the entry.
+*/
+void write_index_entry(unsigned char* output, const BlockIndexEntry* entry) {
+    put_u64(&output[0], entry->offset);
+    put_u32(&output[8], entry->raw_size);
+    put_u32(&output[12], entry->compressed_size);
+}
+
+/*
+* Function: write_container_trailer
+* ---------------------------------
+*  Serializes the trailer that points at the block index.
+*
+*  output: Pointer to CONTAINER_TRAILER_SIZE bytes.
+*  index_offset: Offset of the first index entry.
+*  block_count: Number of index entries.
+*/
+void write_container_trailer(unsigned char* output, uint64_t index_offset, uint32_t block_count) {
+    put_u64(&output[0], index_offset);
+    put_u32(&output[8], block_count);
+    memcpy(&output[12], CONTAINER_INDEX_MAGIC, 4);
+}
+
+/*
+* Function: write_container_end
+* -----------------------------
+*  Writes the BLOCK_END marker, the block index and the trailer.
+*
+*  output_file: Pointer to the output file.
+*  index: Pointer to the BlockIndex of the written blocks.
+*  offset: Current offset in the output file (where BLOCK_END goes).
+*
+*  returns: If failed (0), on success (1)
+*/
+int write_container_end(FILE* output_file, const BlockIndex* index, uint64_t offset) {
+    unsigned char bytes[CONTAINER_TRAILER_SIZE];
+
+    bytes[0] = BLOCK_END;
+    if (fwrite(bytes, sizeof(unsigned char), 1, output_file) < 1) {
+        fprintf(stderr, "\n[ERROR]: write_container_end() {} -> Unable to write the block index!\n");
+        return 0;
+    }
+    for (size_t i = 0; i < index->block_count; i++) {
+        write_index_entry(bytes, &index->entries[i]);
+        if (fwrite(bytes, sizeof(unsigned char), INDEX_ENTRY_SIZE, output_file) < INDEX_ENTRY_SIZE) {
+            fprintf(stderr, "\n[ERROR]: write_container_end() {} -> Unable to write the block index!\n");
+            return 0;
+        }
+    }
+
+    write_container_trailer(bytes, offset + 1, index->block_count);
+    if (fwrite(bytes, sizeof(unsigned char), CONTAINER_TRAILER_SIZE, output_file) < CONTAINER_TRAILER_SIZE) {
+        fprintf(stderr, "\n[ERROR]: write_container_end() {} -> Unable to write the trailer!\n");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+* Function: read_block_index
+* --------------------------
+*  Loads the block index of a container through its trailer. The input
+*  file must be seekable; its position is left undefined.
+*
+*  input_file: Pointer to the input file.
+*  container_header: Header of the container, used to validate the entries.
+*  index: Pointer to the BlockIndex to fill (zero initialized).
+*
+*  returns: If failed (0), on success (1)
+*/
+int read_block_index(FILE* input_file, const ContainerHeader* container_header, BlockIndex* index) {
+    unsigned char bytes[CONTAINER_TRAILER_SIZE];
+    if (fseek(input_file, -CONTAINER_TRAILER_SIZE, SEEK_END) != 0 ||
+        fread(bytes, sizeof(unsigned char), CONTAINER_TRAILER_SIZE, input_file) < CONTAINER_TRAILER_SIZE) {
+        fprintf(stderr, "\n[ERROR]: read_block_index() {} -> Unable to read the trailer!\n");
+        return 0;
+    }
+    long trailer_offset = ftell(input_file) - CONTAINER_TRAILER_SIZE;
+    uint64_t index_offset = get_u64(&bytes[0]);
+    uint32_t block_count = get_u32(&bytes[8]);
+    if (memcmp(&bytes[12], CONTAINER_INDEX_MAGIC, 4) != 0 || index_offset < CONTAINER_HEADER_SIZE ||
+        index_offset + (uint64_t) block_count * INDEX_ENTRY_SIZE != (uint64_t) trailer_offset ||
+        fseek(input_file, (long) index_offset, SEEK_SET) != 0) {
+        fprintf(stderr, "\n[ERROR]: read_block_index() {} -> Block index is corrupted!\n");
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < block_count; i++) {
+        BlockHeader header;
+        if (fread(bytes, sizeof(unsigned char), INDEX_ENTRY_SIZE, input_file) < INDEX_ENTRY_SIZE) {
+            fprintf(stderr, "\n[ERROR]: read_block_index() {} -> Block index is truncated!\n");
+            free_block_index(index);
+            return 0;
+        }
+        header.raw_size = get_u32(&bytes[8]);
+        header.compressed_size = get_u32(&bytes[12]);
+        if (header.raw_size > container_header->block_size || header.compressed_size > get_block_bound(header.raw_size, container_header->version) ||
+            add_index_entry(index, get_u64(&bytes[0]), &header) == 0) {
+            fprintf(stderr, "\n[ERROR]: read_block_index() {} -> Block index is corrupted!\n");
+            free_block_index(index);
+            return 0;
+        }
+    }
+    return 1;
+}
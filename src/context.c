@@ -0,0 +1,223 @@
+#include "../include/context.h"
+#include "../include/buffer.h"
+#include "../include/constants.h"
+#include "../include/rle.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* Function: take_buffer
+* ---------------------
+*  Takes a buffer from the pool of the context, or allocates it.
+*
+*  returns: Pointer to the buffer. If failed (NULL).
+*/
+static unsigned char* take_buffer(const RLEContext* ctx, size_t size) {
+    return ctx->pool != NULL ? acquire_buffer(ctx->pool, size) : malloc(size);
+}
+
+/*
+* Function: give_buffer
+* ---------------------
+*  Gives a buffer of take_buffer() back to the pool of the context, or
+*  frees it.
+*/
+static void give_buffer(const RLEContext* ctx, unsigned char* buffer, size_t size) {
+    if (ctx->pool != NULL) {
+        release_buffer(ctx->pool, buffer, size);
+    } else {
+        free(buffer);
+    }
+}
+
+/*
+* Function: rle_context_create
+* ----------------------------
+*  Creates a reusable codec context. Its buffers are taken once, here, and
+*  kept for every payload coded through it until rle_context_destroy(), so
+*  a server coding many small payloads allocates nothing per request. With
+*  a BufferPool, the buffers of destroyed contexts are handed to the next
+*  ones, so short-lived contexts are cheap too.
+*
+*  ctx: Pointer to the RLEContext to create.
+*  pool: Pointer to the initiated BufferPool (NULL = malloc/free).
+*  compression_mode: Compression algorithm.
+*  buffer_size: RLEWriter/RLEReader buffer size (0 = STREAM_BUFFER_SIZE, else at least 2).
+*  chunk_size: Input chunk size of the FILE functions (0 = STREAM_BUFFER_SIZE).
+*
+*  returns: If failed (0), on success (1)
+*/
+int rle_context_create(RLEContext* ctx, BufferPool* pool, CompressionMode compression_mode, size_t buffer_size,
+                       size_t chunk_size) {
+    if (ctx == NULL || compression_mode > adaptive || buffer_size == 1) {
+        fprintf(stderr, "\n[ERROR]: rle_context_create() {} -> Required parameters are not valid!\n");
+        return 0;
+    }
+
+    memset(ctx, 0, sizeof(RLEContext));
+    ctx->pool = pool;
+    ctx->compression_mode = compression_mode;
+    ctx->buffer_size = buffer_size > 0 ? buffer_size : STREAM_BUFFER_SIZE;
+    ctx->chunk_size = chunk_size > 0 ? chunk_size : STREAM_BUFFER_SIZE;
+    // The writer keeps the last byte as slack (see init_writer()), so the buffer stays in its pool size class
+    ctx->buffer = take_buffer(ctx, ctx->buffer_size);
+    ctx->chunk = take_buffer(ctx, ctx->chunk_size);
+    if (ctx->buffer == NULL || ctx->chunk == NULL) {
+        fprintf(stderr, "\n[ERROR]: rle_context_create() {} -> Unable to allocate memory for the buffers!\n");
+        rle_context_destroy(ctx);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+* Function: rle_context_reset
+* ---------------------------
+*  Readies a context for the next payload, keeping its buffers.
+*
+*  ctx: Pointer to the created RLEContext.
+*  compression_mode: Compression algorithm of the next payloads.
+*
+*  returns: If failed (0), on success (1)
+*/
+int rle_context_reset(RLEContext* ctx, CompressionMode compression_mode) {
+    if (ctx == NULL || ctx->buffer == NULL || compression_mode > adaptive) {
+        fprintf(stderr, "\n[ERROR]: rle_context_reset() {} -> Required parameters are not valid!\n");
+        return 0;
+    }
+    ctx->compression_mode = compression_mode;
+    memset(&ctx->rle_writer, 0, sizeof(RLEWriter));
+    memset(&ctx->rle_reader, 0, sizeof(RLEReader));
+    return 1;
+}
+
+/*
+* Function: rle_context_encode
+* ----------------------------
+*  Same as encode() (legacy .rle stream from the current position of the
+*  input to its end), through the buffers of the context.
+*
+*  ctx: Pointer to the created RLEContext ('basic' or 'advance' mode).
+*  input_file: Pointer to the input file.
+*  output_file: Pointer to the output file.
+*
+*  returns: Encoded bytes count. If failed (-1).
+*/
+ssize_t rle_context_encode(RLEContext* ctx, FILE* input_file, FILE* output_file) {
+    if (ctx == NULL || (ctx->compression_mode != basic && ctx->compression_mode != advance)) {
+        fprintf(stderr, "\n[ERROR]: rle_context_encode() {} -> Legacy streams are 'basic' or 'advance' only!\n");
+        return -1;
+    }
+    if (init_writer_with_buffer(&ctx->rle_writer, output_file, ctx->buffer, ctx->buffer_size - 1,
+                                ctx->compression_mode) == 0) {
+        return -1;
+    }
+    return encode_with_buffer(input_file, &ctx->rle_writer, ctx->chunk, ctx->chunk_size);
+}
+
+/*
+* Function: rle_context_decode
+* ----------------------------
+*  Same as decode(), but the compression mode byte is read too, through
+*  the buffers of the context.
+*
+*  ctx: Pointer to the created RLEContext.
+*  input_file: Pointer to the legacy .rle stream.
+*  output_file: Pointer to the output file.
+*
+*  returns: Compressed bytes count. If failed (-1).
+*/
+ssize_t rle_context_decode(RLEContext* ctx, FILE* input_file, FILE* output_file) {
+    unsigned char compression_mode = 0;
+    if (ctx == NULL || input_file == NULL || fread(&compression_mode, sizeof(unsigned char), 1, input_file) < 1 ||
+        (compression_mode != basic && compression_mode != advance)) {
+        fprintf(stderr, "\n[ERROR]: rle_context_decode() {} -> File is corrupted!\n");
+        return -1;
+    }
+    if (init_reader_with_buffer(&ctx->rle_reader, output_file, ctx->buffer, ctx->buffer_size,
+                                (CompressionMode) compression_mode) == 0) {
+        return -1;
+    }
+    return decode_with_buffer(input_file, &ctx->rle_reader, ctx->chunk, ctx->chunk_size);
+}
+
+/*
+* Function: rle_context_compress
+* ------------------------------
+*  Same as rle_compress_buffer() with the compression mode of the context.
+*
+*  ctx: Pointer to the created RLEContext.
+*  src: Pointer to the input.
+*  src_size: Input size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (rle_compress_bound(src_size) always fits).
+*
+*  returns: Size of the container. If failed (-1).
+*/
+ssize_t rle_context_compress(RLEContext* ctx, const unsigned char* src, size_t src_size, unsigned char* dst,
+                             size_t dst_capacity) {
+    if (ctx == NULL) {
+        fprintf(stderr, "\n[ERROR]: rle_context_compress() {} -> Required parameters are NULL!\n");
+        return -1;
+    }
+    return rle_compress_buffer(src, src_size, dst, dst_capacity, ctx->compression_mode);
+}
+
+/*
+* Function: rle_context_decompress
+* --------------------------------
+*  Same as rle_decompress_buffer(), but the scratch memory of byte plane
+*  and Huffman containers is kept by the context (and only grows).
+*
+*  ctx: Pointer to the created RLEContext.
+*  src: Pointer to the compressed data.
+*  src_size: Compressed data size.
+*  dst: Pointer to the output buffer.
+*  dst_capacity: Output buffer size (see rle_get_decompressed_size()).
+*
+*  returns: Decoded size. If failed or dst is too small (-1).
+*/
+ssize_t rle_context_decompress(RLEContext* ctx, const unsigned char* src, size_t src_size, unsigned char* dst,
+                               size_t dst_capacity) {
+    if (ctx == NULL) {
+        fprintf(stderr, "\n[ERROR]: rle_context_decompress() {} -> Required parameters are NULL!\n");
+        return -1;
+    }
+    ssize_t scratch_size = rle_get_scratch_size(src, src_size);
+    if (scratch_size < 0) {
+        return -1;
+    }
+    if ((size_t) scratch_size > ctx->scratch_size) {
+        give_buffer(ctx, ctx->scratch, ctx->scratch_size);
+        ctx->scratch_size = 0;
+        ctx->scratch = take_buffer(ctx, scratch_size);
+        if (ctx->scratch == NULL) {
+            fprintf(stderr, "\n[ERROR]: rle_context_decompress() {} -> Unable to allocate memory for the planes!\n");
+            return -1;
+        }
+        ctx->scratch_size = scratch_size;
+    }
+    return rle_decompress_buffer_with_scratch(src, src_size, dst, dst_capacity, ctx->scratch, ctx->scratch_size);
+}
+
+/*
+* Function: rle_context_destroy
+* -----------------------------
+*  Gives the buffers of a context back to its pool (or frees them).
+*
+*  ctx: Pointer to the created RLEContext.
+*/
+void rle_context_destroy(RLEContext* ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    give_buffer(ctx, ctx->buffer, ctx->buffer_size);
+    give_buffer(ctx, ctx->chunk, ctx->chunk_size);
+    give_buffer(ctx, ctx->scratch, ctx->scratch_size);
+    ctx->buffer = NULL;
+    ctx->chunk = NULL;
+    ctx->scratch = NULL;
+    ctx->scratch_size = 0;
+}
@@ -0,0 +1,369 @@
+#include "../include/huffman.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define HUFFMAN_TABLE_SIZE (1 << HUFFMAN_MAX_LENGTH)
+#define HUFFMAN_TABLE_MASK (HUFFMAN_TABLE_SIZE - 1)
+#define DECODES_PER_REFILL 4
+
+typedef struct {
+    unsigned char symbols[2];
+    unsigned char first_length;  // Code length of the first symbol (0 = no code starts with these bits)
+    unsigned char length;        // Code length of both symbols (== first_length when there is only one)
+} HuffmanEntry;
+
+/*
+* Function: to_little_endian
+* --------------------------
+*  Converts a 64-bit word between host and little-endian byte order.
+*/
+static inline uint64_t to_little_endian(uint64_t word) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_bswap64(word);
+#else
+    return word;
+#endif
+}
+
+/*
+* Function: reverse_code
+* ----------------------
+*  Reverses the low length bits of a code, so it can be read least
+*  significant bit first.
+*/
+static uint32_t reverse_code(uint32_t code, unsigned int length) {
+    uint32_t reversed = 0;
+    for (unsigned int i = 0; i < length; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    return reversed;
+}
+
+/*
+* Function: assign_codes
+* ----------------------
+*  Assigns canonical codes to the code lengths: shorter codes first, and
+*  codes of the same length in symbol order. Codes are stored bit reversed.
+*
+*  returns: If the lengths do not form a prefix code (0), on success (1)
+*/
+static int assign_codes(const unsigned char lengths[HUFFMAN_SYMBOLS], uint32_t codes[HUFFMAN_SYMBOLS]) {
+    uint32_t length_counts[HUFFMAN_MAX_LENGTH + 1] = {0};
+    for (int symbol = 0; symbol < HUFFMAN_SYMBOLS; symbol++) {
+        if (lengths[symbol] > HUFFMAN_MAX_LENGTH) {
+            return 0;
+        }
+        length_counts[lengths[symbol]]++;
+    }
+    length_counts[0] = 0;
+
+    // Kraft sum in units of 2^-HUFFMAN_MAX_LENGTH, at most 1 for a prefix code
+    uint32_t kraft_sum = 0;
+    uint32_t next_codes[HUFFMAN_MAX_LENGTH + 1] = {0};
+    uint32_t code = 0;
+    for (int length = 1; length <= HUFFMAN_MAX_LENGTH; length++) {
+        kraft_sum += length_counts[length] << (HUFFMAN_MAX_LENGTH - length);
+        code = (code + length_counts[length - 1]) << 1;
+        next_codes[length] = code;
+    }
+    if (kraft_sum > HUFFMAN_TABLE_SIZE) {
+        return 0;
+    }
+
+    for (int symbol = 0; symbol < HUFFMAN_SYMBOLS; symbol++) {
+        codes[symbol] = lengths[symbol] > 0 ? reverse_code(next_codes[lengths[symbol]]++, lengths[symbol]) : 0;
+    }
+    return 1;
+}
+
+/*
+* Function: limit_code_lengths
+* ----------------------------
+*  Caps the code lengths at HUFFMAN_MAX_LENGTH. The capped codes take more
+*  than their share of the code space, which is given back by making the
+*  longest codes under the limit one bit longer (the least frequent first).
+*
+*  lengths: Code length of every leaf, in order of ascending count.
+*  count: Number of leaves.
+*/
+static void limit_code_lengths(unsigned char* lengths, size_t count) {
+    uint32_t kraft_sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (lengths[i] > HUFFMAN_MAX_LENGTH) {
+            lengths[i] = HUFFMAN_MAX_LENGTH;
+        }
+        kraft_sum += 1U << (HUFFMAN_MAX_LENGTH - lengths[i]);
+    }
+
+    while (kraft_sum > HUFFMAN_TABLE_SIZE) {
+        size_t longest = count;
+        for (size_t i = 0; i < count; i++) {
+            if (lengths[i] < HUFFMAN_MAX_LENGTH && (longest == count || lengths[i] > lengths[longest])) {
+                longest = i;
+            }
+        }
+        lengths[longest]++;
+        kraft_sum -= 1U << (HUFFMAN_MAX_LENGTH - lengths[longest]);
+    }
+}
+
+/*
+* Function: build_code_lengths
+* ----------------------------
+*  Builds the Huffman code lengths of the byte counts, limited to
+*  HUFFMAN_MAX_LENGTH bits. The leaves are sorted by count, so the tree is
+*  built with two queues (leaves, and merged nodes in the order they are
+*  made) without a heap.
+*/
+static void build_code_lengths(const size_t counts[HUFFMAN_SYMBOLS], unsigned char lengths[HUFFMAN_SYMBOLS]) {
+    unsigned char leaves[HUFFMAN_SYMBOLS];
+    size_t leaf_count = 0;
+    memset(lengths, 0, HUFFMAN_SYMBOLS);
+    for (int symbol = 0; symbol < HUFFMAN_SYMBOLS; symbol++) {
+        if (counts[symbol] == 0) {
+            continue;
+        }
+        // Insertion sort by ascending count
+        size_t i = leaf_count++;
+        while (i > 0 && counts[leaves[i - 1]] > counts[symbol]) {
+            leaves[i] = leaves[i - 1];
+            i--;
+        }
+        leaves[i] = (unsigned char) symbol;
+    }
+    if (leaf_count <= 1) {
+        if (leaf_count == 1) {
+            lengths[leaves[0]] = 1;
+        }
+        return;
+    }
+
+    // Nodes [0, leaf_count) are the leaves, the merged nodes follow
+    size_t weights[2 * HUFFMAN_SYMBOLS];
+    size_t parents[2 * HUFFMAN_SYMBOLS];
+    unsigned char depths[2 * HUFFMAN_SYMBOLS];
+    size_t node_count = 2 * leaf_count - 1;
+    for (size_t i = 0; i < leaf_count; i++) {
+        weights[i] = counts[leaves[i]];
+    }
+    size_t next_leaf = 0;
+    size_t next_merged = leaf_count;
+    for (size_t node = leaf_count; node < node_count; node++) {
+        weights[node] = 0;
+        for (int child = 0; child < 2; child++) {
+            size_t smallest = next_leaf < leaf_count && (next_merged >= node || weights[next_leaf] <= weights[next_merged])
+                            ? next_leaf++
+                            : next_merged++;
+            weights[node] += weights[smallest];
+            parents[smallest] = node;
+        }
+    }
+    depths[node_count - 1] = 0;
+    for (size_t node = node_count - 1; node-- > 0;) {
+        size_t depth = depths[parents[node]] + 1;
+        depths[node] = depth < UINT8_MAX ? (unsigned char) depth : UINT8_MAX;
+    }
+
+    limit_code_lengths(depths, leaf_count);
+    for (size_t i = 0; i < leaf_count; i++) {
+        lengths[leaves[i]] = depths[i];
+    }
+}
+
+/*
+* Function: build_decode_table
+* ----------------------------
+*  Fills the decode table: entry i decodes the codes at the start of the
+*  HUFFMAN_MAX_LENGTH bits i (least significant bit first), one symbol, or
+*  two when the second code fits in the remaining bits too.
+*
+*  returns: If the code lengths are invalid (0), on success (1)
+*/
+static int build_decode_table(const unsigned char lengths[HUFFMAN_SYMBOLS], HuffmanEntry table[HUFFMAN_TABLE_SIZE]) {
+    uint32_t codes[HUFFMAN_SYMBOLS];
+    if (assign_codes(lengths, codes) == 0) {
+        return 0;
+    }
+
+    memset(table, 0, HUFFMAN_TABLE_SIZE * sizeof(HuffmanEntry));
+    for (int symbol = 0; symbol < HUFFMAN_SYMBOLS; symbol++) {
+        for (uint32_t i = codes[symbol]; lengths[symbol] > 0 && i < HUFFMAN_TABLE_SIZE; i += 1U << lengths[symbol]) {
+            table[i].symbols[0] = (unsigned char) symbol;
+            table[i].first_length = lengths[symbol];
+            table[i].length = lengths[symbol];
+        }
+    }
+
+    // The bits after the first code are known up to HUFFMAN_MAX_LENGTH, the missing high bits read as zero,
+    // so the single symbol entry of the rest is right whenever its code is short enough
+    for (uint32_t i = 0; i < HUFFMAN_TABLE_SIZE; i++) {
+        unsigned int first_length = table[i].first_length;
+        if (first_length == 0) {
+            continue;
+        }
+        const HuffmanEntry* second = &table[i >> first_length];
+        if (second->first_length > 0 && first_length + second->first_length <= HUFFMAN_MAX_LENGTH) {
+            table[i].symbols[1] = second->symbols[0];
+            table[i].length = (unsigned char) (first_length + second->first_length);
+        }
+    }
+    return 1;
+}
+
+/*
+* Function: huffman_encode
+* ------------------------
+*  Huffman codes bytes into memory.
+*
+*  input: Pointer to the bytes.
+*  size: Number of bytes.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*
+*  returns: Coded size. If it does not fit in output_capacity (-1).
+*/
+ssize_t huffman_encode(const unsigned char* input, size_t size, unsigned char* output, size_t output_capacity) {
+    if (output_capacity < HUFFMAN_HEADER_SIZE || size > UINT32_MAX) {
+        return -1;
+    }
+
+    // Four histograms, so consecutive equal bytes do not wait on the same counter
+    size_t histograms[4][HUFFMAN_SYMBOLS] = {{0}};
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        histograms[0][input[i]]++;
+        histograms[1][input[i + 1]]++;
+        histograms[2][input[i + 2]]++;
+        histograms[3][input[i + 3]]++;
+    }
+    for (; i < size; i++) {
+        histograms[0][input[i]]++;
+    }
+    size_t counts[HUFFMAN_SYMBOLS];
+    for (int symbol = 0; symbol < HUFFMAN_SYMBOLS; symbol++) {
+        counts[symbol] = histograms[0][symbol] + histograms[1][symbol] + histograms[2][symbol] + histograms[3][symbol];
+    }
+
+    unsigned char lengths[HUFFMAN_SYMBOLS];
+    uint32_t codes[HUFFMAN_SYMBOLS];
+    build_code_lengths(counts, lengths);
+    assign_codes(lengths, codes);
+
+    // Bail out early when the coded size is already known not to fit
+    size_t coded_bits = 0;
+    for (int symbol = 0; symbol < HUFFMAN_SYMBOLS; symbol++) {
+        coded_bits += counts[symbol] * lengths[symbol];
+    }
+    size_t coded_size = HUFFMAN_HEADER_SIZE + (coded_bits + 7) / 8;
+    if (coded_size > output_capacity) {
+        return -1;
+    }
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        output[shift / 8] = (unsigned char) (size >> shift);
+    }
+    for (int symbol = 0; symbol < HUFFMAN_SYMBOLS; symbol += 2) {
+        output[4 + symbol / 2] = (unsigned char) (lengths[symbol] | (lengths[symbol + 1] << 4));
+    }
+
+    // Whole 32-bit words are flushed, the codes never fill more than 32 + HUFFMAN_MAX_LENGTH bits
+    unsigned char* position = &output[HUFFMAN_HEADER_SIZE];
+    uint64_t bits = 0;
+    unsigned int bit_count = 0;
+    for (i = 0; i < size; i++) {
+        bits |= (uint64_t) codes[input[i]] << bit_count;
+        bit_count += lengths[input[i]];
+        if (bit_count >= 32) {
+            for (int byte = 0; byte < 4; byte++) {
+                *position++ = (unsigned char) (bits >> (8 * byte));
+            }
+            bits >>= 32;
+            bit_count -= 32;
+        }
+    }
+    while (bit_count > 0) {
+        *position++ = (unsigned char) bits;
+        bits >>= 8;
+        bit_count = bit_count > 8 ? bit_count - 8 : 0;
+    }
+    return position - output;
+}
+
+/*
+* Function: huffman_decode
+* ------------------------
+*  Decodes Huffman coded data into memory.
+*
+*  input: Pointer to the coded data.
+*  size: Coded data size.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*
+*  returns: Decoded size. If the data is corrupted or does not fit in output_capacity (-1).
+*/
+ssize_t huffman_decode(const unsigned char* input, size_t size, unsigned char* output, size_t output_capacity) {
+    if (size < HUFFMAN_HEADER_SIZE) {
+        return -1;
+    }
+    size_t decoded_size = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        decoded_size |= (size_t) input[shift / 8] << shift;
+    }
+    unsigned char lengths[HUFFMAN_SYMBOLS];
+    for (int symbol = 0; symbol < HUFFMAN_SYMBOLS; symbol += 2) {
+        lengths[symbol] = input[4 + symbol / 2] & 0x0F;
+        lengths[symbol + 1] = input[4 + symbol / 2] >> 4;
+    }
+    HuffmanEntry table[HUFFMAN_TABLE_SIZE];
+    if (decoded_size > output_capacity || build_decode_table(lengths, table) == 0) {
+        return -1;
+    }
+
+    const unsigned char* position = &input[HUFFMAN_HEADER_SIZE];
+    const unsigned char* end = &input[size];
+    uint64_t bits = 0;
+    unsigned int bit_count = 0;
+    size_t decoded = 0;
+
+    // Fast path: one 8-byte refill, then up to DECODES_PER_REFILL lookups of up to two symbols each
+    while (decoded_size - decoded >= 2 * DECODES_PER_REFILL && end - position >= 8) {
+        uint64_t word;
+        memcpy(&word, position, sizeof(uint64_t));
+        bits |= to_little_endian(word) << bit_count;
+        position += (63 - bit_count) >> 3;
+        bit_count |= 56;
+        for (int lookup = 0; lookup < DECODES_PER_REFILL; lookup++) {
+            const HuffmanEntry* entry = &table[bits & HUFFMAN_TABLE_MASK];
+            if (entry->length == 0) {
+                return -1;
+            }
+            output[decoded] = entry->symbols[0];
+            output[decoded + 1] = entry->symbols[1];
+            decoded += entry->length > entry->first_length ? 2 : 1;
+            bits >>= entry->length;
+            bit_count -= entry->length;
+        }
+    }
+
+    // Tail: one symbol at a time, refilled byte by byte
+    while (decoded < decoded_size) {
+        while (bit_count <= 56 && position < end) {
+            bits |= (uint64_t) *position++ << bit_count;
+            bit_count += 8;
+        }
+        const HuffmanEntry* entry = &table[bits & HUFFMAN_TABLE_MASK];
+        if (entry->first_length == 0 || entry->first_length > bit_count) {
+            return -1;
+        }
+        output[decoded++] = entry->symbols[0];
+        bits >>= entry->first_length;
+        bit_count -= entry->first_length;
+    }
+
+    // Everything but the padding of the last byte must have been used
+    if (position != end || bit_count >= 8) {
+        return -1;
+    }
+    return decoded_size;
+}
@@ -0,0 +1,286 @@
+#include "../include/io_ring.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+* Function: reset_io_ring
+* -----------------------
+*  Marks an IORing as not set up, so free_io_ring() has nothing to undo.
+*/
+static void reset_io_ring(IORing* ring) {
+    memset(ring, 0, sizeof(IORing));
+    ring->fd = -1;
+    ring->sq_ring = MAP_FAILED;
+    ring->cq_ring = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+}
+
+/*
+* Function: init_io_ring
+* ----------------------
+*  Sets up an io_uring instance with raw system calls (no liburing).
+*
+*  ring: Pointer to the IORing.
+*  entries: Submission queue entries (requests in flight at once).
+*
+*  returns: If io_uring is not available (0), on success (1)
+*/
+int init_io_ring(IORing* ring, unsigned entries) {
+    reset_io_ring(ring);
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        // Not built into the kernel, or disabled (e.g. by seccomp or kernel.io_uring_disabled)
+        return 0;
+    }
+    ring->fd = fd;
+    // Plain IORING_OP_READ/WRITE came with the current position feature (Linux 5.6)
+    if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+        free_io_ring(ring);
+        return 0;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        free_io_ring(ring);
+        return 0;
+    }
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+        ring->cq_ring_size = ring->sq_ring_size;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                             IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        free_io_ring(ring);
+        return 0;
+    }
+
+    unsigned char* sq = ring->sq_ring;
+    unsigned char* cq = ring->cq_ring;
+    ring->sq_head = (unsigned*) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes = cq + params.cq_off.cqes;
+    return 1;
+}
+
+/*
+* Function: register_io_buffers
+* -----------------------------
+*  Registers count buffers of buffer_size bytes, one after the other from
+*  buffers, with the kernel, so their pages are pinned once instead of on
+*  every request. Requests on a registered buffer give its index.
+*
+*  ring: Pointer to the initiated IORing.
+*  buffers: Pointer to the first buffer.
+*  buffer_size: Size of every buffer.
+*  count: Number of buffers.
+*
+*  returns: If not registered, e.g. over the locked memory limit (0), on success (1)
+*/
+int register_io_buffers(IORing* ring, unsigned char* buffers, size_t buffer_size, size_t count) {
+    if (ring->fd < 0 || ring->registered || buffers == NULL || count == 0 || count > UIO_MAXIOV) {
+        return 0;
+    }
+    struct iovec* vectors = malloc(count * sizeof(struct iovec));
+    if (vectors == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        vectors[i].iov_base = &buffers[i * buffer_size];
+        vectors[i].iov_len = buffer_size;
+    }
+    int result = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, vectors, (unsigned) count) == 0;
+    free(vectors);
+    ring->registered = result;
+    return result;
+}
+
+/*
+* Function: queue_io_request
+* --------------------------
+*  Fills the next submission queue entry with the part of a request that
+*  is not transferred yet (request->result bytes are done).
+*/
+static void queue_io_request(IORing* ring, const IORequest* request, size_t request_index) {
+    unsigned tail = *ring->sq_tail;
+    unsigned slot = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &((struct io_uring_sqe*) ring->sqes)[slot];
+    size_t done = (size_t) request->result;
+    int fixed = ring->registered && request->buffer_index >= 0;
+    memset(sqe, 0, sizeof(*sqe));
+    if (request->write) {
+        sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    } else {
+        sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    }
+    sqe->fd = request->fd;
+    sqe->addr = (uint64_t) (uintptr_t) &request->data[done];
+    sqe->len = (uint32_t) (request->size - done);
+    sqe->off = request->offset + done;
+    sqe->buf_index = fixed ? (uint16_t) request->buffer_index : 0;
+    sqe->user_data = request_index;
+    ring->sq_array[slot] = slot;
+    // The kernel may only see the new tail once the entry is filled
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+* Function: run_io_requests
+* -------------------------
+*  Submits reads and writes at once, keeping up to ring->entries of them
+*  in flight, and waits until all of them are done. Short transfers are
+*  resubmitted for the rest, so only a read at the end of a file comes
+*  back short.
+*
+*  ring: Pointer to the initiated IORing.
+*  requests: Pointer to the requests (their result fields are set).
+*  count: Number of requests.
+*
+*  returns: If any request failed (0), on success (1)
+*/
+int run_io_requests(IORing* ring, IORequest* requests, size_t count) {
+    size_t next = 0;
+    size_t in_flight = 0;
+    unsigned queued = 0;
+    int result = 1;
+    for (size_t i = 0; i < count; i++) {
+        requests[i].result = 0;
+    }
+    while (next < count || in_flight > 0) {
+        // Once a request failed, only the ones in flight are waited for
+        while (result && next < count && in_flight < ring->entries) {
+            if (requests[next].size > 0) {
+                queue_io_request(ring, &requests[next], next);
+                queued++;
+                in_flight++;
+            }
+            next++;
+        }
+        if (!result) {
+            next = count;
+        }
+        if (in_flight == 0) {
+            break;
+        }
+
+        int submitted = (int) syscall(__NR_io_uring_enter, ring->fd, queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            fprintf(stderr, "\n[ERROR]: run_io_requests() {} -> io_uring_enter failed (%s)!\n", strerror(errno));
+            return 0;
+        }
+        queued -= (unsigned) submitted;
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &((struct io_uring_cqe*) ring->cqes)[head & *ring->cq_mask];
+            IORequest* request = &requests[cqe->user_data];
+            int transferred = cqe->res;
+            in_flight--;
+            if (transferred == -EINTR || transferred == -EAGAIN) {
+                transferred = 0;
+            } else if (transferred < 0) {
+                request->result = transferred;
+                result = 0;
+                continue;
+            } else if (transferred == 0 && request->write) {
+                request->result = -EIO;
+                result = 0;
+                continue;
+            } else if (transferred == 0) {
+                continue;  // End of the file
+            }
+            request->result += transferred;
+            if ((size_t) request->result < request->size && result) {
+                queue_io_request(ring, request, (size_t) cqe->user_data);
+                queued++;
+                in_flight++;
+            }
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return result;
+}
+
+/*
+* Function: free_io_ring
+* ----------------------
+*  Unregisters the buffers and closes an IORing.
+*
+*  ring: Pointer to the IORing.
+*/
+void free_io_ring(IORing* ring) {
+    if (ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd >= 0) {
+        // Closing the ring also unregisters its buffers
+        close(ring->fd);
+    }
+    reset_io_ring(ring);
+}
+#else
+int init_io_ring(IORing* ring, unsigned entries) {
+    (void) entries;
+    memset(ring, 0, sizeof(IORing));
+    ring->fd = -1;
+    return 0;
+}
+
+int register_io_buffers(IORing* ring, unsigned char* buffers, size_t buffer_size, size_t count) {
+    (void) ring;
+    (void) buffers;
+    (void) buffer_size;
+    (void) count;
+    return 0;
+}
+
+int run_io_requests(IORing* ring, IORequest* requests, size_t count) {
+    (void) ring;
+    for (size_t i = 0; i < count; i++) {
+        requests[i].result = -ENOSYS;
+    }
+    return count == 0;
+}
+
+void free_io_ring(IORing* ring) {
+    (void) ring;
+}
+#endif
@@ -0,0 +1,170 @@
+#include "../include/pipeline.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+typedef struct {
+    const Pipeline* pipeline;
+    size_t read_count;     // Slots filled so far
+    size_t coded_count;    // Slots coded so far
+    size_t written_count;  // Slots written (and freed) so far
+    int reading_done;
+    int coding_done;
+    int failed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} PipelineState;
+
+/*
+* Function: finish_stage
+* ----------------------
+*  Records the result of a stage and wakes up the other stages.
+*/
+static void finish_stage(PipelineState* state, int result, size_t* count, int* done) {
+    pthread_mutex_lock(&state->lock);
+    if (result < 0) {
+        state->failed = 1;
+    } else if (result == 0) {
+        *done = 1;
+    } else {
+        (*count)++;
+    }
+    pthread_cond_broadcast(&state->changed);
+    pthread_mutex_unlock(&state->lock);
+}
+
+/*
+* Function: reader_main
+* ---------------------
+*  Reader thread loop: fills the slots as soon as the writer frees them.
+*/
+static void* reader_main(void* arg) {
+    PipelineState* state = arg;
+    const Pipeline* pipeline = state->pipeline;
+
+    while (1) {
+        pthread_mutex_lock(&state->lock);
+        while (state->read_count - state->written_count == pipeline->slot_count && !state->failed) {
+            pthread_cond_wait(&state->changed, &state->lock);
+        }
+        int failed = state->failed;
+        size_t slot = state->read_count % pipeline->slot_count;
+        pthread_mutex_unlock(&state->lock);
+        if (failed) {
+            break;
+        }
+
+        int result = pipeline->read(pipeline->context, slot);
+        finish_stage(state, result, &state->read_count, &state->reading_done);
+        if (result <= 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*
+* Function: writer_main
+* ---------------------
+*  Writer thread loop: writes the coded slots in order.
+*/
+static void* writer_main(void* arg) {
+    PipelineState* state = arg;
+    const Pipeline* pipeline = state->pipeline;
+
+    while (1) {
+        pthread_mutex_lock(&state->lock);
+        while (state->written_count == state->coded_count && !state->coding_done && !state->failed) {
+            pthread_cond_wait(&state->changed, &state->lock);
+        }
+        int finished = state->failed || state->written_count == state->coded_count;
+        size_t slot = state->written_count % pipeline->slot_count;
+        pthread_mutex_unlock(&state->lock);
+        if (finished) {
+            break;
+        }
+
+        int result = pipeline->write(pipeline->context, slot);
+        finish_stage(state, result < 0 ? -1 : 1, &state->written_count, NULL);
+        if (result < 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*
+* Function: run_pipeline
+* ----------------------
+*  Runs the read, code and write stages of a Pipeline at the same time: a
+*  reader thread and a writer thread are started, and the calling thread
+*  codes. The stages pass a ring of slot_count reusable slots along in
+*  order, so while slot N is coded, slot N + 1 is read and slot N - 1 is
+*  written. Every stage only touches the slot it is given, so the slots
+*  need no locking of their own. With a single slot, the stages run one
+*  after the other in the calling thread.
+*
+*  pipeline: Pointer to the Pipeline.
+*
+*  returns: If any stage failed (0), on success (1)
+*/
+int run_pipeline(const Pipeline* pipeline) {
+    if (pipeline == NULL || pipeline->read == NULL || pipeline->code == NULL || pipeline->write == NULL ||
+        pipeline->slot_count == 0) {
+        fprintf(stderr, "\n[ERROR]: run_pipeline() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    // A single slot cannot overlap anything: run the stages one after the other
+    if (pipeline->slot_count == 1) {
+        int result = 1;
+        while (result > 0 && (result = pipeline->read(pipeline->context, 0)) > 0) {
+            result = pipeline->code(pipeline->context, 0);
+            if (result > 0) {
+                result = pipeline->write(pipeline->context, 0);
+            }
+        }
+        return result >= 0;
+    }
+
+    PipelineState state = {pipeline, 0, 0, 0, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+    pthread_t reader;
+    pthread_t writer;
+    if (pthread_create(&reader, NULL, reader_main, &state) != 0) {
+        fprintf(stderr, "\n[ERROR]: run_pipeline() {} -> Unable to start the reader thread!\n");
+        return 0;
+    }
+    if (pthread_create(&writer, NULL, writer_main, &state) != 0) {
+        fprintf(stderr, "\n[ERROR]: run_pipeline() {} -> Unable to start the writer thread!\n");
+        finish_stage(&state, -1, NULL, NULL);
+        pthread_join(reader, NULL);
+        return 0;
+    }
+
+    // Code the filled slots until the reader runs dry
+    while (1) {
+        pthread_mutex_lock(&state.lock);
+        while (state.coded_count == state.read_count && !state.reading_done && !state.failed) {
+            pthread_cond_wait(&state.changed, &state.lock);
+        }
+        int finished = state.failed || state.coded_count == state.read_count;
+        size_t slot = state.coded_count % pipeline->slot_count;
+        pthread_mutex_unlock(&state.lock);
+        if (finished) {
+            break;
+        }
+
+        int result = pipeline->code(pipeline->context, slot);
+        finish_stage(&state, result < 0 ? -1 : 1, &state.coded_count, NULL);
+        if (result < 0) {
+            break;
+        }
+    }
+    finish_stage(&state, 0, NULL, &state.coding_done);
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+    pthread_mutex_destroy(&state.lock);
+    pthread_cond_destroy(&state.changed);
+    return !state.failed;
+}
@@ -0,0 +1,159 @@
+#include "../include/pool.h"
+#include "../include/constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+* Function: get_size_class
+* ------------------------
+*  Finds the smallest size class (power of two, MIN_POOL_BUFFER_SIZE and
+*  up) that holds size bytes.
+*
+*  returns: Size class index. If larger than every class (-1).
+*/
+static int get_size_class(size_t size, size_t* class_size) {
+    size_t current = MIN_POOL_BUFFER_SIZE;
+    for (int i = 0; i < BUFFER_POOL_CLASSES; i++) {
+        if (size <= current) {
+            *class_size = current;
+            return i;
+        }
+        current <<= 1;
+    }
+    return -1;
+}
+
+/*
+* Function: alloc_pool_buffer
+* ---------------------------
+*  Allocates a buffer of size bytes from the system, aligned to
+*  IO_BUFFER_ALIGNMENT, or to HUGE_PAGE_SIZE and backed by transparent huge
+*  pages when asked for and size is a whole number of huge pages.
+*
+*  returns: Pointer to the buffer. If failed (NULL).
+*/
+static void* alloc_pool_buffer(size_t size, int huge_pages) {
+    void* buffer = NULL;
+    int huge = huge_pages && size >= HUGE_PAGE_SIZE && size % HUGE_PAGE_SIZE == 0;
+    if (posix_memalign(&buffer, huge ? HUGE_PAGE_SIZE : IO_BUFFER_ALIGNMENT, size) != 0) {
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge) {
+        // Only a hint: without THP (or with it set to 'never') the buffer stays on normal pages
+        madvise(buffer, size, MADV_HUGEPAGE);
+    }
+#endif
+    return buffer;
+}
+
+/*
+* Function: init_buffer_pool
+* --------------------------
+*  Initiates an empty BufferPool. Released buffers are kept by size class
+*  (powers of two) and handed out again, so a codec that runs many times
+*  allocates nothing once every size it needs was used once.
+*
+*  pool: Pointer to the BufferPool to initiate.
+*  huge_pages: Align buffers of HUGE_PAGE_SIZE and up to it and ask for
+*              transparent huge pages (madvise), fewer TLB misses on large blocks.
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_buffer_pool(BufferPool* pool, int huge_pages) {
+    if (pool == NULL) {
+        fprintf(stderr, "\n[ERROR]: init_buffer_pool() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+    memset(pool, 0, sizeof(BufferPool));
+    pool->huge_pages = huge_pages;
+    if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+        fprintf(stderr, "\n[ERROR]: init_buffer_pool() {} -> Unable to initiate the lock!\n");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+* Function: acquire_buffer
+* ------------------------
+*  Hands out a buffer of at least size bytes, aligned to IO_BUFFER_ALIGNMENT
+*  (or HUGE_PAGE_SIZE), from the free list of its size class, or allocates
+*  it when the list is empty. The content is not cleared.
+*
+*  pool: Pointer to the initiated BufferPool.
+*  size: Buffer size.
+*
+*  returns: Pointer to the buffer. If failed (NULL).
+*/
+void* acquire_buffer(BufferPool* pool, size_t size) {
+    size_t class_size = size;
+    int size_class = get_size_class(size, &class_size);
+    pthread_mutex_lock(&pool->lock);
+    void* buffer = size_class >= 0 ? pool->free_lists[size_class] : NULL;
+    if (buffer != NULL) {
+        memcpy(&pool->free_lists[size_class], buffer, sizeof(void*));
+        pool->reuses++;
+    } else {
+        pool->allocations++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (buffer == NULL) {
+        buffer = alloc_pool_buffer(class_size, pool->huge_pages);
+        if (buffer == NULL) {
+            fprintf(stderr, "\n[ERROR]: acquire_buffer() {} -> Unable to allocate memory for the buffer!\n");
+        }
+    }
+    return buffer;
+}
+
+/*
+* Function: release_buffer
+* ------------------------
+*  Gives a buffer of acquire_buffer() back to its size class.
+*
+*  pool: Pointer to the initiated BufferPool.
+*  buffer: Pointer to the buffer (NULL is ignored).
+*  size: Size the buffer was acquired with.
+*/
+void release_buffer(BufferPool* pool, void* buffer, size_t size) {
+    if (buffer == NULL) {
+        return;
+    }
+    size_t class_size = size;
+    int size_class = get_size_class(size, &class_size);
+    if (size_class < 0) {
+        free(buffer);
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    memcpy(buffer, &pool->free_lists[size_class], sizeof(void*));
+    pool->free_lists[size_class] = buffer;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+* Function: free_buffer_pool
+* --------------------------
+*  Frees the released buffers of a BufferPool (acquired buffers must be
+*  released first).
+*
+*  pool: Pointer to the initiated BufferPool.
+*/
+void free_buffer_pool(BufferPool* pool) {
+    for (int i = 0; i < BUFFER_POOL_CLASSES; i++) {
+        void* buffer = pool->free_lists[i];
+        while (buffer != NULL) {
+            void* next;
+            memcpy(&next, buffer, sizeof(void*));
+            free(buffer);
+            buffer = next;
+        }
+        pool->free_lists[i] = NULL;
+    }
+    pthread_mutex_destroy(&pool->lock);
+}
@@ -1,181 +1,1280 @@
 #include "../include/constants.h"
 #include "../include/rle.h"
+#include "../include/simd.h"
 #include "../include/utils.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 #include <unistd.h>
 
+// The encode/decode loops are written once as KERNEL_INLINE bodies that take the compression mode (or
+// element width) as a parameter, and instantiated once per mode/width with a constant, so the per-token
+// mode tests fold away; the public functions pick the instance once per call (block or chunk)
+#if defined(__GNUC__)
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE static inline
+#endif
+
+/*
+* Function: reserve_output
+* ------------------------
+*  Checks that a memory RLEWriter (no output file) has room for the next
+*  bytes. File writers always have room, since they flush when full. No
+*  error is printed, since encode_block() stores a block that does not fit.
+*
+*  rle_writer: Pointer to the initiated RLEWriter.
+*  size: Number of bytes about to be written.
+*
+*  returns: If the output buffer is full (0), otherwise (1).
+*/
+static int reserve_output(RLEWriter* rle_writer, size_t size) {
+    if (rle_writer->file != NULL || rle_writer->buffer_pos + size <= rle_writer->buffer_size) {
+        return 1;
+    }
+    return 0;
+}
+
+/*
+* Function: drain_writer
+* ----------------------
+*  Writes the RLEWriter buffer to the output file once it is full. Memory
+*  writers keep everything in their buffer.
+*
+*  rle_writer: Pointer to the initiated RLEWriter.
+*
+*  returns: If failed (0), on success (1).
+*/
+static int drain_writer(RLEWriter* rle_writer) {
+    if (rle_writer->file != NULL && rle_writer->buffer_pos >= rle_writer->buffer_size) {
+        double start_time = rle_writer->stats != NULL ? get_wall_time() : 0;
+        size_t result = fwrite(rle_writer->buffer, sizeof(unsigned char), rle_writer->buffer_pos, rle_writer->file);
+        if (rle_writer->stats != NULL) {
+            rle_writer->stats->output_writes++;
+            rle_writer->stats->write_time += get_wall_time() - start_time;
+        }
+        if (result < rle_writer->buffer_pos) {
+            fprintf(stderr, "\n[ERROR]: drain_writer() {} -> Unable to flush the buffer!\n");
+            return 0;
+        }
+        rle_writer->buffer_pos = 0;
+        rle_writer->counter_pos = -1;
+    }
+    return 1;
+}
+
+/*
+* Function: emit_mode_token
+* -------------------------
+*  Writes the pending run (flag_byte x flag_byte_count) of the RLEWriter to
+*  its buffer, as a run token or as part of an uncompressed sequence in
+*  advance mode, and flushes the buffer once it is full.
+*
+*  rle_writer: Pointer to the initiated RLEWriter.
+*  compression_mode: Compression mode of the writer (a constant in every instance).
+*
+*  returns: If failed (0), on success (1).
+*/
+KERNEL_INLINE int emit_mode_token(RLEWriter* rle_writer, CompressionMode compression_mode) {
+    size_t counter_padding = compression_mode == advance ? 126 : 0;
+    size_t count_limit = compression_mode == basic ? BASIC_COMPRESSION_LIMIT : ADVANCE_COMPRESSION_LIMIT;
+
+    if (!reserve_output(rle_writer, rle_writer->counter_pos > -1 ? 1 : 2)) {
+        return 0;
+    }
+
+    if (rle_writer->flag_byte_count > 1 || compression_mode == basic) {
+        rle_writer->buffer[rle_writer->buffer_pos++] = rle_writer->flag_byte_count + counter_padding;
+        rle_writer->buffer[rle_writer->buffer_pos++] = rle_writer->flag_byte;
+        if (rle_writer->stats != NULL) {
+            count_run_token(rle_writer->stats, rle_writer->flag_byte_count);
+        }
+    } else {
+        if (rle_writer->counter_pos > -1) {
+            // Increase the counter for uncompressed sequence
+            rle_writer->buffer[rle_writer->counter_pos]++;
+            // Reset counter position for uncompressed sequence, if the counter is about to pass the limit
+            if ((size_t) rle_writer->buffer[rle_writer->counter_pos] + 1 >= count_limit) {
+                rle_writer->counter_pos = -1;
+            }
+            rle_writer->buffer[rle_writer->buffer_pos++] = rle_writer->flag_byte;
+        } else {
+            rle_writer->counter_pos = rle_writer->buffer_pos;
+            rle_writer->buffer[rle_writer->buffer_pos++] = 1;
+            rle_writer->buffer[rle_writer->buffer_pos++] = rle_writer->flag_byte;
+            if (rle_writer->stats != NULL) {
+                rle_writer->stats->literal_tokens++;
+            }
+        }
+    }
+    return drain_writer(rle_writer);
+}
+
+/*
+* Function: emit_token
+* --------------------
+*  Same as emit_mode_token(), for the compression mode of the RLEWriter.
+*/
+static int emit_token(RLEWriter* rle_writer) {
+    return rle_writer->compression_mode == basic ? emit_mode_token(rle_writer, basic)
+                                                 : emit_mode_token(rle_writer, advance);
+}
+
+/*
+* Function: emit_literals
+* -----------------------
+*  Appends single (unrepeated) bytes to uncompressed sequences (advance
+*  mode only). Same output as emitting them one by one with emit_token(),
+*  but copies as many bytes as the counter and the buffer allow at once.
+*
+*  rle_writer: Pointer to the initiated RLEWriter.
+*  bytes: Pointer to the single bytes.
+*  count: Number of bytes.
+*
+*  returns: If failed (0), on success (1).
+*/
+static int emit_literals(RLEWriter* rle_writer, const unsigned char* bytes, size_t count) {
+    while (count > 0) {
+        if (rle_writer->counter_pos < 0) {
+            if (!reserve_output(rle_writer, 2)) {
+                return 0;
+            }
+            rle_writer->counter_pos = rle_writer->buffer_pos;
+            rle_writer->buffer[rle_writer->buffer_pos++] = 1;
+            rle_writer->buffer[rle_writer->buffer_pos++] = *bytes++;
+            count--;
+            if (rle_writer->stats != NULL) {
+                rle_writer->stats->literal_tokens++;
+            }
+        } else {
+            size_t n = ADVANCE_COMPRESSION_LIMIT - 1 - rle_writer->buffer[rle_writer->counter_pos];
+            if (n > rle_writer->buffer_size - rle_writer->buffer_pos) {
+                n = rle_writer->buffer_size - rle_writer->buffer_pos;
+            }
+            if (n > count) {
+                n = count;
+            }
+            if (n == 0 && !reserve_output(rle_writer, 1)) {
+                return 0;
+            }
+            memcpy(&rle_writer->buffer[rle_writer->buffer_pos], bytes, n);
+            rle_writer->buffer[rle_writer->counter_pos] += n;
+            rle_writer->buffer_pos += n;
+            bytes += n;
+            count -= n;
+            if (rle_writer->buffer[rle_writer->counter_pos] + 1 >= ADVANCE_COMPRESSION_LIMIT) {
+                rle_writer->counter_pos = -1;
+            }
+        }
+        if (drain_writer(rle_writer) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+* Function: setup_writer
+* ----------------------
+*  Sets every RLEWriter field for a fresh stream.
+*/
+static void setup_writer(RLEWriter* rle_writer, FILE* file, unsigned char* buffer, size_t buffer_size,
+                         CompressionMode compression_mode) {
+    rle_writer->file = file;
+    rle_writer->compression_mode = compression_mode;
+    rle_writer->count_limit = compression_mode == basic ? BASIC_COMPRESSION_LIMIT : ADVANCE_COMPRESSION_LIMIT;
+    rle_writer->counter_pos = -1;
+    rle_writer->buffer_size = buffer_size;
+    rle_writer->buffer = buffer;
+    rle_writer->buffer_pos = 0;
+    rle_writer->flag_byte = 0;
+    rle_writer->flag_byte_count = 0;
+    rle_writer->stats = NULL;
+    rle_writer->owns_buffer = 0;
+}
+
+/*
+* Function: setup_reader
+* ----------------------
+*  Sets every RLEReader field for a fresh stream.
+*/
+static void setup_reader(RLEReader* rle_reader, FILE* file, unsigned char* buffer, size_t buffer_size,
+                         CompressionMode compression_mode) {
+    rle_reader->file = file;
+    rle_reader->compression_mode = compression_mode;
+    rle_reader->buffer_size = buffer_size;
+    rle_reader->buffer = buffer;
+    rle_reader->buffer_pos = 0;
+    rle_reader->state = read_counter;
+    rle_reader->token_remaining = 0;
+    rle_reader->owns_buffer = 0;
+}
+
 /*
 * Function: init_writer
 * ---------------------
 *  Initiates the RLEWriter object.
 *
-*  rle_writer: Pointer to the RLEWriter to initiate.
-*  file: Pointer to the output file.
-*  writer_buffer_size: RLEWriter buffer (output buffer) size 
+*  rle_writer: Pointer to the RLEWriter to initiate.
+*  file: Pointer to the output file.
+*  writer_buffer_size: RLEWriter buffer (output buffer) size 
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_writer(RLEWriter* rle_writer, FILE* file, size_t writer_buffer_size, CompressionMode compression_mode) {
+    if (file == NULL || rle_writer == NULL || writer_buffer_size == 0) {
+        fprintf(stderr, "[ERROR]: init_writer() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    // A run token may start on the last free byte, so keep one byte of slack past buffer_size
+    unsigned char* buffer = malloc(writer_buffer_size * sizeof(unsigned char) + 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "[ERROR]: init_writer() {} -> Unable to allocate memory for the buffer!\n");
+        return 0;
+    }
+    setup_writer(rle_writer, file, buffer, writer_buffer_size * sizeof(unsigned char), compression_mode);
+    rle_writer->owns_buffer = 1;
+    return 1;
+}
+
+/*
+* Function: init_writer_with_buffer
+* ---------------------------------
+*  Same as init_writer(), but the output buffer is caller owned (e.g. kept
+*  by an RLEContext between payloads), so nothing is allocated.
+*
+*  rle_writer: Pointer to the RLEWriter to initiate.
+*  file: Pointer to the output file.
+*  buffer: Pointer to the output buffer (writer_buffer_size + 1 bytes).
+*  writer_buffer_size: RLEWriter buffer (output buffer) size
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_writer_with_buffer(RLEWriter* rle_writer, FILE* file, unsigned char* buffer, size_t writer_buffer_size,
+                            CompressionMode compression_mode) {
+    if (file == NULL || rle_writer == NULL || buffer == NULL || writer_buffer_size == 0) {
+        fprintf(stderr, "[ERROR]: init_writer_with_buffer() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    setup_writer(rle_writer, file, buffer, writer_buffer_size, compression_mode);
+    return 1;
+}
+
+/*
+* Function: init_memory_writer
+* ----------------------------
+*  Initiates an RLEWriter that writes into a caller owned buffer instead of
+*  a file. Nothing is allocated, and writing fails once the buffer is full.
+*
+*  rle_writer: Pointer to the RLEWriter to initiate.
+*  output: Pointer to the output buffer.
+*  output_size: Output buffer size.
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_memory_writer(RLEWriter* rle_writer, unsigned char* output, size_t output_size,
+                       CompressionMode compression_mode) {
+    if (rle_writer == NULL || (output == NULL && output_size > 0)) {
+        fprintf(stderr, "[ERROR]: init_memory_writer() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    setup_writer(rle_writer, NULL, output, output_size, compression_mode);
+    return 1;
+}
+
+/*
+* Function: init_reader
+* ---------------------
+*  Initiates the RLEReader object.
+*
+*  rle_reader: Pointer to the RLEReader to initiate.
+*  file: Pointer to the output file.
+*  reader_buffer_size: RLEReader buffer (output buffer) size 
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_reader(RLEReader* rle_reader, FILE* file, size_t reader_buffer_size, CompressionMode compression_mode) {
+    if (file == NULL || rle_reader == NULL) {
+        fprintf(stderr, "[ERROR]: init_reader() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    unsigned char* buffer = malloc(reader_buffer_size * sizeof(unsigned char));
+    if (buffer == NULL) {
+        fprintf(stderr, "[ERROR]: init_reader() {} -> Unable to allocate memory for the buffer!\n");
+        return 0;
+    }
+    setup_reader(rle_reader, file, buffer, reader_buffer_size * sizeof(unsigned char), compression_mode);
+    rle_reader->owns_buffer = 1;
+    return 1;
+}
+
+/*
+* Function: init_reader_with_buffer
+* ---------------------------------
+*  Same as init_reader(), but the output buffer is caller owned (e.g. kept
+*  by an RLEContext between payloads), so nothing is allocated.
+*
+*  rle_reader: Pointer to the RLEReader to initiate.
+*  file: Pointer to the output file.
+*  buffer: Pointer to the output buffer (reader_buffer_size bytes).
+*  reader_buffer_size: RLEReader buffer (output buffer) size
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_reader_with_buffer(RLEReader* rle_reader, FILE* file, unsigned char* buffer, size_t reader_buffer_size,
+                            CompressionMode compression_mode) {
+    if (file == NULL || rle_reader == NULL || buffer == NULL || reader_buffer_size == 0) {
+        fprintf(stderr, "[ERROR]: init_reader_with_buffer() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    setup_reader(rle_reader, file, buffer, reader_buffer_size, compression_mode);
+    return 1;
+}
+
+/*
+* Function: free_writer
+* ---------------------
+*  Frees the output buffer allocated by init_writer(). Caller owned
+*  buffers (memory writers, init_writer_with_buffer()) are left alone.
+*
+*  rle_writer: Pointer to the RLEWriter.
+*/
+void free_writer(RLEWriter* rle_writer) {
+    if (rle_writer == NULL) {
+        return;
+    }
+    if (rle_writer->owns_buffer) {
+        free(rle_writer->buffer);
+    }
+    rle_writer->buffer = NULL;
+    rle_writer->buffer_size = 0;
+    rle_writer->owns_buffer = 0;
+}
+
+/*
+* Function: free_reader
+* ---------------------
+*  Frees the output buffer allocated by init_reader(). Caller owned
+*  buffers (memory readers, init_reader_with_buffer()) are left alone.
+*
+*  rle_reader: Pointer to the RLEReader.
+*/
+void free_reader(RLEReader* rle_reader) {
+    if (rle_reader == NULL) {
+        return;
+    }
+    if (rle_reader->owns_buffer) {
+        free(rle_reader->buffer);
+    }
+    rle_reader->buffer = NULL;
+    rle_reader->buffer_size = 0;
+    rle_reader->owns_buffer = 0;
+}
+
+/*
+* Function: init_memory_reader
+* ----------------------------
+*  Initiates an RLEReader that decodes into a caller owned buffer instead of
+*  a file. Nothing is allocated, and decoding fails once the buffer is full.
+*
+*  rle_reader: Pointer to the RLEReader to initiate.
+*  output: Pointer to the output buffer.
+*  output_size: Output buffer size.
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_memory_reader(RLEReader* rle_reader, unsigned char* output, size_t output_size,
+                       CompressionMode compression_mode) {
+    if (rle_reader == NULL || (output == NULL && output_size > 0)) {
+        fprintf(stderr, "[ERROR]: init_memory_reader() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    setup_reader(rle_reader, NULL, output, output_size, compression_mode);
+    return 1;
+}
+
+/*
+* Function: write_rle
+* -------------------
+*  Encodes and write RLE for the given character.
+*
+*  rle_writer: Pointer to the initiated RLEWriter.
+*  chr: Pointer to the character from file.
+*
+*  returns: If failed (0), on success (1).
+*/
+int write_rle(RLEWriter* rle_writer, unsigned char* chr) {
+    if (rle_writer == NULL || chr == NULL) {
+        fprintf(stderr, "\n[ERROR]: write_rle() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    if (rle_writer->flag_byte_count == 0) {
+        rle_writer->flag_byte = *chr;
+    }
+
+    if (rle_writer->flag_byte == *chr && rle_writer->flag_byte_count < rle_writer->count_limit) {
+        rle_writer->flag_byte_count++;
+        rle_writer->counter_pos = -1;
+    } else {
+        if (emit_token(rle_writer) == 0) {
+            return 0;
+        }
+        rle_writer->flag_byte = *chr;
+        rle_writer->flag_byte_count = 1;
+    }
+    return 1;
+}
+
+/*
+* Function: write_mode_chunk
+* --------------------------
+*  Body of write_rle_chunk() for one compression mode (a constant in every
+*  instance, see DEFINE_WRITE_KERNEL).
+*/
+KERNEL_INLINE int write_mode_chunk(RLEWriter* rle_writer, const unsigned char* chunk, size_t chunk_size,
+                                   CompressionMode compression_mode) {
+    size_t count_limit = compression_mode == basic ? BASIC_COMPRESSION_LIMIT : ADVANCE_COMPRESSION_LIMIT;
+    if (rle_writer->flag_byte_count == 0) {
+        rle_writer->flag_byte = chunk[0];
+    }
+
+    size_t i = 0;
+    while (i < chunk_size) {
+        // Extend the pending run as far as the counter limit allows
+        size_t room = count_limit - rle_writer->flag_byte_count;
+        if (room > chunk_size - i) {
+            room = chunk_size - i;
+        }
+        size_t run = 0;
+        if (room > 0 && chunk[i] == rle_writer->flag_byte) {
+            run = find_run_length(&chunk[i], room, rle_writer->flag_byte);
+        }
+        if (run > 0) {
+            rle_writer->flag_byte_count += run;
+            rle_writer->counter_pos = -1;
+            i += run;
+            if (i == chunk_size) {
+                break;
+            }
+        }
+
+        // A single byte followed by bytes that all differ from their next byte
+        // (advance mode): write the whole uncompressed sequence at once
+        if (compression_mode == advance && rle_writer->flag_byte_count == 1) {
+            size_t singles = find_repeat(&chunk[i], chunk_size - i);
+            if (singles == chunk_size - i) {
+                // No repeat left in this chunk, the last byte stays pending
+                singles--;
+            }
+            int result = i > 0 ? emit_literals(rle_writer, &chunk[i - 1], singles + 1)
+                               : emit_literals(rle_writer, &rle_writer->flag_byte, 1) &&
+                                 emit_literals(rle_writer, chunk, singles);
+            if (result == 0) {
+                return 0;
+            }
+            i += singles;
+            rle_writer->flag_byte = chunk[i++];
+            rle_writer->flag_byte_count = 1;
+            continue;
+        }
+
+        // Run ended (different byte or counter limit), start a new one
+        if (emit_mode_token(rle_writer, compression_mode) == 0) {
+            return 0;
+        }
+        rle_writer->flag_byte = chunk[i++];
+        rle_writer->flag_byte_count = 1;
+    }
+    return 1;
+}
+
+// write_basic_chunk() and write_advance_chunk()
+#define DEFINE_WRITE_KERNEL(mode)                                                                           \
+    static int write_##mode##_chunk(RLEWriter* rle_writer, const unsigned char* chunk, size_t chunk_size) { \
+        return write_mode_chunk(rle_writer, chunk, chunk_size, mode);                                       \
+    }
+DEFINE_WRITE_KERNEL(basic)
+DEFINE_WRITE_KERNEL(advance)
+
+/*
+* Function: write_rle_chunk
+* -------------------------
+*  Encodes and writes RLE for a whole chunk of input. Produces exactly the
+*  same output as calling write_rle() for every byte of the chunk, but scans
+*  runs and uncompressed sequences with the SIMD kernels and emits them in
+*  bulk, in the instance of the loop for the mode of the writer.
+*
+*  rle_writer: Pointer to the initiated RLEWriter.
+*  chunk: Pointer to the input chunk.
+*  chunk_size: Number of bytes in the chunk.
+*
+*  returns: If failed (0), on success (1).
+*/
+int write_rle_chunk(RLEWriter* rle_writer, const unsigned char* chunk, size_t chunk_size) {
+    if (rle_writer == NULL || (chunk == NULL && chunk_size > 0)) {
+        fprintf(stderr, "\n[ERROR]: write_rle_chunk() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+    if (chunk_size == 0) {
+        return 1;
+    }
+    return rle_writer->compression_mode == basic ? write_basic_chunk(rle_writer, chunk, chunk_size)
+                                                 : write_advance_chunk(rle_writer, chunk, chunk_size);
+}
+
+/*
+* Function: make_room
+* -------------------
+*  Flushes a full RLEReader buffer. Fails for memory readers (no output
+*  file), since their buffer is the whole output.
+*
+*  rle_reader: Pointer to the initiated RLEReader.
+*
+*  returns: If failed (0), on success (1).
+*/
+static int make_room(RLEReader* rle_reader) {
+    if (rle_reader->buffer_pos < rle_reader->buffer_size) {
+        return 1;
+    }
+    if (rle_reader->file == NULL) {
+        fprintf(stderr, "\n[ERROR]: make_room() {} -> Output buffer is full!\n");
+        return 0;
+    }
+    return flush_reader(rle_reader) >= 0;
+}
+
+/*
+* Function: output_run
+* --------------------
+*  Writes count copies of value to the RLEReader buffer with memset,
+*  flushing the buffer whenever it fills up.
+*
+*  rle_reader: Pointer to the initiated RLEReader.
+*  value: The run byte.
+*  count: Run length.
+*
+*  returns: If failed (0), on success (1).
+*/
+static int output_run(RLEReader* rle_reader, unsigned char value, size_t count) {
+    while (count > 0) {
+        if (make_room(rle_reader) == 0) {
+            return 0;
+        }
+        size_t n = rle_reader->buffer_size - rle_reader->buffer_pos;
+        if (n > count) {
+            n = count;
+        }
+        memset(&rle_reader->buffer[rle_reader->buffer_pos], value, n);
+        rle_reader->buffer_pos += n;
+        count -= n;
+    }
+    return 1;
+}
+
+/*
+* Function: output_literals
+* -------------------------
+*  Copies an uncompressed sequence to the RLEReader buffer with memcpy,
+*  flushing the buffer whenever it fills up.
+*
+*  rle_reader: Pointer to the initiated RLEReader.
+*  bytes: Pointer to the uncompressed bytes.
+*  count: Number of bytes.
+*
+*  returns: If failed (0), on success (1).
+*/
+static int output_literals(RLEReader* rle_reader, const unsigned char* bytes, size_t count) {
+    while (count > 0) {
+        if (make_room(rle_reader) == 0) {
+            return 0;
+        }
+        size_t n = rle_reader->buffer_size - rle_reader->buffer_pos;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(&rle_reader->buffer[rle_reader->buffer_pos], bytes, n);
+        rle_reader->buffer_pos += n;
+        bytes += n;
+        count -= n;
+    }
+    return 1;
+}
+
+/*
+* Function: read_rle
+* -------------------
+*  Decodes and write uncompressed data for the given compressed stream.
+*
+*  rle_reader: Pointer to the initiated RLEReader.
+*  counter_byter: Pointer to the counter byte in compressed stream.
+*
+*  returns: Decoded bytes count.
+*/
+size_t read_rle(RLEReader* rle_reader, unsigned char* counter_byte) {
+    int count = *counter_byte;
+    if (rle_reader->compression_mode == advance && *counter_byte >= ADVANCE_COMPRESSION_LIMIT) {
+        count -= 126;
+    }
+    if (count <= 0) {
+        fprintf(stderr, "\n[ERROR]: read_rle() {} -> Invalid value (count = %d)\n", count);
+        return 0;
+    }
+
+    if (rle_reader->compression_mode == basic || *counter_byte >= ADVANCE_COMPRESSION_LIMIT) {
+        output_run(rle_reader, *(counter_byte + 1), count);
+        return 1;
+    }
+    output_literals(rle_reader, counter_byte + 1, count);
+    return count;
+}
+
+/*
+* Function: read_mode_chunk
+* -------------------------
+*  Body of read_rle_chunk() for one compression mode (a constant in every
+*  instance, see DEFINE_READ_KERNEL).
+*/
+KERNEL_INLINE ssize_t read_mode_chunk(RLEReader* rle_reader, const unsigned char* chunk, size_t chunk_size,
+                                      CompressionMode compression_mode) {
+    size_t i = 0;
+    while (i < chunk_size) {
+        switch (rle_reader->state) {
+            case read_counter: {
+                unsigned char counter = chunk[i++];
+                if (counter == 0) {
+                    fprintf(stderr, "\n[ERROR]: read_mode_chunk() {} -> Invalid value (count = 0)\n");
+                    return -1;
+                }
+                if (compression_mode == basic || counter >= ADVANCE_COMPRESSION_LIMIT) {
+                    size_t count = compression_mode == basic ? counter : (size_t) counter - 126;
+                    if (i < chunk_size) {
+                        // Whole run token is in this chunk
+                        if (output_run(rle_reader, chunk[i++], count) == 0) {
+                            return -1;
+                        }
+                    } else {
+                        rle_reader->token_remaining = count;
+                        rle_reader->state = read_run_byte;
+                    }
+                } else {
+                    rle_reader->token_remaining = counter;
+                    rle_reader->state = read_literal;
+                }
+                break;
+            }
+            case read_run_byte:
+                if (output_run(rle_reader, chunk[i++], rle_reader->token_remaining) == 0) {
+                    return -1;
+                }
+                rle_reader->token_remaining = 0;
+                rle_reader->state = read_counter;
+                break;
+            case read_literal: {
+                size_t n = chunk_size - i;
+                if (n > rle_reader->token_remaining) {
+                    n = rle_reader->token_remaining;
+                }
+                if (output_literals(rle_reader, &chunk[i], n) == 0) {
+                    return -1;
+                }
+                i += n;
+                rle_reader->token_remaining -= n;
+                if (rle_reader->token_remaining == 0) {
+                    rle_reader->state = read_counter;
+                }
+                break;
+            }
+        }
+    }
+    return i;
+}
+
+// read_basic_chunk() and read_advance_chunk()
+#define DEFINE_READ_KERNEL(mode)                                                                               \
+    static ssize_t read_##mode##_chunk(RLEReader* rle_reader, const unsigned char* chunk, size_t chunk_size) { \
+        return read_mode_chunk(rle_reader, chunk, chunk_size, mode);                                           \
+    }
+DEFINE_READ_KERNEL(basic)
+DEFINE_READ_KERNEL(advance)
+
+/*
+* Function: read_rle_chunk
+* ------------------------
+*  Decodes a compressed chunk straight into the RLEReader buffer, expanding
+*  runs with memset and uncompressed sequences with memcpy, in the instance
+*  of the loop for the mode of the reader. A token that is cut off at the
+*  end of the chunk is kept in the RLEReader state and finished by the next
+*  call, so chunks can have any size.
+*
+*  rle_reader: Pointer to the initiated RLEReader.
+*  chunk: Pointer to the compressed chunk.
+*  chunk_size: Number of bytes in the chunk.
+*
+*  returns: Consumed compressed bytes count. If failed (-1).
+*/
+ssize_t read_rle_chunk(RLEReader* rle_reader, const unsigned char* chunk, size_t chunk_size) {
+    if (rle_reader == NULL || (chunk == NULL && chunk_size > 0)) {
+        fprintf(stderr, "\n[ERROR]: read_rle_chunk() {} -> Required parameters are NULL!\n");
+        return -1;
+    }
+    return rle_reader->compression_mode == basic ? read_basic_chunk(rle_reader, chunk, chunk_size)
+                                                 : read_advance_chunk(rle_reader, chunk, chunk_size);
+}
+
+/*
+* Function: next_mode_token
+* -------------------------
+*  Body of next_token() for one compression mode (a constant in every
+*  instance).
+*/
+KERNEL_INLINE ssize_t next_mode_token(const unsigned char* chunk, size_t chunk_size, CompressionMode compression_mode,
+                                      size_t* decoded_size) {
+    if (chunk_size == 0) {
+        return 0;
+    }
+
+    unsigned char counter = chunk[0];
+    size_t token_size;
+    if (counter == 0) {
+        return -1;
+    }
+    if (compression_mode == basic || counter >= ADVANCE_COMPRESSION_LIMIT) {
+        *decoded_size = compression_mode == basic ? counter : (size_t) counter - 126;
+        token_size = 2;
+    } else {
+        *decoded_size = counter;
+        token_size = 1 + (size_t) counter;
+    }
+    return token_size <= chunk_size ? (ssize_t) token_size : 0;
+}
+
+/*
+* Function: next_token
+* --------------------
+*  Measures the token at the beginning of a compressed token stream from its
+*  counter byte, without decoding it.
+*
+*  chunk: Pointer to the compressed token stream (without the mode byte).
+*  chunk_size: Number of bytes in the stream.
 *  compression_mode: Compression algorithm ('basic' or 'advance').
+*  decoded_size: Pointer to the decoded size of the token (output).
 *
-*  returns: If failed (0), on success (1)
+*  returns: Compressed bytes count of the token. If the token is incomplete (0). If corrupted (-1).
 */
-int init_writer(RLEWriter* rle_writer, FILE* file, size_t writer_buffer_size, CompressionMode compression_mode) {
-    if (file == NULL || rle_writer == NULL || writer_buffer_size == 0) {
-        fprintf(stderr, "[ERROR]: init_writer() {} -> Required parameters are NULL!\n");
-        return 0;
-    }
+ssize_t next_token(const unsigned char* chunk, size_t chunk_size, CompressionMode compression_mode,
+                   size_t* decoded_size) {
+    return compression_mode == basic ? next_mode_token(chunk, chunk_size, basic, decoded_size)
+                                     : next_mode_token(chunk, chunk_size, advance, decoded_size);
+}
 
-    rle_writer->file = file;
-    rle_writer->compression_mode = compression_mode;
-    rle_writer->count_limit = compression_mode == basic ? BASIC_COMPRESSION_LIMIT : ADVANCE_COMPRESSION_LIMIT;
-    rle_writer->counter_pos = -1;
-    rle_writer->buffer_size = writer_buffer_size * sizeof(unsigned char);
-    rle_writer->buffer = malloc(rle_writer->buffer_size);
-    if (rle_writer->buffer == NULL) {
-        fprintf(stderr, "[ERROR]: init_writer() {} -> Unable to allocate memory for the buffer!\n");
-        return 0;
+/*
+* Function: skip_mode_tokens
+* --------------------------
+*  Body of skip_tokens() for one compression mode (a constant in every
+*  instance).
+*/
+KERNEL_INLINE ssize_t skip_mode_tokens(const unsigned char* chunk, size_t chunk_size, size_t min_size,
+                                       CompressionMode compression_mode, size_t* decoded_size) {
+    size_t decoded = 0;
+    size_t i = 0;
+
+    while (i < chunk_size && i < min_size) {
+        size_t token_decoded = 0;
+        ssize_t token_size = next_mode_token(&chunk[i], chunk_size - i, compression_mode, &token_decoded);
+        if (token_size <= 0) {
+            return -1;
+        }
+        decoded += token_decoded;
+        i += token_size;
     }
-    rle_writer->buffer_pos = 0;
-    rle_writer->flag_byte = 0;
-    rle_writer->flag_byte_count = 0;
-    return 1;
+    *decoded_size = decoded;
+    return i;
 }
 
 /*
-* Function: init_reader
+* Function: skip_tokens
 * ---------------------
-*  Initiates the RLEReader object.
+*  Walks whole tokens of a compressed token stream, reading only the counter
+*  bytes, until at least min_size compressed bytes are covered or the
+*  stream ends. Used to split a stream at token boundaries.
 *
-*  rle_reader: Pointer to the RLEReader to initiate.
-*  file: Pointer to the output file.
-*  reader_buffer_size: RLEReader buffer (output buffer) size 
+*  chunk: Pointer to the compressed token stream (without the mode byte).
+*  chunk_size: Number of bytes in the stream.
+*  min_size: Compressed bytes to cover before stopping.
 *  compression_mode: Compression algorithm ('basic' or 'advance').
+*  decoded_size: Pointer to the decoded size of the walked tokens (output).
 *
-*  returns: If failed (0), on success (1)
+*  returns: Compressed bytes count of the walked tokens. If the stream is corrupted or truncated (-1).
 */
-int init_reader(RLEReader* rle_reader, FILE* file, size_t reader_buffer_size, CompressionMode compression_mode) {
-    if (file == NULL || rle_reader == NULL) {
-        fprintf(stderr, "[ERROR]: init_reader() {} -> Required parameters are NULL!\n");
-        return 0;
+ssize_t skip_tokens(const unsigned char* chunk, size_t chunk_size, size_t min_size, CompressionMode compression_mode,
+                    size_t* decoded_size) {
+    return compression_mode == basic ? skip_mode_tokens(chunk, chunk_size, min_size, basic, decoded_size)
+                                     : skip_mode_tokens(chunk, chunk_size, min_size, advance, decoded_size);
+}
+
+/*
+* Function: get_decoded_size
+* --------------------------
+*  Computes the decoded size of a compressed token stream from its counter
+*  bytes only, without decoding it.
+*
+*  chunk: Pointer to the compressed token stream (without the mode byte).
+*  chunk_size: Number of bytes in the stream.
+*  compression_mode: Compression algorithm ('basic' or 'advance').
+*
+*  returns: Decoded bytes count. If the stream is corrupted (-1).
+*/
+ssize_t get_decoded_size(const unsigned char* chunk, size_t chunk_size, CompressionMode compression_mode) {
+    size_t decoded_size = 0;
+    if (skip_tokens(chunk, chunk_size, chunk_size, compression_mode, &decoded_size) < 0) {
+        return -1;
     }
+    return decoded_size;
+}
 
-    rle_reader->file = file;
-    rle_reader->compression_mode = compression_mode;
-    rle_reader->buffer_size = reader_buffer_size * sizeof(unsigned char);
-    rle_reader->buffer = malloc(rle_reader->buffer_size);
-    if (rle_reader->buffer == NULL) {
-        fprintf(stderr, "[ERROR]: init_reader() {} -> Unable to allocate memory for the buffer!\n");
-        return 0;
+/*
+* Function: get_varint_size
+* -------------------------
+*  Returns the number of bytes put_varint() writes for value.
+*/
+static size_t get_varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
     }
-    rle_reader->buffer_pos = 0;
-    return 1;
+    return size;
 }
 
 /*
-* Function: write_rle
-* -------------------
-*  Encodes and write RLE for the given character.
+* Function: put_varint
+* --------------------
+*  Writes value as a LEB128 varint (7 bits per byte, lowest first, the high
+*  bit set on every byte but the last).
 *
-*  rle_writer: Pointer to the initiated RLEWriter.
-*  chr: Pointer to the character from file.
-*
-*  returns: If failed (0), on success (1).
+*  returns: Written bytes count.
 */
-int write_rle(RLEWriter* rle_writer, unsigned char* chr) {
-    if (rle_writer == NULL || chr == NULL) {
-        fprintf(stderr, "\n[ERROR]: write_rle() {} -> Required parameters are NULL!\n");
-        return 0;
+static size_t put_varint(unsigned char* output, uint64_t value) {
+    size_t size = 0;
+    while (value >= 0x80) {
+        output[size++] = (unsigned char) (value | 0x80);
+        value >>= 7;
     }
+    output[size++] = (unsigned char) value;
+    return size;
+}
 
-    size_t counter_padding = rle_writer->compression_mode ? 126 : 0;
-
-    if (rle_writer->flag_byte_count == 0) {
-        rle_writer->flag_byte = *chr;
+/*
+* Function: get_varint
+* --------------------
+*  Reads a LEB128 varint.
+*
+*  returns: Read bytes count. If cut off or longer than VARINT_MAX_SIZE (-1).
+*/
+static ssize_t get_varint(const unsigned char* input, size_t input_size, uint64_t* value) {
+    *value = 0;
+    for (size_t i = 0; i < input_size && i < VARINT_MAX_SIZE; i++) {
+        *value |= (uint64_t) (input[i] & 0x7F) << (7 * i);
+        if ((input[i] & 0x80) == 0) {
+            return i + 1;
+        }
     }
+    return -1;
+}
 
-    if (rle_writer->flag_byte == *chr && rle_writer->flag_byte_count < rle_writer->count_limit) {
-        rle_writer->flag_byte_count++;
-        rle_writer->counter_pos = -1;
-    } else {
-        if (rle_writer->flag_byte_count > 1 || rle_writer->compression_mode == basic) {
-            rle_writer->buffer[rle_writer->buffer_pos++] = rle_writer->flag_byte_count + counter_padding;
-            rle_writer->buffer[rle_writer->buffer_pos++] = rle_writer->flag_byte;
-        } else {
-            if (rle_writer->counter_pos > -1) {
-                // Increase the counter for uncompressed sequence
-                rle_writer->buffer[rle_writer->counter_pos]++;
-                // Reset counter position for uncompressed sequence, if the counter is about to pass the limit
-                if (rle_writer->buffer[rle_writer->counter_pos] + 1 >= rle_writer->count_limit) {
-                    rle_writer->counter_pos = -1;
+/*
+* Function: write_width_tokens
+* ----------------------------
+*  Encodes count elements of width bytes into varint tokens: every run of 2
+*  or more equal elements is a single token (varint((run - 2) << 1), element)
+*  and every stretch of elements that differ from the next one is a single
+*  uncompressed sequence (varint((count - 1) << 1 | 1), elements). Runs and
+*  repeats are found with the SIMD kernels. width is a constant in every
+*  instance (see DEFINE_ELEMENT_KERNELS), so the element copies are single
+*  moves.
+*
+*  output: Pointer to the output buffer (NULL to only count the encoded size).
+*
+*  returns: Encoded bytes count. If the output buffer is full (-1).
+*/
+KERNEL_INLINE ssize_t write_width_tokens(const unsigned char* input, size_t count, size_t width, unsigned char* output,
+                                         size_t output_capacity, RLEStats* stats) {
+    size_t pos = 0;
+    size_t k = 0;
+    while (k < count) {
+        const unsigned char* element = &input[k * width];
+        size_t singles = width == 1 ? find_repeat(element, count - k) : find_element_repeat(element, count - k, width);
+        if (singles > 0) {
+            uint64_t header = (uint64_t) (singles - 1) << 1 | 1;
+            size_t literal_size = singles * width;
+            if (output != NULL) {
+                if (get_varint_size(header) + literal_size > output_capacity - pos) {
+                    return -1;
                 }
-                rle_writer->buffer[rle_writer->buffer_pos++] = rle_writer->flag_byte;
+                pos += put_varint(&output[pos], header);
+                memcpy(&output[pos], element, literal_size);
             } else {
-                rle_writer->counter_pos = rle_writer->buffer_pos;
-                rle_writer->buffer[rle_writer->buffer_pos++] = 1;
-                rle_writer->buffer[rle_writer->buffer_pos++] = rle_writer->flag_byte;
+                pos += get_varint_size(header);
             }
+            pos += literal_size;
+            k += singles;
+            if (stats != NULL) {
+                stats->literal_tokens++;
+            }
+            if (k == count) {
+                break;
+            }
+            element = &input[k * width];
         }
 
-        if (rle_writer->buffer_pos >= rle_writer->buffer_size) {
-            size_t result = fwrite(rle_writer->buffer, sizeof(unsigned char), rle_writer->buffer_pos, rle_writer->file);
-            if (result < rle_writer->buffer_pos) {
-                fprintf(stderr, "\n[ERROR]: write_rle() {} -> Unable to flush the buffer!\n");
-                return 0;
+        size_t run = width == 1 ? find_run_length(element, count - k, element[0])
+                                : 1 + find_mismatch(&element[width], element, (count - k - 1) * width) / width;
+        uint64_t header = (uint64_t) (run - 2) << 1;
+        if (output != NULL) {
+            if (get_varint_size(header) + width > output_capacity - pos) {
+                return -1;
             }
-            rle_writer->buffer_pos = 0;
-            rle_writer->counter_pos = -1;
+            pos += put_varint(&output[pos], header);
+            memcpy(&output[pos], element, width);
+        } else {
+            pos += get_varint_size(header);
+        }
+        pos += width;
+        k += run;
+        if (stats != NULL) {
+            count_run_token(stats, run);
         }
-        rle_writer->flag_byte = *chr;
-        rle_writer->flag_byte_count = 1;
     }
-    return 1;
+    return pos;
 }
 
 /*
-* Function: read_rle
-* -------------------
-*  Decodes and write uncompressed data for the given compressed stream.
+* Function: read_width_tokens
+* ---------------------------
+*  Decodes the varint tokens of elements of width bytes until the output is
+*  full or the input ends. Byte runs are expanded with a single memset,
+*  element runs by doubling memcpy copies of the element (wide stores), and
+*  uncompressed sequences with a single memcpy. width is a constant in
+*  every instance (see DEFINE_ELEMENT_KERNELS).
 *
-*  rle_reader: Pointer to the initiated RLEReader.
-*  counter_byter: Pointer to the counter byte in compressed stream.
+*  consumed: Set to the input bytes consumed.
 *
-*  returns: Decoded bytes count.
+*  returns: Decoded bytes count. If the tokens are corrupted or do not fit (-1).
 */
-size_t read_rle(RLEReader* rle_reader, unsigned char* counter_byte) {
-    int count = *counter_byte;
-    if (rle_reader->compression_mode == advance && *counter_byte >= ADVANCE_COMPRESSION_LIMIT) {
-        count -= 126;
+KERNEL_INLINE ssize_t read_width_tokens(const unsigned char* input, size_t input_size, size_t width,
+                                        unsigned char* output, size_t output_size, size_t* consumed) {
+    size_t pos = 0;
+    size_t produced = 0;
+    while (pos < input_size && produced < output_size) {
+        uint64_t header = 0;
+        ssize_t header_size = get_varint(&input[pos], input_size - pos, &header);
+        if (header_size < 0) {
+            fprintf(stderr, "\n[ERROR]: read_width_tokens() {} -> Invalid token!\n");
+            return -1;
+        }
+        pos += header_size;
+
+        uint64_t count = (header >> 1) + (header & 1 ? 1 : 2);
+        uint64_t token_input = header & 1 ? count * width : width;
+        if (count > (output_size - produced) / width || token_input > input_size - pos) {
+            fprintf(stderr, "\n[ERROR]: read_width_tokens() {} -> Invalid token!\n");
+            return -1;
+        }
+        size_t length = count * width;
+        unsigned char* out = &output[produced];
+        if (header & 1) {
+            memcpy(out, &input[pos], length);
+        } else if (width == 1) {
+            memset(out, input[pos], length);
+        } else {
+            memcpy(out, &input[pos], width);
+            for (size_t filled = width; filled < length;) {
+                size_t n = filled < length - filled ? filled : length - filled;
+                memcpy(&out[filled], out, n);
+                filled += n;
+            }
+        }
+        pos += token_input;
+        produced += length;
     }
-    if (count <= 0) {
-        fprintf(stderr, "\n[ERROR]: read_rle() {} -> Invalid value (count = %d)\n", count);
-        return 0;
+    *consumed = pos;
+    return produced;
+}
+
+// write_width1_tokens() to write_width4_tokens() and read_width1_tokens() to read_width4_tokens():
+// bytes (varint mode) and the common pixel sizes of pattern mode
+#define DEFINE_ELEMENT_KERNELS(width)                                                                               \
+    static ssize_t write_width##width##_tokens(const unsigned char* input, size_t count, unsigned char* output,     \
+                                               size_t output_capacity, RLEStats* stats) {                           \
+        return write_width_tokens(input, count, width, output, output_capacity, stats);                             \
+    }                                                                                                               \
+    static ssize_t read_width##width##_tokens(const unsigned char* input, size_t input_size, unsigned char* output, \
+                                              size_t output_size, size_t* consumed) {                               \
+        return read_width_tokens(input, input_size, width, output, output_size, consumed);                          \
+    }
+DEFINE_ELEMENT_KERNELS(1)
+DEFINE_ELEMENT_KERNELS(2)
+DEFINE_ELEMENT_KERNELS(3)
+DEFINE_ELEMENT_KERNELS(4)
+
+/*
+* Function: write_element_tokens
+* ------------------------------
+*  Same as write_width_tokens(), in the instance for width (a generic one
+*  for the widths without an instance).
+*/
+static ssize_t write_element_tokens(const unsigned char* input, size_t count, size_t width, unsigned char* output,
+                                    size_t output_capacity, RLEStats* stats) {
+    switch (width) {
+        case 1:
+            return write_width1_tokens(input, count, output, output_capacity, stats);
+        case 2:
+            return write_width2_tokens(input, count, output, output_capacity, stats);
+        case 3:
+            return write_width3_tokens(input, count, output, output_capacity, stats);
+        case 4:
+            return write_width4_tokens(input, count, output, output_capacity, stats);
+        default:
+            return write_width_tokens(input, count, width, output, output_capacity, stats);
     }
+}
 
-    if (rle_reader->buffer_pos + count >= rle_reader->buffer_size) {
-        flush_reader(rle_reader);
+/*
+* Function: read_element_tokens
+* -----------------------------
+*  Same as read_width_tokens(), in the instance for width (a generic one
+*  for the widths without an instance).
+*/
+static ssize_t read_element_tokens(const unsigned char* input, size_t input_size, size_t width, unsigned char* output,
+                                   size_t output_size, size_t* consumed) {
+    switch (width) {
+        case 1:
+            return read_width1_tokens(input, input_size, output, output_size, consumed);
+        case 2:
+            return read_width2_tokens(input, input_size, output, output_size, consumed);
+        case 3:
+            return read_width3_tokens(input, input_size, output, output_size, consumed);
+        case 4:
+            return read_width4_tokens(input, input_size, output, output_size, consumed);
+        default:
+            return read_width_tokens(input, input_size, width, output, output_size, consumed);
     }
+}
 
-    size_t read_bytes = 0;
-    
-    if (rle_reader->compression_mode == basic || *counter_byte >= ADVANCE_COMPRESSION_LIMIT) {
-        for (int i = 0; i < count; i++) {
-            rle_reader->buffer[rle_reader->buffer_pos++] = *(counter_byte + 1);
+/*
+* Function: write_varint_tokens
+* -----------------------------
+*  Encodes a whole buffer into varint tokens. Every run of 2 or more bytes
+*  is a single token (varint((length - 2) << 1), byte) and every stretch of
+*  single bytes is a single uncompressed sequence (varint((length - 1) << 1 | 1),
+*  bytes), so runs and sequences are never split at a counter limit.
+*
+*  input: Pointer to the raw data.
+*  input_size: Number of bytes.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*  stats: Pointer to the RLEStats that counts the tokens (optional, NULL to disable).
+*
+*  returns: Encoded bytes count. If the output buffer is full (-1).
+*/
+ssize_t write_varint_tokens(const unsigned char* input, size_t input_size, unsigned char* output,
+                            size_t output_capacity, RLEStats* stats) {
+    return write_element_tokens(input, input_size, 1, output, output_capacity, stats);
+}
+
+/*
+* Function: read_varint_tokens
+* ----------------------------
+*  Decodes a whole buffer of varint tokens, expanding every run with a
+*  single memset and every uncompressed sequence with a single memcpy.
+*
+*  input: Pointer to the varint tokens.
+*  input_size: Number of bytes.
+*  output: Pointer to the output buffer.
+*  output_size: Output buffer size.
+*
+*  returns: Decoded bytes count. If the tokens are corrupted or do not fit (-1).
+*/
+ssize_t read_varint_tokens(const unsigned char* input, size_t input_size, unsigned char* output,
+                           size_t output_size) {
+    size_t consumed = 0;
+    ssize_t produced = read_element_tokens(input, input_size, 1, output, output_size, &consumed);
+    if (produced >= 0 && consumed < input_size) {
+        fprintf(stderr, "\n[ERROR]: read_varint_tokens() {} -> Tokens do not fit in the output!\n");
+        return -1;
+    }
+    return produced;
+}
+
+/*
+* Function: write_pattern_tokens
+* ------------------------------
+*  Encodes a whole buffer of multi-byte elements (e.g. 16/24/32-bit pixels):
+*  the element width, then varint tokens over whole elements (see
+*  write_varint_tokens(), lengths count elements), then the bytes after the
+*  last whole element.
+*
+*  input: Pointer to the raw data.
+*  input_size: Number of bytes.
+*  element_width: Element width in bytes (2 to MAX_ELEMENT_WIDTH).
+*  output: Pointer to the output buffer (NULL to only count the encoded size).
+*  output_capacity: Output buffer size.
+*  stats: Pointer to the RLEStats that counts the tokens (optional, NULL to disable).
+*
+*  returns: Encoded bytes count. If the output buffer is full (-1).
+*/
+ssize_t write_pattern_tokens(const unsigned char* input, size_t input_size, size_t element_width,
+                             unsigned char* output, size_t output_capacity, RLEStats* stats) {
+    if (element_width < 2 || element_width > MAX_ELEMENT_WIDTH) {
+        fprintf(stderr, "\n[ERROR]: write_pattern_tokens() {} -> Invalid element width!\n");
+        return -1;
+    }
+    size_t tail = input_size % element_width;
+    if (output != NULL && output_capacity < 1 + tail) {
+        return -1;
+    }
+
+    ssize_t tokens_size = write_element_tokens(input, input_size / element_width, element_width,
+                                               output != NULL ? &output[1] : NULL, output_capacity - 1 - tail, stats);
+    if (tokens_size < 0) {
+        return -1;
+    }
+    if (output != NULL) {
+        output[0] = (unsigned char) element_width;
+        memcpy(&output[1 + tokens_size], &input[input_size - tail], tail);
+    }
+    return 1 + tokens_size + tail;
+}
+
+/*
+* Function: read_pattern_tokens
+* -----------------------------
+*  Decodes a whole buffer written by write_pattern_tokens().
+*
+*  input: Pointer to the encoded data.
+*  input_size: Number of bytes.
+*  output: Pointer to the output buffer.
+*  output_size: Output buffer size (the decoded size).
+*
+*  returns: Decoded bytes count. If the data is corrupted (-1).
+*/
+ssize_t read_pattern_tokens(const unsigned char* input, size_t input_size, unsigned char* output,
+                            size_t output_size) {
+    size_t element_width = input_size > 0 ? input[0] : 0;
+    if (element_width < 2 || element_width > MAX_ELEMENT_WIDTH) {
+        fprintf(stderr, "\n[ERROR]: read_pattern_tokens() {} -> Invalid element width!\n");
+        return -1;
+    }
+
+    size_t tail = output_size % element_width;
+    size_t consumed = 0;
+    ssize_t produced = read_element_tokens(&input[1], input_size - 1, element_width, output, output_size - tail,
+                                           &consumed);
+    if (produced < 0 || 1 + consumed + tail != input_size) {
+        fprintf(stderr, "\n[ERROR]: read_pattern_tokens() {} -> Block is corrupted!\n");
+        return -1;
+    }
+    memcpy(&output[produced], &input[1 + consumed], tail);
+    return produced + tail;
+}
+
+/*
+* Function: choose_compression_mode
+* ---------------------------------
+*  Picks the compression mode that encodes data smallest. The encoded sizes
+*  of the byte modes are computed in a single pass over the runs (found with
+*  the SIMD kernels), following the token rules of the writers, without
+*  encoding; 'pattern' takes a second pass over the elements.
+*
+*  data: Pointer to the raw data.
+*  size: Number of bytes.
+*  element_width: Element width for 'pattern' (0 to leave 'pattern' out).
+*
+*  returns: 'basic', 'advance', 'varint' or 'pattern' (the first one on a tie).
+*/
+CompressionMode choose_compression_mode(const unsigned char* data, size_t size, size_t element_width) {
+    size_t basic_size = 0;
+    size_t advance_size = 0;
+    size_t varint_size = 0;
+    size_t literal_count = 0;  // Length of the open uncompressed sequence in advance mode
+    size_t literal_limit = ADVANCE_COMPRESSION_LIMIT - 1;
+
+    size_t i = 0;
+    while (i < size) {
+        // Single bytes (each differs from the next one) go to uncompressed sequences in advance mode
+        size_t singles = find_repeat(&data[i], size - i);
+        if (singles > 0) {
+            basic_size += 2 * singles;
+            varint_size += get_varint_size((uint64_t) (singles - 1) << 1 | 1) + singles;
+            size_t rest = singles;
+            if (literal_count > 0) {
+                size_t n = literal_limit - literal_count < rest ? literal_limit - literal_count : rest;
+                advance_size += n;
+                literal_count = literal_count + n >= literal_limit ? 0 : literal_count + n;
+                rest -= n;
+            }
+            if (rest > 0) {
+                advance_size += rest + (rest + literal_limit - 1) / literal_limit;
+                literal_count = rest % literal_limit;
+            }
+            i += singles;
+            if (i == size) {
+                break;
+            }
         }
-        read_bytes++;
-    } else {
-        for (int i = 1; i <= count; i++) {
-            rle_reader->buffer[rle_reader->buffer_pos++] = *(counter_byte + i);
-            read_bytes++;
+
+        // Run of 2 or more bytes
+        size_t run = find_run_length(&data[i], size - i, data[i]);
+        i += run;
+        basic_size += 2 * ((run + BASIC_COMPRESSION_LIMIT - 1) / BASIC_COMPRESSION_LIMIT);
+        varint_size += get_varint_size((uint64_t) (run - 2) << 1) + 1;
+        advance_size += 2 * (run / ADVANCE_COMPRESSION_LIMIT);
+        literal_count = 0;
+        if (run % ADVANCE_COMPRESSION_LIMIT > 1) {
+            advance_size += 2;
+        } else if (run % ADVANCE_COMPRESSION_LIMIT == 1) {
+            // A byte left over past the counter limit starts a new uncompressed sequence
+            advance_size += 2;
+            literal_count = 1;
         }
+    }
 
+    CompressionMode compression_mode = advance_size < basic_size ? advance : basic;
+    size_t best_size = advance_size < basic_size ? advance_size : basic_size;
+    if (varint_size < best_size) {
+        compression_mode = varint;
+        best_size = varint_size;
+    }
+    if (element_width >= 2 && element_width <= MAX_ELEMENT_WIDTH) {
+        // Element runs need their own pass
+        ssize_t pattern_size = write_pattern_tokens(data, size, element_width, NULL, 0, NULL);
+        if (pattern_size >= 0 && (size_t) pattern_size < best_size) {
+            compression_mode = pattern;
+        }
     }
-    return read_bytes;
+    return compression_mode;
 }
 
 /*
 * Function: flush_writer
 * ----------------------
-*  Flushes the remaining data in buffer to the output file.
+*  Flushes the remaining data in buffer to the output file. Memory writers
+*  only write out the pending run.
 *
 *  rle_writer: Pointer to the initiated RLEWriter
 *
@@ -193,10 +1292,17 @@ int flush_writer(RLEWriter* rle_writer) {
         processed = rle_writer->flag_byte_count;
         // Use a non-equal char in write_rle, so it ends the counter for the flag byte
         unsigned char _chr = rle_writer->flag_byte + 1;
-        write_rle(rle_writer, &_chr);
+        if (write_rle(rle_writer, &_chr) == 0) {
+            return -1;
+        }
     }
-    if (rle_writer->buffer_pos > 0) {
+    if (rle_writer->buffer_pos > 0 && rle_writer->file != NULL) {
+        double start_time = rle_writer->stats != NULL ? get_wall_time() : 0;
         size_t result = fwrite(rle_writer->buffer, sizeof(unsigned char), rle_writer->buffer_pos, rle_writer->file);
+        if (rle_writer->stats != NULL) {
+            rle_writer->stats->output_writes++;
+            rle_writer->stats->write_time += get_wall_time() - start_time;
+        }
         if (result < rle_writer->buffer_pos) {
             fprintf(stderr, "\n[ERROR]: flush_writer() {} -> Unable to flush the buffer!\n");
             return -1;
@@ -224,11 +1330,11 @@ int flush_reader(RLEReader* rle_reader) {
 
     size_t flushed_bytes = 0;
     
-    if (rle_reader->buffer_pos > 0) {
+    if (rle_reader->buffer_pos > 0 && rle_reader->file != NULL) {
         size_t result = fwrite(rle_reader->buffer, sizeof(unsigned char), rle_reader->buffer_pos, rle_reader->file);
         if (result < rle_reader->buffer_pos) {
             fprintf(stderr, "\n[ERROR]: flush_reader() {} -> Unable to flush the buffer!\n");
-            return 0;
+            return -1;
         }
         flushed_bytes = rle_reader->buffer_pos;
         rle_reader->buffer_pos = 0;
@@ -237,128 +1343,181 @@ int flush_reader(RLEReader* rle_reader) {
 }
 
 /*
-* Function: encode
-* ----------------
-*  Encodes file using RLE technique.
+* Function: encode_with_buffer
+* ----------------------------
+*  Same as encode(), but the input is read into a caller owned buffer, so
+*  nothing is allocated.
 *
 *  input_file: Pointer to the input file.
 *  rle_writer: Pointer to the initiated RLEWriter.
+*  read_buffer: Pointer to the input buffer (chunk_size bytes).
 *  chunk_size: Input buffer size
 *
 *  returns: Encoded bytes count. If failed (-1).
 */
-ssize_t encode(FILE* input_file, RLEWriter* rle_writer, size_t chunk_size) {
-    if (input_file == NULL) {
-        fprintf(stderr, "[ERROR]: encode() {} -> File pointer is NULL!\n");
+ssize_t encode_with_buffer(FILE* input_file, RLEWriter* rle_writer, unsigned char* read_buffer, size_t chunk_size) {
+    if (input_file == NULL || rle_writer == NULL || rle_writer->file == NULL) {
+        fprintf(stderr, "[ERROR]: encode_with_buffer() {} -> File pointer is NULL!\n");
         return -1;
     }
-
-    unsigned char* read_buffer = malloc(chunk_size * sizeof(unsigned char));
-    if (read_buffer == NULL) {
-        fprintf(stderr, "\n[ERROR]: encode() {} -> Unable to allocate memory for buffer!\n");
+    if (read_buffer == NULL || chunk_size == 0) {
+        fprintf(stderr, "\n[ERROR]: encode_with_buffer() {} -> Input buffer is NULL!\n");
         return -1;
     }
 
     size_t read_bytes = 0;
-    size_t file_size = get_file_size(input_file);
     size_t processed = 0;
-    fseek(input_file, 0, SEEK_SET);
-    clock_t start_time = clock();
+    double start_time = get_wall_time();
 
     unsigned char compression_mode_flag_byte = (unsigned char) rle_writer->compression_mode;
     if (fwrite(&compression_mode_flag_byte, sizeof(unsigned char), 1, rle_writer->file) < 1) {
-        fprintf(stderr, "\n[ERROR]: encode() {} -> Unable to write the compression mode to the file!\n");
-        free(read_buffer);
+        fprintf(stderr, "\n[ERROR]: encode_with_buffer() {} -> Unable to write the compression mode to the file!\n");
         return -1;
     }
 
     while ((read_bytes = fread(read_buffer, sizeof(unsigned char), chunk_size, input_file)) != 0) {
-        for (size_t i = 0; i < read_bytes; i++) {
-            int result = write_rle(rle_writer, &read_buffer[i]);
-            if (result == 0) {
-                free(read_buffer);
-                return -1;
-            }
+        if (write_rle_chunk(rle_writer, read_buffer, read_bytes) == 0) {
+            return -1;
         }
         processed += read_bytes;
         if (processed % (100 * KB) == 0) {
-            printf("\rProcessing: %zu/%zu bytes...", processed, file_size);
+            printf("\rProcessing: %zu bytes...", processed);
         }
     }
 
-    if (rle_writer->buffer_pos > 0) {
+    if (rle_writer->buffer_pos > 0 || rle_writer->flag_byte_count > 0) {
         int result = flush_writer(rle_writer);
         if (result < 0) {
-            free(read_buffer);
             return -1;
         }
     }
 
-    clock_t end_time = clock();
+    double end_time = get_wall_time();
 
+    // The output size is only known on seekable outputs
     long compressed_file_size = ftell(rle_writer->file);
-    int size_diff = file_size - compressed_file_size;
-    double compression_rate = (double) abs(size_diff) / file_size * 100;
-    double time_spent = (double)(end_time - start_time) / CLOCKS_PER_SEC;
-    printf("\rFinished processing (%f s): %zu bytes -> %ld bytes (%s%.2f%%)\n", time_spent, file_size, 
-           compressed_file_size, size_diff > 0 ? "-" : "+", compression_rate);
-
-    free(read_buffer);
+    double time_spent = end_time - start_time;
+    if (compressed_file_size >= 0) {
+        double compression_rate = processed > 0 ? ((double) compressed_file_size - processed) / processed * 100 : 0;
+        printf("\rFinished processing (%f s): %zu bytes -> %ld bytes (%+.2f%%)\n", time_spent, processed,
+               compressed_file_size, compression_rate);
+    } else {
+        printf("\rFinished processing (%f s): %zu bytes\n", time_spent, processed);
+    }
     return processed;
 }
 
 /*
-* Function: decode
+* Function: encode
 * ----------------
-*  Decodes file using RLE technique.
+*  Encodes file using RLE technique. The input is read from its current
+*  position to its end without seeking, so pipes and sockets work too.
 *
 *  input_file: Pointer to the input file.
-*  rle_reader: Pointer to the initiated RLEReader.
+*  rle_writer: Pointer to the initiated RLEWriter.
 *  chunk_size: Input buffer size
 *
-*  returns: Decoded bytes count. If failed (-1).
+*  returns: Encoded bytes count. If failed (-1).
 */
-ssize_t decode(FILE* input_file, RLEReader* rle_reader, size_t chunk_size) {
+ssize_t encode(FILE* input_file, RLEWriter* rle_writer, size_t chunk_size) {
     if (input_file == NULL) {
-        fprintf(stderr, "[ERROR]: decode() {} -> File pointer is NULL!\n");
+        fprintf(stderr, "[ERROR]: encode() {} -> File pointer is NULL!\n");
         return -1;
     }
 
     unsigned char* read_buffer = malloc(chunk_size * sizeof(unsigned char));
     if (read_buffer == NULL) {
-        fprintf(stderr, "\n[ERROR]: decode() {} -> Unable to allocate memory for buffer!\n");
+        fprintf(stderr, "\n[ERROR]: encode() {} -> Unable to allocate memory for buffer!\n");
+        return -1;
+    }
+    ssize_t processed = encode_with_buffer(input_file, rle_writer, read_buffer, chunk_size);
+    free(read_buffer);
+    return processed;
+}
+
+/*
+* Function: decode_with_buffer
+* ----------------------------
+*  Same as decode(), but the input is read into a caller owned buffer, so
+*  nothing is allocated.
+*
+*  input_file: Pointer to the input file (after the compression mode byte).
+*  rle_reader: Pointer to the initiated RLEReader.
+*  read_buffer: Pointer to the input buffer (chunk_size bytes).
+*  chunk_size: Input buffer size
+*
+*  returns: Compressed bytes count. If failed (-1).
+*/
+ssize_t decode_with_buffer(FILE* input_file, RLEReader* rle_reader, unsigned char* read_buffer, size_t chunk_size) {
+    if (input_file == NULL || rle_reader == NULL) {
+        fprintf(stderr, "[ERROR]: decode_with_buffer() {} -> File pointer is NULL!\n");
+        return -1;
+    }
+    if (read_buffer == NULL || chunk_size == 0) {
+        fprintf(stderr, "\n[ERROR]: decode_with_buffer() {} -> Input buffer is NULL!\n");
         return -1;
     }
 
     size_t read_bytes = 0;
-    size_t file_size = get_file_size(input_file);
     size_t processed = 0;
-    clock_t start_time = clock();
-    // Skip the first byte (compression mode byte)
-    fseek(input_file, sizeof(unsigned char), SEEK_SET);
+    double start_time = get_wall_time();
 
     while ((read_bytes = fread(read_buffer, sizeof(unsigned char), chunk_size, input_file)) != 0) {
-        for (size_t i = 0; i < read_bytes; i++) {    
-            size_t processed_bytes = read_rle(rle_reader, &read_buffer[i]);
-            i += processed_bytes;
+        if (read_rle_chunk(rle_reader, read_buffer, read_bytes) < 0) {
+            return -1;
         }
+
         processed += read_bytes;
         if (processed % (100 * KB) == 0) {
-            printf("\rProcessing: %zu/%zu bytes...", processed, file_size);
+            printf("\rProcessing: %zu bytes...", processed);
         }
     }
 
+    if (rle_reader->state != read_counter) {
+        fprintf(stderr, "\n[ERROR]: decode_with_buffer() {} -> File is truncated!\n");
+        return -1;
+    }
+
     int result = flush_reader(rle_reader);
     if (result < 0) {
-        free(read_buffer);
         return -1;
     }
 
-    clock_t end_time = clock();
-    double time_spent = (double)(end_time - start_time) / CLOCKS_PER_SEC;
-    long compressed_file_size = ftell(rle_reader->file);
-    printf("\rFinished Processing (%f s): %zu bytes -> %ld bytes\n", time_spent, file_size, compressed_file_size);
+    double end_time = get_wall_time();
+    double time_spent = end_time - start_time;
+    long decompressed_file_size = ftell(rle_reader->file);
+    if (decompressed_file_size >= 0) {
+        printf("\rFinished Processing (%f s): %zu bytes -> %ld bytes\n", time_spent, processed, decompressed_file_size);
+    } else {
+        printf("\rFinished Processing (%f s): %zu bytes\n", time_spent, processed);
+    }
+    return processed;
+}
+
+/*
+* Function: decode
+* ----------------
+*  Decodes file using RLE technique. The input is read from its current
+*  position to its end without seeking, so pipes and sockets work too.
+*
+*  input_file: Pointer to the input file (after the compression mode byte).
+*  rle_reader: Pointer to the initiated RLEReader.
+*  chunk_size: Input buffer size
+*
+*  returns: Compressed bytes count. If failed (-1).
+*/
+ssize_t decode(FILE* input_file, RLEReader* rle_reader, size_t chunk_size) {
+    if (input_file == NULL) {
+        fprintf(stderr, "[ERROR]: decode() {} -> File pointer is NULL!\n");
+        return -1;
+    }
 
+    unsigned char* read_buffer = malloc(chunk_size * sizeof(unsigned char));
+    if (read_buffer == NULL) {
+        fprintf(stderr, "\n[ERROR]: decode() {} -> Unable to allocate memory for buffer!\n");
+        return -1;
+    }
+    ssize_t processed = decode_with_buffer(input_file, rle_reader, read_buffer, chunk_size);
     free(read_buffer);
     return processed;
 }
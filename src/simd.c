@@ -0,0 +1,938 @@
+#include "../include/simd.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#define ONES_64 0x0101010101010101ULL
+#define HIGHS_64 0x8080808080808080ULL
+
+typedef size_t (*RunLengthKernel)(const unsigned char* data, size_t size, unsigned char value);
+typedef size_t (*FindRepeatKernel)(const unsigned char* data, size_t size);
+typedef size_t (*FindMismatchKernel)(const unsigned char* a, const unsigned char* b, size_t size);
+typedef size_t (*FindElementRepeatKernel)(const unsigned char* data, size_t count, size_t width);
+typedef void (*PlaneKernel)(const unsigned char* input, size_t size, size_t count, unsigned char* output);
+typedef void (*EncodeDeltaKernel)(const unsigned char* input, size_t size, size_t stride, DeltaMode mode,
+                                  unsigned char* output);
+typedef void (*DecodeDeltaKernel)(unsigned char* data, size_t size, size_t stride, DeltaMode mode);
+
+/*
+* Function: run_length_scalar
+* ---------------------------
+*  Portable run length kernel, compares a machine word (8 bytes) at a time.
+*/
+static size_t run_length_scalar(const unsigned char* data, size_t size, unsigned char value) {
+    const uint64_t pattern = ONES_64 * value;
+    size_t i = 0;
+
+    while (i + sizeof(uint64_t) <= size) {
+        uint64_t word;
+        memcpy(&word, &data[i], sizeof(uint64_t));
+        uint64_t diff = word ^ pattern;
+        if (diff != 0) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return i + (__builtin_clzll(diff) >> 3);
+#else
+            return i + (__builtin_ctzll(diff) >> 3);
+#endif
+        }
+        i += sizeof(uint64_t);
+    }
+    while (i < size && data[i] == value) {
+        i++;
+    }
+    return i;
+}
+
+/*
+* Function: find_repeat_scalar
+* ----------------------------
+*  Portable repeat finder. XORs each word with the same word shifted by one
+*  byte and looks for a zero byte in the result.
+*/
+static size_t find_repeat_scalar(const unsigned char* data, size_t size) {
+    size_t i = 0;
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (i + sizeof(uint64_t) + 1 <= size) {
+        uint64_t current, next;
+        memcpy(&current, &data[i], sizeof(uint64_t));
+        memcpy(&next, &data[i + 1], sizeof(uint64_t));
+        uint64_t diff = current ^ next;
+        // The lowest flagged byte is always an exact zero byte of diff
+        uint64_t zeros = (diff - ONES_64) & ~diff & HIGHS_64;
+        if (zeros != 0) {
+            return i + (__builtin_ctzll(zeros) >> 3);
+        }
+        i += sizeof(uint64_t);
+    }
+#endif
+    for (; i + 1 < size; i++) {
+        if (data[i] == data[i + 1]) {
+            return i;
+        }
+    }
+    return size;
+}
+
+/*
+* Function: find_mismatch_scalar
+* ------------------------------
+*  Portable mismatch finder, XORs a machine word (8 bytes) at a time.
+*/
+static size_t find_mismatch_scalar(const unsigned char* a, const unsigned char* b, size_t size) {
+    size_t i = 0;
+
+    while (i + sizeof(uint64_t) <= size) {
+        uint64_t word_a, word_b;
+        memcpy(&word_a, &a[i], sizeof(uint64_t));
+        memcpy(&word_b, &b[i], sizeof(uint64_t));
+        uint64_t diff = word_a ^ word_b;
+        if (diff != 0) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return i + (__builtin_clzll(diff) >> 3);
+#else
+            return i + (__builtin_ctzll(diff) >> 3);
+#endif
+        }
+        i += sizeof(uint64_t);
+    }
+    while (i < size && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+/*
+* Function: elements_equal
+* ------------------------
+*  Compares two elements of width bytes, with a single load for the common
+*  pixel widths.
+*/
+static inline int elements_equal(const unsigned char* a, const unsigned char* b, size_t width) {
+    switch (width) {
+        case 2: {
+            uint16_t x, y;
+            memcpy(&x, a, 2);
+            memcpy(&y, b, 2);
+            return x == y;
+        }
+        case 4: {
+            uint32_t x, y;
+            memcpy(&x, a, 4);
+            memcpy(&y, b, 4);
+            return x == y;
+        }
+        case 8: {
+            uint64_t x, y;
+            memcpy(&x, a, 8);
+            memcpy(&y, b, 8);
+            return x == y;
+        }
+        default:
+            return memcmp(a, b, width) == 0;
+    }
+}
+
+/*
+* Function: find_element_repeat_scalar
+* ------------------------------------
+*  Portable element repeat finder, compares one element at a time.
+*/
+static size_t find_element_repeat_scalar(const unsigned char* data, size_t count, size_t width) {
+    for (size_t k = 0; k + 1 < count; k++) {
+        if (elements_equal(&data[k * width], &data[(k + 1) * width], width)) {
+            return k;
+        }
+    }
+    return count;
+}
+
+/*
+* Function: equal_element_mask
+* ----------------------------
+*  Reduces a mask of equal bytes (bit i set if byte i is equal to the byte
+*  width bytes after it) to the first bit of every element whose width bytes
+*  are all equal. width is 2, 3, 4 or 8; an element cut off by the end of
+*  the mask is never reported, since the shifts bring in zeros.
+*/
+static inline uint64_t equal_element_mask(uint64_t mask, size_t width) {
+    if (width == 3) {
+        return mask & (mask >> 1) & (mask >> 2) & 0x9249249249249249ULL;
+    }
+    for (size_t span = 1; span < width; span <<= 1) {
+        mask &= mask >> span;
+    }
+    switch (width) {
+        case 2:
+            return mask & 0x5555555555555555ULL;
+        case 4:
+            return mask & 0x1111111111111111ULL;
+        default:
+            return mask & ONES_64;
+    }
+}
+
+/*
+* Function: split_planes_from
+* ---------------------------
+*  Portable plane splitter for the elements from start on, and the tail
+*  bytes that do not fill a whole element.
+*/
+static void split_planes_from(const unsigned char* input, size_t size, size_t count, unsigned char* output,
+                              size_t start) {
+    size_t element_count = size / count;
+    for (size_t p = 0; p < count; p++) {
+        unsigned char* plane = &output[p * element_count];
+        for (size_t j = start; j < element_count; j++) {
+            plane[j] = input[j * count + p];
+        }
+    }
+    memcpy(&output[element_count * count], &input[element_count * count], size - element_count * count);
+}
+
+/*
+* Function: merge_planes_from
+* ---------------------------
+*  Portable plane merger for the elements from start on, and the tail
+*  bytes that do not fill a whole element.
+*/
+static void merge_planes_from(const unsigned char* input, size_t size, size_t count, unsigned char* output,
+                              size_t start) {
+    size_t element_count = size / count;
+    for (size_t p = 0; p < count; p++) {
+        const unsigned char* plane = &input[p * element_count];
+        for (size_t j = start; j < element_count; j++) {
+            output[j * count + p] = plane[j];
+        }
+    }
+    memcpy(&output[element_count * count], &input[element_count * count], size - element_count * count);
+}
+
+/*
+* Function: split_planes_scalar
+* -----------------------------
+*  Portable plane splitter, one byte at a time.
+*/
+static void split_planes_scalar(const unsigned char* input, size_t size, size_t count, unsigned char* output) {
+    split_planes_from(input, size, count, output, 0);
+}
+
+/*
+* Function: merge_planes_scalar
+* -----------------------------
+*  Portable plane merger, one byte at a time.
+*/
+static void merge_planes_scalar(const unsigned char* input, size_t size, size_t count, unsigned char* output) {
+    merge_planes_from(input, size, count, output, 0);
+}
+
+/*
+* Function: build_plane_masks
+* ---------------------------
+*  Builds the byte shuffle masks for 16 elements of count bytes, which span
+*  count 16-byte vectors. split[p][v] picks the bytes of plane p out of
+*  vector v, merge[v][p] places the bytes of plane p into vector v. Lanes
+*  filled from another vector are 0x80, which a shuffle turns into zero.
+*/
+static void build_plane_masks(size_t count, unsigned char split[][MAX_PLANE_COUNT][16],
+                              unsigned char merge[][MAX_PLANE_COUNT][16]) {
+    for (size_t v = 0; v < count; v++) {
+        for (size_t p = 0; p < count; p++) {
+            for (size_t lane = 0; lane < 16; lane++) {
+                size_t source = lane * count + p;
+                size_t target = 16 * v + lane;
+                split[p][v][lane] = source / 16 == v ? (unsigned char) (source % 16) : 0x80;
+                merge[v][p][lane] = target % count == p ? (unsigned char) (target / count) : 0x80;
+            }
+        }
+    }
+}
+
+/*
+* Function: encode_delta_from
+* ---------------------------
+*  Portable delta encoder for the bytes from start on (start >= stride).
+*/
+static void encode_delta_from(const unsigned char* input, size_t size, size_t stride, DeltaMode mode,
+                              unsigned char* output, size_t start) {
+    if (mode == delta_xor) {
+        for (size_t i = start; i < size; i++) {
+            output[i] = input[i] ^ input[i - stride];
+        }
+    } else {
+        for (size_t i = start; i < size; i++) {
+            output[i] = (unsigned char) (input[i] - input[i - stride]);
+        }
+    }
+}
+
+/*
+* Function: decode_delta_from
+* ---------------------------
+*  Portable delta decoder for the bytes from start on (start >= stride).
+*/
+static void decode_delta_from(unsigned char* data, size_t size, size_t stride, DeltaMode mode, size_t start) {
+    if (mode == delta_xor) {
+        for (size_t i = start; i < size; i++) {
+            data[i] ^= data[i - stride];
+        }
+    } else {
+        for (size_t i = start; i < size; i++) {
+            data[i] = (unsigned char) (data[i] + data[i - stride]);
+        }
+    }
+}
+
+/*
+* Function: encode_delta_scalar
+* -----------------------------
+*  Portable delta encoder, one byte at a time.
+*/
+static void encode_delta_scalar(const unsigned char* input, size_t size, size_t stride, DeltaMode mode,
+                                unsigned char* output) {
+    memcpy(output, input, size < stride ? size : stride);
+    encode_delta_from(input, size, stride, mode, output, stride);
+}
+
+/*
+* Function: decode_delta_scalar
+* -----------------------------
+*  Portable delta decoder, one byte at a time.
+*/
+static void decode_delta_scalar(unsigned char* data, size_t size, size_t stride, DeltaMode mode) {
+    decode_delta_from(data, size, stride, mode, stride);
+}
+
+#ifdef SIMD_X86
+__attribute__((target("sse2")))
+static size_t run_length_sse2(const unsigned char* data, size_t size, unsigned char value) {
+    const __m128i pattern = _mm_set1_epi8((char) value);
+    size_t i = 0;
+
+    while (i + 16 <= size) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) &data[i]);
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, pattern));
+        if (mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+        i += 16;
+    }
+    return i + run_length_scalar(&data[i], size - i, value);
+}
+
+__attribute__((target("sse2")))
+static size_t find_repeat_sse2(const unsigned char* data, size_t size) {
+    size_t i = 0;
+
+    while (i + 16 + 1 <= size) {
+        __m128i current = _mm_loadu_si128((const __m128i*) &data[i]);
+        __m128i next = _mm_loadu_si128((const __m128i*) &data[i + 1]);
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(current, next));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    return i + find_repeat_scalar(&data[i], size - i);
+}
+
+__attribute__((target("sse2")))
+static size_t find_mismatch_sse2(const unsigned char* a, const unsigned char* b, size_t size) {
+    size_t i = 0;
+
+    while (i + 16 <= size) {
+        __m128i bytes_a = _mm_loadu_si128((const __m128i*) &a[i]);
+        __m128i bytes_b = _mm_loadu_si128((const __m128i*) &b[i]);
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes_a, bytes_b));
+        if (mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+        i += 16;
+    }
+    return i + find_mismatch_scalar(&a[i], &b[i], size - i);
+}
+
+__attribute__((target("sse2")))
+static size_t find_element_repeat_sse2(const unsigned char* data, size_t count, size_t width) {
+    size_t size = count * width;
+    size_t i = 0;
+
+    // Every element is compared with the next one: bytes [i, i + 16) with [i + width, i + width + 16),
+    // stepping by whole elements (15 bytes for 3-byte pixels)
+    if (width == 2 || width == 3 || width == 4 || width == 8) {
+        size_t step = 16 - 16 % width;
+        while (i + 16 + width <= size) {
+            __m128i current = _mm_loadu_si128((const __m128i*) &data[i]);
+            __m128i next = _mm_loadu_si128((const __m128i*) &data[i + width]);
+            uint64_t mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(current, next));
+            mask = equal_element_mask(mask, width);
+            if (mask != 0) {
+                return (i + __builtin_ctzll(mask)) / width;
+            }
+            i += step;
+        }
+    }
+    return i / width + find_element_repeat_scalar(&data[i], count - i / width, width);
+}
+
+__attribute__((target("ssse3")))
+static void split_planes_ssse3(const unsigned char* input, size_t size, size_t count, unsigned char* output) {
+    unsigned char split[MAX_PLANE_COUNT][MAX_PLANE_COUNT][16];
+    unsigned char merge[MAX_PLANE_COUNT][MAX_PLANE_COUNT][16];
+    build_plane_masks(count, split, merge);
+    size_t element_count = size / count;
+    size_t j = 0;
+
+    // 16 elements (count vectors) per step, every plane is the OR of one shuffle per vector
+    for (; j + 16 <= element_count; j += 16) {
+        const unsigned char* group = &input[j * count];
+        __m128i vectors[MAX_PLANE_COUNT];
+        for (size_t v = 0; v < count; v++) {
+            vectors[v] = _mm_loadu_si128((const __m128i*) &group[16 * v]);
+        }
+        for (size_t p = 0; p < count; p++) {
+            __m128i plane = _mm_setzero_si128();
+            for (size_t v = 0; v < count; v++) {
+                __m128i mask = _mm_loadu_si128((const __m128i*) split[p][v]);
+                plane = _mm_or_si128(plane, _mm_shuffle_epi8(vectors[v], mask));
+            }
+            _mm_storeu_si128((__m128i*) &output[p * element_count + j], plane);
+        }
+    }
+    split_planes_from(input, size, count, output, j);
+}
+
+__attribute__((target("ssse3")))
+static void merge_planes_ssse3(const unsigned char* input, size_t size, size_t count, unsigned char* output) {
+    unsigned char split[MAX_PLANE_COUNT][MAX_PLANE_COUNT][16];
+    unsigned char merge[MAX_PLANE_COUNT][MAX_PLANE_COUNT][16];
+    build_plane_masks(count, split, merge);
+    size_t element_count = size / count;
+    size_t j = 0;
+
+    for (; j + 16 <= element_count; j += 16) {
+        unsigned char* group = &output[j * count];
+        __m128i planes[MAX_PLANE_COUNT];
+        for (size_t p = 0; p < count; p++) {
+            planes[p] = _mm_loadu_si128((const __m128i*) &input[p * element_count + j]);
+        }
+        for (size_t v = 0; v < count; v++) {
+            __m128i vector = _mm_setzero_si128();
+            for (size_t p = 0; p < count; p++) {
+                __m128i mask = _mm_loadu_si128((const __m128i*) merge[v][p]);
+                vector = _mm_or_si128(vector, _mm_shuffle_epi8(planes[p], mask));
+            }
+            _mm_storeu_si128((__m128i*) &group[16 * v], vector);
+        }
+    }
+    merge_planes_from(input, size, count, output, j);
+}
+
+__attribute__((target("sse2")))
+static void encode_delta_sse2(const unsigned char* input, size_t size, size_t stride, DeltaMode mode,
+                              unsigned char* output) {
+    memcpy(output, input, size < stride ? size : stride);
+    size_t i = stride;
+
+    // The input is left untouched, so every byte only depends on two loads
+    while (i + 16 <= size) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) &input[i]);
+        __m128i previous = _mm_loadu_si128((const __m128i*) &input[i - stride]);
+        bytes = mode == delta_xor ? _mm_xor_si128(bytes, previous) : _mm_sub_epi8(bytes, previous);
+        _mm_storeu_si128((__m128i*) &output[i], bytes);
+        i += 16;
+    }
+    encode_delta_from(input, size, stride, mode, output, i);
+}
+
+__attribute__((target("ssse3")))
+static void decode_delta_ssse3(unsigned char* data, size_t size, size_t stride, DeltaMode mode) {
+    size_t i = stride;
+
+    if (stride >= 16) {
+        // 16 bytes never reach back into themselves
+        while (i + 16 <= size) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*) &data[i]);
+            __m128i previous = _mm_loadu_si128((const __m128i*) &data[i - stride]);
+            bytes = mode == delta_xor ? _mm_xor_si128(bytes, previous) : _mm_add_epi8(bytes, previous);
+            _mm_storeu_si128((__m128i*) &data[i], bytes);
+            i += 16;
+        }
+    } else if (size >= 32) {
+        // Prefix sum of every stride-th byte inside a vector in log steps, then the carry of the
+        // previous (decoded) vector: lane l continues byte 16 - stride + l % stride of it
+        unsigned char shift_masks[4][16];
+        unsigned char carry_mask[16];
+        size_t step_count = 0;
+        for (size_t shift = stride; shift < 16; shift *= 2) {
+            for (size_t lane = 0; lane < 16; lane++) {
+                shift_masks[step_count][lane] = lane >= shift ? (unsigned char) (lane - shift) : 0x80;
+            }
+            step_count++;
+        }
+        for (size_t lane = 0; lane < 16; lane++) {
+            carry_mask[lane] = (unsigned char) (16 - stride + lane % stride);
+        }
+        const __m128i carry_shuffle = _mm_loadu_si128((const __m128i*) carry_mask);
+
+        decode_delta_from(data, 16, stride, mode, stride);
+        __m128i previous = _mm_loadu_si128((const __m128i*) data);
+        for (i = 16; i + 16 <= size; i += 16) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*) &data[i]);
+            for (size_t step = 0; step < step_count; step++) {
+                __m128i shifted = _mm_shuffle_epi8(bytes, _mm_loadu_si128((const __m128i*) shift_masks[step]));
+                bytes = mode == delta_xor ? _mm_xor_si128(bytes, shifted) : _mm_add_epi8(bytes, shifted);
+            }
+            __m128i carry = _mm_shuffle_epi8(previous, carry_shuffle);
+            bytes = mode == delta_xor ? _mm_xor_si128(bytes, carry) : _mm_add_epi8(bytes, carry);
+            _mm_storeu_si128((__m128i*) &data[i], bytes);
+            previous = bytes;
+        }
+    }
+    decode_delta_from(data, size, stride, mode, i);
+}
+
+__attribute__((target("avx2")))
+static size_t run_length_avx2(const unsigned char* data, size_t size, unsigned char value) {
+    const __m256i pattern = _mm256_set1_epi8((char) value);
+    size_t i = 0;
+
+    while (i + 32 <= size) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*) &data[i]);
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, pattern));
+        if (mask != UINT32_MAX) {
+            return i + __builtin_ctz(~mask);
+        }
+        i += 32;
+    }
+    return i + run_length_scalar(&data[i], size - i, value);
+}
+
+__attribute__((target("avx2")))
+static size_t find_repeat_avx2(const unsigned char* data, size_t size) {
+    size_t i = 0;
+
+    while (i + 32 + 1 <= size) {
+        __m256i current = _mm256_loadu_si256((const __m256i*) &data[i]);
+        __m256i next = _mm256_loadu_si256((const __m256i*) &data[i + 1]);
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(current, next));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 32;
+    }
+    return i + find_repeat_scalar(&data[i], size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t find_mismatch_avx2(const unsigned char* a, const unsigned char* b, size_t size) {
+    size_t i = 0;
+
+    while (i + 32 <= size) {
+        __m256i bytes_a = _mm256_loadu_si256((const __m256i*) &a[i]);
+        __m256i bytes_b = _mm256_loadu_si256((const __m256i*) &b[i]);
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes_a, bytes_b));
+        if (mask != UINT32_MAX) {
+            return i + __builtin_ctz(~mask);
+        }
+        i += 32;
+    }
+    return i + find_mismatch_scalar(&a[i], &b[i], size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t find_element_repeat_avx2(const unsigned char* data, size_t count, size_t width) {
+    size_t size = count * width;
+    size_t i = 0;
+
+    if (width == 2 || width == 3 || width == 4 || width == 8) {
+        size_t step = 32 - 32 % width;
+        while (i + 32 + width <= size) {
+            __m256i current = _mm256_loadu_si256((const __m256i*) &data[i]);
+            __m256i next = _mm256_loadu_si256((const __m256i*) &data[i + width]);
+            uint64_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(current, next));
+            mask = equal_element_mask(mask, width);
+            if (mask != 0) {
+                return (i + __builtin_ctzll(mask)) / width;
+            }
+            i += step;
+        }
+    }
+    return i / width + find_element_repeat_scalar(&data[i], count - i / width, width);
+}
+
+__attribute__((target("avx2")))
+static void split_planes_avx2(const unsigned char* input, size_t size, size_t count, unsigned char* output) {
+    unsigned char split[MAX_PLANE_COUNT][MAX_PLANE_COUNT][16];
+    unsigned char merge[MAX_PLANE_COUNT][MAX_PLANE_COUNT][16];
+    build_plane_masks(count, split, merge);
+    size_t element_count = size / count;
+    size_t j = 0;
+
+    // Shuffles stay within 128-bit lanes: the low lanes hold elements [j, j + 16), the high lanes [j + 16, j + 32)
+    for (; j + 32 <= element_count; j += 32) {
+        const unsigned char* group = &input[j * count];
+        __m256i vectors[MAX_PLANE_COUNT];
+        for (size_t v = 0; v < count; v++) {
+            __m128i low = _mm_loadu_si128((const __m128i*) &group[16 * v]);
+            __m128i high = _mm_loadu_si128((const __m128i*) &group[16 * (count + v)]);
+            vectors[v] = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        }
+        for (size_t p = 0; p < count; p++) {
+            __m256i plane = _mm256_setzero_si256();
+            for (size_t v = 0; v < count; v++) {
+                __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) split[p][v]));
+                plane = _mm256_or_si256(plane, _mm256_shuffle_epi8(vectors[v], mask));
+            }
+            _mm256_storeu_si256((__m256i*) &output[p * element_count + j], plane);
+        }
+    }
+    split_planes_from(input, size, count, output, j);
+}
+
+__attribute__((target("avx2")))
+static void merge_planes_avx2(const unsigned char* input, size_t size, size_t count, unsigned char* output) {
+    unsigned char split[MAX_PLANE_COUNT][MAX_PLANE_COUNT][16];
+    unsigned char merge[MAX_PLANE_COUNT][MAX_PLANE_COUNT][16];
+    build_plane_masks(count, split, merge);
+    size_t element_count = size / count;
+    size_t j = 0;
+
+    for (; j + 32 <= element_count; j += 32) {
+        unsigned char* group = &output[j * count];
+        __m256i planes[MAX_PLANE_COUNT];
+        for (size_t p = 0; p < count; p++) {
+            planes[p] = _mm256_loadu_si256((const __m256i*) &input[p * element_count + j]);
+        }
+        for (size_t v = 0; v < count; v++) {
+            __m256i vector = _mm256_setzero_si256();
+            for (size_t p = 0; p < count; p++) {
+                __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) merge[v][p]));
+                vector = _mm256_or_si256(vector, _mm256_shuffle_epi8(planes[p], mask));
+            }
+            _mm_storeu_si128((__m128i*) &group[16 * v], _mm256_castsi256_si128(vector));
+            _mm_storeu_si128((__m128i*) &group[16 * (count + v)], _mm256_extracti128_si256(vector, 1));
+        }
+    }
+    merge_planes_from(input, size, count, output, j);
+}
+
+__attribute__((target("avx2")))
+static void encode_delta_avx2(const unsigned char* input, size_t size, size_t stride, DeltaMode mode,
+                              unsigned char* output) {
+    memcpy(output, input, size < stride ? size : stride);
+    size_t i = stride;
+
+    while (i + 32 <= size) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*) &input[i]);
+        __m256i previous = _mm256_loadu_si256((const __m256i*) &input[i - stride]);
+        bytes = mode == delta_xor ? _mm256_xor_si256(bytes, previous) : _mm256_sub_epi8(bytes, previous);
+        _mm256_storeu_si256((__m256i*) &output[i], bytes);
+        i += 32;
+    }
+    encode_delta_from(input, size, stride, mode, output, i);
+}
+
+__attribute__((target("avx2")))
+static void decode_delta_avx2(unsigned char* data, size_t size, size_t stride, DeltaMode mode) {
+    // Shorter strides depend on bytes of the same vector, see decode_delta_ssse3()
+    if (stride < 32) {
+        decode_delta_ssse3(data, size, stride, mode);
+        return;
+    }
+    size_t i = stride;
+
+    while (i + 32 <= size) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*) &data[i]);
+        __m256i previous = _mm256_loadu_si256((const __m256i*) &data[i - stride]);
+        bytes = mode == delta_xor ? _mm256_xor_si256(bytes, previous) : _mm256_add_epi8(bytes, previous);
+        _mm256_storeu_si256((__m256i*) &data[i], bytes);
+        i += 32;
+    }
+    decode_delta_from(data, size, stride, mode, i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t run_length_avx512(const unsigned char* data, size_t size, unsigned char value) {
+    const __m512i pattern = _mm512_set1_epi8((char) value);
+    size_t i = 0;
+
+    while (i + 64 <= size) {
+        __m512i bytes = _mm512_loadu_si512((const void*) &data[i]);
+        uint64_t mask = _mm512_cmpeq_epi8_mask(bytes, pattern);
+        if (mask != UINT64_MAX) {
+            return i + __builtin_ctzll(~mask);
+        }
+        i += 64;
+    }
+    return i + run_length_scalar(&data[i], size - i, value);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t find_repeat_avx512(const unsigned char* data, size_t size) {
+    size_t i = 0;
+
+    while (i + 64 + 1 <= size) {
+        __m512i current = _mm512_loadu_si512((const void*) &data[i]);
+        __m512i next = _mm512_loadu_si512((const void*) &data[i + 1]);
+        uint64_t mask = _mm512_cmpeq_epi8_mask(current, next);
+        if (mask != 0) {
+            return i + __builtin_ctzll(mask);
+        }
+        i += 64;
+    }
+    return i + find_repeat_scalar(&data[i], size - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t find_mismatch_avx512(const unsigned char* a, const unsigned char* b, size_t size) {
+    size_t i = 0;
+
+    while (i + 64 <= size) {
+        __m512i bytes_a = _mm512_loadu_si512((const void*) &a[i]);
+        __m512i bytes_b = _mm512_loadu_si512((const void*) &b[i]);
+        uint64_t mask = _mm512_cmpeq_epi8_mask(bytes_a, bytes_b);
+        if (mask != UINT64_MAX) {
+            return i + __builtin_ctzll(~mask);
+        }
+        i += 64;
+    }
+    return i + find_mismatch_scalar(&a[i], &b[i], size - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t find_element_repeat_avx512(const unsigned char* data, size_t count, size_t width) {
+    size_t size = count * width;
+    size_t i = 0;
+
+    if (width == 2 || width == 3 || width == 4 || width == 8) {
+        size_t step = 64 - 64 % width;
+        while (i + 64 + width <= size) {
+            __m512i current = _mm512_loadu_si512((const void*) &data[i]);
+            __m512i next = _mm512_loadu_si512((const void*) &data[i + width]);
+            uint64_t mask = equal_element_mask(_mm512_cmpeq_epi8_mask(current, next), width);
+            if (mask != 0) {
+                return (i + __builtin_ctzll(mask)) / width;
+            }
+            i += step;
+        }
+    }
+    return i / width + find_element_repeat_scalar(&data[i], count - i / width, width);
+}
+#endif
+
+static RunLengthKernel run_length_kernel = run_length_scalar;
+static FindRepeatKernel find_repeat_kernel = find_repeat_scalar;
+static FindMismatchKernel find_mismatch_kernel = find_mismatch_scalar;
+static FindElementRepeatKernel find_element_repeat_kernel = find_element_repeat_scalar;
+static PlaneKernel split_planes_kernel = split_planes_scalar;
+static PlaneKernel merge_planes_kernel = merge_planes_scalar;
+static EncodeDeltaKernel encode_delta_kernel = encode_delta_scalar;
+static DecodeDeltaKernel decode_delta_kernel = decode_delta_scalar;
+static const char* kernel_name = "scalar";
+
+/*
+* Function: select_kernels
+* ------------------------
+*  Picks the widest kernels the CPU supports (cpuid), once at startup.
+*/
+__attribute__((constructor))
+static void select_kernels(void) {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        run_length_kernel = run_length_avx512;
+        find_repeat_kernel = find_repeat_avx512;
+        find_mismatch_kernel = find_mismatch_avx512;
+        find_element_repeat_kernel = find_element_repeat_avx512;
+        kernel_name = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        run_length_kernel = run_length_avx2;
+        find_repeat_kernel = find_repeat_avx2;
+        find_mismatch_kernel = find_mismatch_avx2;
+        find_element_repeat_kernel = find_element_repeat_avx2;
+        kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        run_length_kernel = run_length_sse2;
+        find_repeat_kernel = find_repeat_sse2;
+        find_mismatch_kernel = find_mismatch_sse2;
+        find_element_repeat_kernel = find_element_repeat_sse2;
+        kernel_name = "sse2";
+    }
+    // Byte shuffles need SSSE3, and AVX-512 adds nothing over AVX2 for them
+    if (__builtin_cpu_supports("avx2")) {
+        split_planes_kernel = split_planes_avx2;
+        merge_planes_kernel = merge_planes_avx2;
+        encode_delta_kernel = encode_delta_avx2;
+        decode_delta_kernel = decode_delta_avx2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        split_planes_kernel = split_planes_ssse3;
+        merge_planes_kernel = merge_planes_ssse3;
+        encode_delta_kernel = encode_delta_sse2;
+        decode_delta_kernel = decode_delta_ssse3;
+    } else if (__builtin_cpu_supports("sse2")) {
+        encode_delta_kernel = encode_delta_sse2;
+    }
+#endif
+}
+
+/*
+* Function: find_run_length
+* -------------------------
+*  Counts how many leading bytes of data are equal to value. Uses the widest
+*  kernel (AVX-512, AVX2, SSE2 or scalar) supported by the CPU.
+*
+*  data: Pointer to the bytes to scan.
+*  size: Maximum number of bytes to scan.
+*  value: The run byte.
+*
+*  returns: Length of the run at the beginning of data.
+*/
+size_t find_run_length(const unsigned char* data, size_t size, unsigned char value) {
+    return run_length_kernel(data, size, value);
+}
+
+/*
+* Function: find_repeat
+* ---------------------
+*  Finds the first position where a byte is equal to the byte after it.
+*  Uses the widest kernel supported by the CPU.
+*
+*  data: Pointer to the bytes to scan.
+*  size: Number of bytes to scan.
+*
+*  returns: Smallest i with data[i] == data[i + 1]. If not found (size).
+*/
+size_t find_repeat(const unsigned char* data, size_t size) {
+    return find_repeat_kernel(data, size);
+}
+
+/*
+* Function: find_mismatch
+* -----------------------
+*  Finds the first position where two byte arrays differ. Uses the widest
+*  kernel supported by the CPU.
+*
+*  a: Pointer to the first array.
+*  b: Pointer to the second array (may overlap a).
+*  size: Number of bytes to compare.
+*
+*  returns: Smallest i with a[i] != b[i]. If not found (size).
+*/
+size_t find_mismatch(const unsigned char* a, const unsigned char* b, size_t size) {
+    return find_mismatch_kernel(a, b, size);
+}
+
+/*
+* Function: find_element_repeat
+* -----------------------------
+*  Finds the first element (width bytes) that is equal to the element after
+*  it. Element widths 2, 4 and 8 are compared with the widest kernel
+*  supported by the CPU, other widths one element at a time.
+*
+*  data: Pointer to the elements.
+*  count: Number of elements to scan.
+*  width: Element width in bytes.
+*
+*  returns: Smallest k with element k == element k + 1. If not found (count).
+*/
+size_t find_element_repeat(const unsigned char* data, size_t count, size_t width) {
+    return find_element_repeat_kernel(data, count, width);
+}
+
+/*
+* Function: split_planes
+* ----------------------
+*  Splits elements of count bytes into count byte planes: byte p of every
+*  element goes to plane p, and the planes are stored one after the other.
+*  The size % count tail bytes are copied after the planes. Uses the widest
+*  byte shuffle kernel supported by the CPU.
+*
+*  input: Pointer to the elements.
+*  size: Number of bytes.
+*  count: Number of planes (1 to MAX_PLANE_COUNT).
+*  output: Pointer to size bytes for the planes (must not overlap input).
+*/
+void split_planes(const unsigned char* input, size_t size, size_t count, unsigned char* output) {
+    if (count <= 1) {
+        memcpy(output, input, size);
+        return;
+    }
+    split_planes_kernel(input, size, count, output);
+}
+
+/*
+* Function: merge_planes
+* ----------------------
+*  Reverses split_planes(): interleaves count byte planes back into
+*  elements of count bytes.
+*
+*  input: Pointer to the planes (and tail bytes).
+*  size: Number of bytes.
+*  count: Number of planes (1 to MAX_PLANE_COUNT).
+*  output: Pointer to size bytes for the elements (must not overlap input).
+*/
+void merge_planes(const unsigned char* input, size_t size, size_t count, unsigned char* output) {
+    if (count <= 1) {
+        memcpy(output, input, size);
+        return;
+    }
+    merge_planes_kernel(input, size, count, output);
+}
+
+/*
+* Function: encode_delta
+* ----------------------
+*  Replaces every byte from stride on with its difference (mode 'delta_sub')
+*  or XOR (mode 'delta_xor') to the byte stride bytes earlier, e.g. the same
+*  channel of the previous pixel or the previous row. The first stride bytes
+*  are copied. Uses the widest kernel supported by the CPU.
+*
+*  input: Pointer to the bytes.
+*  size: Number of bytes.
+*  stride: Distance to the previous byte (at least 1).
+*  mode: 'delta_sub' or 'delta_xor' ('delta_none' copies the bytes).
+*  output: Pointer to size bytes for the deltas (must not overlap input).
+*/
+void encode_delta(const unsigned char* input, size_t size, size_t stride, DeltaMode mode, unsigned char* output) {
+    if (mode == delta_none || stride == 0) {
+        memcpy(output, input, size);
+        return;
+    }
+    encode_delta_kernel(input, size, stride, mode, output);
+}
+
+/*
+* Function: decode_delta
+* ----------------------
+*  Reverses encode_delta() in place: a running sum (or XOR) of every
+*  stride-th byte. Strides below the vector width are decoded with byte
+*  shuffle prefix steps.
+*
+*  data: Pointer to the deltas, replaced by the bytes.
+*  size: Number of bytes.
+*  stride: Distance to the previous byte (at least 1).
+*  mode: 'delta_sub' or 'delta_xor' ('delta_none' leaves the bytes as they are).
+*/
+void decode_delta(unsigned char* data, size_t size, size_t stride, DeltaMode mode) {
+    if (mode == delta_none || stride == 0) {
+        return;
+    }
+    decode_delta_kernel(data, size, stride, mode);
+}
+
+/*
+* Function: simd_kernel_name
+* --------------------------
+*  Returns the name of the kernel set selected for this CPU.
+*
+*  returns: "avx512", "avx2", "sse2" or "scalar".
+*/
+const char* simd_kernel_name(void) {
+    return kernel_name;
+}
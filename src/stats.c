@@ -0,0 +1,88 @@
+#include "../include/stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+* Function: init_stats
+* --------------------
+*  Zeroes every counter of an RLEStats.
+*
+*  stats: Pointer to the RLEStats.
+*/
+void init_stats(RLEStats* stats) {
+    memset(stats, 0, sizeof(RLEStats));
+}
+
+/*
+* Function: count_run_token
+* -------------------------
+*  Counts a run token and adds its length to the histogram.
+*
+*  stats: Pointer to the RLEStats.
+*  length: Run length.
+*/
+void count_run_token(RLEStats* stats, size_t length) {
+    size_t bucket = 0;
+    while (length > 1 && bucket < RUN_HISTOGRAM_SIZE - 1) {
+        length >>= 1;
+        bucket++;
+    }
+    stats->run_tokens++;
+    stats->run_histogram[bucket]++;
+}
+
+/*
+* Function: merge_stats
+* ---------------------
+*  Adds the counters of one RLEStats to another (timings are not added,
+*  since parallel jobs overlap).
+*
+*  stats: Pointer to the RLEStats to add to.
+*  other: Pointer to the RLEStats to add.
+*/
+void merge_stats(RLEStats* stats, const RLEStats* other) {
+    stats->run_tokens += other->run_tokens;
+    stats->literal_tokens += other->literal_tokens;
+    for (int i = 0; i < RUN_HISTOGRAM_SIZE; i++) {
+        stats->run_histogram[i] += other->run_histogram[i];
+    }
+    stats->stored_blocks += other->stored_blocks;
+    stats->huffman_blocks += other->huffman_blocks;
+    stats->output_writes += other->output_writes;
+    stats->ring_requests += other->ring_requests;
+}
+
+/*
+* Function: print_stats
+* ---------------------
+*  Prints the counters, the run length histogram and the time spent in
+*  every phase.
+*
+*  stream: Output stream.
+*  stats: Pointer to the RLEStats.
+*/
+void print_stats(FILE* stream, const RLEStats* stats) {
+    double other_time = stats->total_time - stats->read_time - stats->codec_time - stats->write_time;
+    fprintf(stream, "\n[STATS]:"
+                    "\n\tBytes: %zu in -> %zu out"
+                    "\n\tTokens: %zu run, %zu literal"
+                    "\n\tStored blocks: %zu, Huffman coded blocks: %zu"
+                    "\n\tOutput writes: %zu, io_uring requests: %zu"
+                    "\n\tTime (wall clock): %f s total, %f s read, %f s codec, %f s write, %f s other",
+            stats->bytes_in, stats->bytes_out, stats->run_tokens, stats->literal_tokens, stats->stored_blocks,
+            stats->huffman_blocks, stats->output_writes, stats->ring_requests,
+            stats->total_time, stats->read_time, stats->codec_time, stats->write_time,
+            other_time > 0 ? other_time : 0);
+    if (stats->run_tokens > 0) {
+        fprintf(stream, "\n\tRun lengths:");
+        for (int i = 0; i < RUN_HISTOGRAM_SIZE; i++) {
+            if (i < RUN_HISTOGRAM_SIZE - 1) {
+                fprintf(stream, "\n\t\t%3d-%-3d: %zu", 1 << i, (2 << i) - 1, stats->run_histogram[i]);
+            } else {
+                fprintf(stream, "\n\t\t%3d+   : %zu", 1 << i, stats->run_histogram[i]);
+            }
+        }
+    }
+    fprintf(stream, "\n");
+}
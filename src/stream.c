@@ -0,0 +1,303 @@
+#include "../include/stream.h"
+#include "../include/constants.h"
+#include "../include/rle.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* Function: rle_stream_init
+* -------------------------
+*  Initiates a streaming codec context. The stream format is the legacy
+*  .rle token stream (compression mode byte, then tokens), which can be
+*  produced and consumed without knowing the input size and without
+*  seeking, so it works on pipes and sockets.
+*
+*  stream: Pointer to the RLEStream to initiate.
+*  direction: 'stream_compress' or 'stream_decompress'.
+*  compression_mode: Compression algorithm (compression only; decompression reads it from the stream).
+*
+*  returns: If failed (0), on success (1)
+*/
+int rle_stream_init(RLEStream* stream, StreamDirection direction, CompressionMode compression_mode) {
+    if (stream == NULL || (compression_mode != basic && compression_mode != advance)) {
+        fprintf(stderr, "\n[ERROR]: rle_stream_init() {} -> Required parameters are not valid!\n");
+        return 0;
+    }
+
+    memset(stream, 0, sizeof(RLEStream));
+    stream->direction = direction;
+    stream->compression_mode = compression_mode;
+    if (direction == stream_compress) {
+        stream->buffer = malloc(STREAM_BUFFER_SIZE);
+        if (stream->buffer == NULL) {
+            fprintf(stderr, "\n[ERROR]: rle_stream_init() {} -> Unable to allocate memory for the buffer!\n");
+            return 0;
+        }
+        init_memory_writer(&stream->rle_writer, stream->buffer, STREAM_BUFFER_SIZE, compression_mode);
+    }
+    return 1;
+}
+
+/*
+* Function: hand_out
+* ------------------
+*  Copies as many pending bytes as fit into the output.
+*
+*  returns: Copied bytes count.
+*/
+static size_t hand_out(const unsigned char* pending, size_t pending_size, unsigned char* output,
+                       size_t output_capacity, size_t* produced) {
+    size_t size = pending_size < output_capacity - *produced ? pending_size : output_capacity - *produced;
+    memcpy(&output[*produced], pending, size);
+    *produced += size;
+    return size;
+}
+
+/*
+* Function: rle_stream_compress
+* -----------------------------
+*  Compresses as much input as fits in the output. Encoded bytes that do
+*  not fit are kept in the context and handed out by the next call.
+*  stream->input_consumed is set to the input bytes consumed; the caller
+*  passes the rest again. With 'stream_finish', the pending run is ended
+*  once all input is consumed; call again until it returns 0.
+*
+*  stream: Pointer to the initiated RLEStream.
+*  input: Pointer to the input.
+*  input_size: Input size.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*  flush: 'stream_no_flush' or 'stream_finish' (no more input follows).
+*
+*  returns: Output bytes count. If failed (-1).
+*/
+ssize_t rle_stream_compress(RLEStream* stream, const unsigned char* input, size_t input_size, unsigned char* output,
+                            size_t output_capacity, StreamFlush flush) {
+    if (stream == NULL || stream->direction != stream_compress || (input == NULL && input_size > 0) ||
+        (output == NULL && output_capacity > 0) || (stream->finished && input_size > 0)) {
+        fprintf(stderr, "\n[ERROR]: rle_stream_compress() {} -> Required parameters are not valid!\n");
+        return -1;
+    }
+
+    RLEWriter* rle_writer = &stream->rle_writer;
+    size_t produced = 0;
+    size_t consumed = 0;
+    while (1) {
+        stream->buffer_drained += hand_out(&stream->buffer[stream->buffer_drained],
+                                           rle_writer->buffer_pos - stream->buffer_drained, output, output_capacity,
+                                           &produced);
+        if (stream->buffer_drained < rle_writer->buffer_pos) {
+            break;
+        }
+
+        // The buffer is drained: refill it from the start (literals are not merged across refills)
+        rle_writer->buffer_pos = 0;
+        rle_writer->counter_pos = -1;
+        stream->buffer_drained = 0;
+        if (!stream->started) {
+            stream->buffer[rle_writer->buffer_pos++] = (unsigned char) stream->compression_mode;
+            stream->started = 1;
+        } else if (consumed < input_size) {
+            // An input byte encodes to 2 bytes at most, and ending the pending run takes 2 more
+            size_t size = (STREAM_BUFFER_SIZE - 2) / 2;
+            size = input_size - consumed < size ? input_size - consumed : size;
+            if (write_rle_chunk(rle_writer, &input[consumed], size) == 0) {
+                return -1;
+            }
+            consumed += size;
+        } else if (flush == stream_finish && !stream->finished) {
+            if (rle_writer->flag_byte_count > 0 && flush_writer(rle_writer) < 0) {
+                return -1;
+            }
+            stream->finished = 1;
+        } else {
+            break;
+        }
+    }
+
+    stream->input_consumed = consumed;
+    stream->total_in += consumed;
+    stream->total_out += produced;
+    return produced;
+}
+
+/*
+* Function: decode_tokens
+* -----------------------
+*  Decodes whole tokens into memory.
+*
+*  returns: If failed (0), on success (1)
+*/
+static int decode_tokens(CompressionMode compression_mode, const unsigned char* tokens, size_t size,
+                         unsigned char* output, size_t decoded_size) {
+    RLEReader rle_reader;
+    return init_memory_reader(&rle_reader, output, decoded_size, compression_mode) &&
+           read_rle_chunk(&rle_reader, tokens, size) >= 0;
+}
+
+/*
+* Function: rle_stream_decompress
+* -------------------------------
+*  Decompresses as much input as fits in the output. Tokens are decoded
+*  straight into the output; a token cut off at the end of the input is
+*  kept in the context until the next call. stream->input_consumed is set
+*  to the input bytes consumed; the caller passes the rest again. With
+*  'stream_finish', an incomplete token is reported as a truncated stream.
+*
+*  stream: Pointer to the initiated RLEStream.
+*  input: Pointer to the compressed input.
+*  input_size: Input size.
+*  output: Pointer to the output buffer.
+*  output_capacity: Output buffer size.
+*  flush: 'stream_no_flush' or 'stream_finish' (no more input follows).
+*
+*  returns: Output bytes count. If failed (-1).
+*/
+ssize_t rle_stream_decompress(RLEStream* stream, const unsigned char* input, size_t input_size, unsigned char* output,
+                              size_t output_capacity, StreamFlush flush) {
+    if (stream == NULL || stream->direction != stream_decompress || (input == NULL && input_size > 0) ||
+        (output == NULL && output_capacity > 0)) {
+        fprintf(stderr, "\n[ERROR]: rle_stream_decompress() {} -> Required parameters are not valid!\n");
+        return -1;
+    }
+
+    CompressionMode compression_mode = stream->compression_mode;
+    size_t produced = 0;
+    size_t consumed = 0;
+    while (1) {
+        stream->token_pos += hand_out(&stream->token[stream->token_pos], stream->token_size - stream->token_pos,
+                                      output, output_capacity, &produced);
+        if (stream->token_pos < stream->token_size) {
+            break;
+        }
+
+        size_t decoded_size = 0;
+        ssize_t token_size = 0;
+        if (!stream->started) {
+            if (consumed == input_size) {
+                break;
+            }
+            compression_mode = (CompressionMode) input[consumed++];
+            if (compression_mode != basic && compression_mode != advance) {
+                fprintf(stderr, "\n[ERROR]: rle_stream_decompress() {} -> Stream is corrupted!\n");
+                return -1;
+            }
+            stream->compression_mode = compression_mode;
+            stream->started = 1;
+            continue;
+        }
+
+        if (stream->carry_size > 0) {
+            // Complete the token cut off at the end of the last input
+            while ((token_size = next_token(stream->carry, stream->carry_size, compression_mode, &decoded_size)) == 0 &&
+                   consumed < input_size) {
+                stream->carry[stream->carry_size++] = input[consumed++];
+            }
+            if (token_size < 0 ||
+                (token_size > 0 && !decode_tokens(compression_mode, stream->carry, token_size, stream->token, decoded_size))) {
+                fprintf(stderr, "\n[ERROR]: rle_stream_decompress() {} -> Stream is corrupted!\n");
+                return -1;
+            }
+            if (token_size == 0) {
+                break;
+            }
+            stream->carry_size = 0;
+            stream->token_size = decoded_size;
+            stream->token_pos = 0;
+            continue;
+        }
+
+        // Whole tokens that fit in the output are decoded straight into it
+        size_t start = consumed;
+        size_t batch_size = 0;
+        while (consumed < input_size &&
+               (token_size = next_token(&input[consumed], input_size - consumed, compression_mode, &decoded_size)) > 0 &&
+               decoded_size <= output_capacity - produced - batch_size) {
+            batch_size += decoded_size;
+            consumed += token_size;
+        }
+        if (token_size < 0 ||
+            (consumed > start &&
+             !decode_tokens(compression_mode, &input[start], consumed - start, &output[produced], batch_size))) {
+            fprintf(stderr, "\n[ERROR]: rle_stream_decompress() {} -> Stream is corrupted!\n");
+            return -1;
+        }
+        produced += batch_size;
+        if (consumed == input_size) {
+            break;
+        }
+        if (token_size == 0) {
+            stream->carry_size = input_size - consumed;
+            memcpy(stream->carry, &input[consumed], stream->carry_size);
+            consumed = input_size;
+            break;
+        }
+
+        // The next token does not fit: decode it on its own and hand it out in pieces
+        if (!decode_tokens(compression_mode, &input[consumed], token_size, stream->token, decoded_size)) {
+            return -1;
+        }
+        consumed += token_size;
+        stream->token_size = decoded_size;
+        stream->token_pos = 0;
+    }
+
+    if (flush == stream_finish && consumed == input_size && (!stream->started || stream->carry_size > 0)) {
+        fprintf(stderr, "\n[ERROR]: rle_stream_decompress() {} -> Stream is truncated!\n");
+        return -1;
+    }
+    stream->input_consumed = consumed;
+    stream->total_in += consumed;
+    stream->total_out += produced;
+    return produced;
+}
+
+/*
+* Function: rle_stream_reset
+* --------------------------
+*  Readies a streaming codec context for the next stream, keeping its
+*  buffer, so a context serving many streams allocates nothing per stream.
+*
+*  stream: Pointer to the initiated RLEStream.
+*  direction: 'stream_compress' or 'stream_decompress'.
+*  compression_mode: Compression algorithm (compression only; decompression reads it from the stream).
+*
+*  returns: If failed (0), on success (1)
+*/
+int rle_stream_reset(RLEStream* stream, StreamDirection direction, CompressionMode compression_mode) {
+    if (stream == NULL || (compression_mode != basic && compression_mode != advance)) {
+        fprintf(stderr, "\n[ERROR]: rle_stream_reset() {} -> Required parameters are not valid!\n");
+        return 0;
+    }
+
+    unsigned char* buffer = stream->buffer;
+    memset(stream, 0, sizeof(RLEStream));
+    stream->direction = direction;
+    stream->compression_mode = compression_mode;
+    stream->buffer = buffer;
+    if (direction == stream_compress) {
+        if (stream->buffer == NULL && (stream->buffer = malloc(STREAM_BUFFER_SIZE)) == NULL) {
+            fprintf(stderr, "\n[ERROR]: rle_stream_reset() {} -> Unable to allocate memory for the buffer!\n");
+            return 0;
+        }
+        init_memory_writer(&stream->rle_writer, stream->buffer, STREAM_BUFFER_SIZE, compression_mode);
+    }
+    return 1;
+}
+
+/*
+* Function: rle_stream_end
+* ------------------------
+*  Frees the buffers of a streaming codec context.
+*
+*  stream: Pointer to the initiated RLEStream.
+*/
+void rle_stream_end(RLEStream* stream) {
+    if (stream == NULL) {
+        return;
+    }
+    free(stream->buffer);
+    stream->buffer = NULL;
+}
@@ -0,0 +1,342 @@
+#include "../include/thread_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define INITIAL_TASK_CAPACITY 64
+
+// The pool and the queue of the worker running on this thread (NULL outside any pool)
+static _Thread_local ThreadPool* current_pool = NULL;
+static _Thread_local size_t current_queue = 0;
+
+/*
+* Function: get_cpu_count
+* -----------------------
+*  Returns the number of online CPUs.
+*
+*  returns: CPU count (at least 1).
+*/
+size_t get_cpu_count(void) {
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpu_count > 0 ? (size_t) cpu_count : 1;
+}
+
+/*
+* Function: take_task
+* -------------------
+*  Takes the oldest task of the calling worker's own queue or, if it is
+*  empty, steals the oldest task of another queue. Blocks are queued in
+*  file order, so taking the oldest one first keeps the writes to a mapped
+*  output sequential.
+*
+*  returns: Task found (1), all queues empty (0)
+*/
+static int take_task(ThreadPool* pool, Task* task) {
+    size_t start = current_pool == pool ? current_queue : 0;
+    int found = 0;
+    for (size_t i = 0; !found && i < pool->thread_count; i++) {
+        TaskQueue* queue = &pool->queues[(start + i) % pool->thread_count];
+        pthread_mutex_lock(&queue->lock);
+        if (queue->count > 0) {
+            *task = queue->tasks[queue->head];
+            queue->head = (queue->head + 1) % queue->capacity;
+            queue->count--;
+            found = 1;
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+    if (found) {
+        pthread_mutex_lock(&pool->lock);
+        pool->task_count--;
+        pool->active_count++;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return found;
+}
+
+/*
+* Function: run_task
+* ------------------
+*  Runs a taken task and wakes up the threads waiting for it.
+*/
+static void run_task(ThreadPool* pool, const Task* task) {
+    task->function(task->arg);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->active_count--;
+    if (task->group != NULL) {
+        task->group->pending--;
+    }
+    if ((task->group != NULL && task->group->pending == 0) || (pool->task_count == 0 && pool->active_count == 0)) {
+        pthread_cond_broadcast(&pool->tasks_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+* Function: worker_main
+* ---------------------
+*  Worker thread loop: runs tasks from its own queue, steals tasks from the
+*  other queues, and sleeps when all of them are empty, until the pool stops.
+*/
+static void* worker_main(void* arg) {
+    ThreadPool* pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    current_pool = pool;
+    current_queue = pool->started_count++;
+    pthread_mutex_unlock(&pool->lock);
+
+    while (1) {
+        Task task;
+        if (take_task(pool, &task)) {
+            run_task(pool, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->task_count == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->task_ready, &pool->lock);
+        }
+        int stop = pool->task_count == 0 && pool->stopping;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*
+* Function: stop_thread_pool
+* --------------------------
+*  Stops the first started_count worker threads once the queued tasks are
+*  finished, and frees the pool.
+*/
+static void stop_thread_pool(ThreadPool* pool, size_t started_count) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < started_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+        free(pool->queues[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->task_ready);
+    pthread_cond_destroy(&pool->tasks_done);
+    free(pool->threads);
+    free(pool->queues);
+    pool->threads = NULL;
+    pool->queues = NULL;
+}
+
+/*
+* Function: init_thread_pool
+* --------------------------
+*  Starts the worker threads of a ThreadPool. Every worker has a queue of
+*  its own, where the tasks it submits stay; when its queue is empty, it
+*  steals the oldest task of another worker's queue.
+*
+*  pool: Pointer to the ThreadPool to initiate.
+*  thread_count: Number of worker threads (0 = one per CPU).
+*
+*  returns: If failed (0), on success (1)
+*/
+int init_thread_pool(ThreadPool* pool, size_t thread_count) {
+    if (pool == NULL) {
+        fprintf(stderr, "[ERROR]: init_thread_pool() {} -> ThreadPool is NULL!\n");
+        return 0;
+    }
+
+    pool->thread_count = thread_count > 0 ? thread_count : get_cpu_count();
+    pool->next_queue = 0;
+    pool->started_count = 0;
+    pool->task_count = 0;
+    pool->active_count = 0;
+    pool->group_waiters = 0;
+    pool->stopping = 0;
+    pool->threads = malloc(pool->thread_count * sizeof(pthread_t));
+    pool->queues = calloc(pool->thread_count, sizeof(TaskQueue));
+    int result = pool->threads != NULL && pool->queues != NULL;
+    for (size_t i = 0; result && i < pool->thread_count; i++) {
+        pool->queues[i].tasks = malloc(INITIAL_TASK_CAPACITY * sizeof(Task));
+        pool->queues[i].capacity = INITIAL_TASK_CAPACITY;
+        result = pool->queues[i].tasks != NULL;
+    }
+    if (!result) {
+        fprintf(stderr, "[ERROR]: init_thread_pool() {} -> Unable to allocate memory for the pool!\n");
+        for (size_t i = 0; pool->queues != NULL && i < pool->thread_count; i++) {
+            free(pool->queues[i].tasks);
+        }
+        free(pool->threads);
+        free(pool->queues);
+        return 0;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->task_ready, NULL);
+    pthread_cond_init(&pool->tasks_done, NULL);
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+    }
+
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+            fprintf(stderr, "[ERROR]: init_thread_pool() {} -> Unable to start a worker thread!\n");
+            stop_thread_pool(pool, i);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+* Function: submit_task
+* ---------------------
+*  Queues a task to be run by one of the worker threads. A task submitted
+*  by a worker goes to the worker's own queue, other tasks are spread over
+*  the queues in turn.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*  function: Task function.
+*  arg: Argument passed to the task function.
+*
+*  returns: If failed (0), on success (1)
+*/
+int submit_task(ThreadPool* pool, TaskFunction function, void* arg) {
+    return submit_group_task(pool, NULL, function, arg);
+}
+
+/*
+* Function: submit_group_task
+* ---------------------------
+*  Same as submit_task(), but the task is added to a TaskGroup, so
+*  wait_task_group() can wait for it.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*  group: Pointer to the TaskGroup (zero initiated before its first task).
+*  function: Task function.
+*  arg: Argument passed to the task function.
+*
+*  returns: If failed (0), on success (1)
+*/
+int submit_group_task(ThreadPool* pool, TaskGroup* group, TaskFunction function, void* arg) {
+    if (pool == NULL || function == NULL) {
+        fprintf(stderr, "[ERROR]: submit_task() {} -> Required parameters are NULL!\n");
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    size_t index = current_pool == pool ? current_queue : pool->next_queue++ % pool->thread_count;
+    TaskQueue* queue = &pool->queues[index];
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity) {
+        // Grow the ring and unwrap it to the beginning of the new array
+        size_t new_capacity = 2 * queue->capacity;
+        Task* tasks = malloc(new_capacity * sizeof(Task));
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&queue->lock);
+            pthread_mutex_unlock(&pool->lock);
+            fprintf(stderr, "[ERROR]: submit_task() {} -> Unable to allocate memory for the task queue!\n");
+            return 0;
+        }
+        for (size_t i = 0; i < queue->count; i++) {
+            tasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+        }
+        free(queue->tasks);
+        queue->tasks = tasks;
+        queue->capacity = new_capacity;
+        queue->head = 0;
+    }
+
+    size_t tail = (queue->head + queue->count) % queue->capacity;
+    queue->tasks[tail].function = function;
+    queue->tasks[tail].arg = arg;
+    queue->tasks[tail].group = group;
+    queue->count++;
+    pthread_mutex_unlock(&queue->lock);
+
+    if (group != NULL) {
+        group->pending++;
+    }
+    pool->task_count++;
+    pthread_cond_signal(&pool->task_ready);
+    if (pool->group_waiters > 0) {
+        pthread_cond_broadcast(&pool->tasks_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return 1;
+}
+
+/*
+* Function: wait_task_group
+* -------------------------
+*  Blocks until every task of a TaskGroup has finished. While waiting, the
+*  calling thread runs queued tasks itself, so tasks of the pool may wait
+*  for groups of their own without tying up the workers.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*  group: Pointer to the TaskGroup.
+*/
+void wait_task_group(ThreadPool* pool, TaskGroup* group) {
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        size_t pending = group->pending;
+        pthread_mutex_unlock(&pool->lock);
+        if (pending == 0) {
+            return;
+        }
+
+        Task task;
+        if (take_task(pool, &task)) {
+            run_task(pool, &task);
+            continue;
+        }
+
+        // Nothing to help with: sleep until a task finishes or a new one is queued
+        pthread_mutex_lock(&pool->lock);
+        pool->group_waiters++;
+        while (group->pending > 0 && pool->task_count == 0) {
+            pthread_cond_wait(&pool->tasks_done, &pool->lock);
+        }
+        pool->group_waiters--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/*
+* Function: wait_thread_pool
+* --------------------------
+*  Blocks until every submitted task has finished.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*/
+void wait_thread_pool(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->task_count > 0 || pool->active_count > 0) {
+        pthread_cond_wait(&pool->tasks_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+* Function: free_thread_pool
+* --------------------------
+*  Finishes the queued tasks, stops the worker threads and frees the pool.
+*
+*  pool: Pointer to the initiated ThreadPool.
+*/
+void free_thread_pool(ThreadPool* pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    stop_thread_pool(pool, pool->thread_count);
+}
@@ -1,8 +1,14 @@
 #include "../include/utils.h"
+#include "../include/constants.h"
 
+#include <ctype.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 /*
 * Function err
@@ -35,6 +41,37 @@ FILE* open_file(const char* path, const char* mode) {
     return file;
 }
 
+/*
+* Function open_stream
+* --------------------
+*  Same as open_file(), but the path "-" stands for stdin (read modes) or
+*  stdout (write modes). When stdout carries the data, the logs printed on
+*  stdout are moved to stderr so they don't mix with it.
+*
+*  path: File path or "-"
+*  mode: fopen modes
+*
+*  returns: Pointer to the file. If failed, returns NULL
+*/
+FILE* open_stream(const char* path, const char* mode) {
+    if (strcmp(path, "-") != 0) {
+        return open_file(path, mode);
+    }
+    if (mode[0] == 'r') {
+        return stdin;
+    }
+
+    // Keep the real stdout for the data and send everything printed on stdout to stderr
+    fflush(stdout);
+    int data_fd = dup(STDOUT_FILENO);
+    FILE* file = data_fd >= 0 ? fdopen(data_fd, "wb") : NULL;
+    if (file == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        fprintf(stderr, "\n[ERROR]: open_stream() {} -> Unable to open stdout!\n");
+        return NULL;
+    }
+    return file;
+}
+
 /*
 * Function: extract_filename_format
 * ---------------------------------
@@ -144,6 +181,154 @@ size_t get_file_size(FILE* file) {
     return end;
 }
 
+/*
+* Function: is_regular_file
+* -------------------------
+*  Checks if the file is a regular (seekable, mappable) file, rather than a
+*  pipe, socket or terminal.
+*
+*  file: Pointer to the file
+*
+*  returns: Regular file (1), otherwise (0)
+*/
+int is_regular_file(FILE* file) {
+    struct stat st;
+    if (file == NULL || fstat(fileno(file), &st) != 0) {
+        return 0;
+    }
+    return S_ISREG(st.st_mode) ? 1 : 0;
+}
+
+/*
+* Function: is_directory
+* ----------------------
+*  Checks if a path names a directory.
+*
+*  path: Path
+*
+*  returns: Directory (1), otherwise (0)
+*/
+int is_directory(const char* path) {
+    struct stat st;
+    if (path == NULL || stat(path, &st) != 0) {
+        return 0;
+    }
+    return S_ISDIR(st.st_mode) ? 1 : 0;
+}
+
+/*
+* Function: parse_size
+* --------------------
+*  Parses a size in bytes, with an optional K, M or G suffix (powers of
+*  1024, either case, optionally followed by B or iB), e.g. 4096, 64K or 4MB.
+*
+*  text: Size text
+*  size: Pointer to the parsed size
+*
+*  returns: If the text is not a size, or overflows (0), on success (1)
+*/
+int parse_size(const char* text, size_t* size) {
+    if (text == NULL || !isdigit((unsigned char) text[0])) {
+        return 0;
+    }
+    size_t value = 0;
+    const char* c = text;
+    for (; isdigit((unsigned char) *c); c++) {
+        if (value > (SIZE_MAX - (size_t) (*c - '0')) / 10) {
+            return 0;
+        }
+        value = value * 10 + (size_t) (*c - '0');
+    }
+
+    size_t unit = 1;
+    switch (toupper((unsigned char) *c)) {
+        case 'K':
+            unit = KB;
+            break;
+        case 'M':
+            unit = MB;
+            break;
+        case 'G':
+            unit = (size_t) 1024 * MB;
+            break;
+        default:
+            break;
+    }
+    if (unit > 1) {
+        c++;
+        if (*c == 'i' && toupper((unsigned char) c[1]) == 'B') {
+            c++;
+        }
+    }
+    if (toupper((unsigned char) *c) == 'B') {
+        c++;
+    }
+    if (*c != '\0' || (value > 0 && unit > SIZE_MAX / value)) {
+        return 0;
+    }
+    *size = value * unit;
+    return 1;
+}
+
+/*
+* Function: get_io_block_size
+* ---------------------------
+*  Returns the preferred I/O size of a file (st_blksize).
+*
+*  file: Pointer to the file
+*
+*  returns: I/O size (DEFAULT_IO_BLOCK_SIZE if unknown).
+*/
+size_t get_io_block_size(FILE* file) {
+    struct stat st;
+    if (file == NULL || fstat(fileno(file), &st) != 0 || st.st_blksize <= 0) {
+        return DEFAULT_IO_BLOCK_SIZE;
+    }
+    return (size_t) st.st_blksize;
+}
+
+/*
+* Function: get_l2_cache_size
+* ---------------------------
+*  Returns the size of the L2 cache of the first CPU, from sysconf() or
+*  sysfs.
+*
+*  returns: Cache size (DEFAULT_L2_CACHE_SIZE if unknown).
+*/
+size_t get_l2_cache_size(void) {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long sysconf_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (sysconf_size > 0) {
+        return (size_t) sysconf_size;
+    }
+#endif
+    // Where glibc does not know it (e.g. on ARM), sysfs has it as "1024K"
+    size_t size = 0;
+    char text[32] = {0};
+    FILE* file = fopen("/sys/devices/system/cpu/cpu0/cache/index2/size", "r");
+    if (file != NULL) {
+        if (fgets(text, sizeof(text), file) != NULL) {
+            text[strcspn(text, "\n")] = '\0';
+        }
+        fclose(file);
+    }
+    return parse_size(text, &size) && size > 0 ? size : DEFAULT_L2_CACHE_SIZE;
+}
+
+/*
+* Function: get_wall_time
+* -----------------------
+*  Returns the monotonic wall clock time. Unlike clock() (CPU time of the
+*  process), it includes the time spent waiting for I/O.
+*
+*  returns: Time in seconds.
+*/
+double get_wall_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
 /*
 * Function get_line
 * -----------------
@@ -1,14 +1,33 @@
+#include "../include/buffer.h"
+#include "../include/compressor.h"
+#include "../include/constants.h"
+#include "../include/context.h"
+#include "../include/pool.h"
+#include "../include/rle.h"
+#include "../include/stream.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#define MAX_PATH 256
+// Buffers fit the longest name the directory can hand back, so no path or command is ever truncated
+#define TEST_DIR_SIZE 64
+#define MAX_PATH (TEST_DIR_SIZE + NAME_MAX + 8)
+#define MAX_COMMAND (4 * MAX_PATH + 128)
 #define TEST_FILES_DIR "./test/test_files"
 #define TEST_RESULTS_DIR "./test/test_results"
+#define STRESS_MAX_CHUNK_SIZE 4096
+#define STRESS_MAX_FILE_SIZE (256 * KB)
+#define ROUND_TRIP_BLOCK_SIZE (4 * KB)
+#define ROUND_TRIP_THREADS 4
+#define STREAM_INPUT_SIZE 1000
+#define STREAM_OUTPUT_SIZE 777
+#define CONTEXT_ROUNDS 4
 
 // Function to create a directory if it doesn't exist
 int create_directory(const char *path) {
@@ -59,6 +78,317 @@ int compare_files(const char *file1, const char *file2) {
     return equal;
 }
 
+// Function to read a whole stream into memory
+unsigned char *read_stream(FILE *stream, size_t *size) {
+    fseek(stream, 0, SEEK_END);
+    *size = ftell(stream);
+    rewind(stream);
+    unsigned char *data = malloc(*size + 1);
+    if (data == NULL || fread(data, 1, *size, stream) != *size) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// Function to decode a compressed file with every chunk size from 1 to STRESS_MAX_CHUNK_SIZE,
+// so tokens get split at every possible position
+int stress_chunk_sizes(const char *path, CompressionMode mode) {
+    FILE *input = fopen(path, "rb");
+    FILE *compressed = tmpfile();
+    FILE *output = tmpfile();
+    if (!input || !compressed || !output) {
+        fprintf(stderr, "Failed to open files for stress test: %s\n", path);
+        return -1;
+    }
+
+    int equal = 1;
+    size_t original_size = 0, compressed_size = 0;
+    unsigned char *original = read_stream(input, &original_size);
+    unsigned char *decoded = malloc(original_size + 1);
+    unsigned char *data = NULL;
+    RLEWriter rle_writer;
+    if (original && decoded && init_writer(&rle_writer, compressed, COMPRESSED_BUFFER_SIZE, mode)) {
+        rewind(input);
+        if (encode(input, &rle_writer, DECOMPRESSED_BUFFER_SIZE) >= 0) {
+            data = read_stream(compressed, &compressed_size);
+        }
+        free_writer(&rle_writer);
+    }
+    if (data == NULL || compressed_size < 1) {
+        equal = -1;
+    }
+
+    // Skip the compression mode byte
+    for (size_t chunk_size = 1; equal == 1 && chunk_size <= STRESS_MAX_CHUNK_SIZE; chunk_size++) {
+        RLEReader rle_reader;
+        rewind(output);
+        if (!init_reader(&rle_reader, output, COMPRESSED_BUFFER_SIZE, mode)) {
+            equal = -1;
+            break;
+        }
+        for (size_t pos = 1; pos < compressed_size && equal == 1; pos += chunk_size) {
+            size_t size = compressed_size - pos < chunk_size ? compressed_size - pos : chunk_size;
+            if (read_rle_chunk(&rle_reader, &data[pos], size) < 0) {
+                equal = 0;
+            }
+        }
+        if (rle_reader.state != read_counter || flush_reader(&rle_reader) < 0) {
+            equal = 0;
+        }
+        free_reader(&rle_reader);
+
+        fflush(output);
+        long decoded_size = ftell(output);
+        rewind(output);
+        if (equal == 1 && (decoded_size != (long) original_size ||
+                           fread(decoded, 1, original_size, output) != original_size ||
+                           memcmp(decoded, original, original_size) != 0)) {
+            printf("\t[DIFF] chunk size %zu\n\r", chunk_size);
+            equal = 0;
+        }
+    }
+
+    free(original);
+    free(decoded);
+    free(data);
+    fclose(input);
+    fclose(compressed);
+    fclose(output);
+    return equal;
+}
+
+// Function to compress and decompress a file through buffered I/O (compress() and decompress()),
+// with small blocks and several threads, then to decompress a range from the middle of it
+int round_trip(const char *path, CompressionMode mode) {
+    FILE *input = fopen(path, "rb");
+    FILE *compressed = tmpfile();
+    FILE *output = tmpfile();
+    FILE *range = tmpfile();
+    if (!input || !compressed || !output || !range) {
+        fprintf(stderr, "Failed to open files for round trip: %s\n", path);
+        return -1;
+    }
+
+    CompressorOptions options;
+    init_compressor_options(&options);
+    options.compression_mode = mode;
+    options.block_size = ROUND_TRIP_BLOCK_SIZE;
+    options.thread_count = ROUND_TRIP_THREADS;
+
+    int equal = 0;
+    size_t original_size = 0, decoded_size = 0;
+    if (compress(input, compressed, &options)) {
+        rewind(compressed);
+        if (decompress(compressed, output, &options)) {
+            unsigned char *original = read_stream(input, &original_size);
+            unsigned char *decoded = read_stream(output, &decoded_size);
+            equal = original && decoded && original_size == decoded_size &&
+                    memcmp(original, decoded, original_size) == 0;
+
+            size_t range_offset = original_size / 3;
+            size_t range_size = original_size / 3 + 1;
+            rewind(compressed);
+            free(decoded);
+            decoded = NULL;
+            if (equal && decompress_range(compressed, range, range_offset, range_size, &options)) {
+                decoded = read_stream(range, &decoded_size);
+            }
+            equal = equal && decoded && decoded_size == range_size &&
+                    memcmp(&original[range_offset], decoded, range_size) == 0;
+            free(original);
+            free(decoded);
+        }
+    }
+
+    fclose(input);
+    fclose(compressed);
+    fclose(output);
+    fclose(range);
+    return equal;
+}
+
+// Function to compress and decompress a file buffer to buffer (rle_compress_buffer() and
+// rle_decompress_buffer()), and to check that an unknown mode is rejected instead of written
+int buffer_round_trip(const char *path, CompressionMode mode) {
+    FILE *input = fopen(path, "rb");
+    if (!input) {
+        fprintf(stderr, "Failed to open file for buffer round trip: %s\n", path);
+        return -1;
+    }
+
+    int equal = 0;
+    size_t original_size = 0;
+    unsigned char *original = read_stream(input, &original_size);
+    size_t capacity = rle_compress_bound(original_size);
+    unsigned char *compressed = malloc(capacity);
+    unsigned char *decoded = malloc(original_size + 1);
+    if (original && compressed && decoded) {
+        ssize_t compressed_size = rle_compress_buffer(original, original_size, compressed, capacity, mode);
+        ssize_t decoded_size = compressed_size < 0 ? -1 : rle_decompress_buffer(compressed, compressed_size, decoded,
+                                                                                original_size);
+        equal = decoded_size == (ssize_t) original_size &&
+                rle_get_decompressed_size(compressed, compressed_size) == decoded_size &&
+                memcmp(original, decoded, original_size) == 0 &&
+                rle_compress_buffer(original, original_size, compressed, capacity, adaptive + 1) == -1;
+    }
+
+    free(original);
+    free(compressed);
+    free(decoded);
+    fclose(input);
+    return equal;
+}
+
+// Function to compress a file buffer to buffer in adaptive mode, checking that it round trips and
+// is never larger than the basic, advance or varint containers
+int adaptive_round_trip(const char *path) {
+    FILE *input = fopen(path, "rb");
+    if (!input) {
+        fprintf(stderr, "Failed to open file for adaptive round trip: %s\n", path);
+        return -1;
+    }
+
+    int equal = 0;
+    size_t original_size = 0;
+    unsigned char *original = read_stream(input, &original_size);
+    size_t capacity = rle_compress_bound(original_size);
+    unsigned char *compressed = malloc(capacity);
+    unsigned char *decoded = malloc(original_size + 1);
+    if (original && compressed && decoded) {
+        ssize_t basic_size = rle_compress_buffer(original, original_size, compressed, capacity, basic);
+        ssize_t advance_size = rle_compress_buffer(original, original_size, compressed, capacity, advance);
+        ssize_t varint_size = rle_compress_buffer(original, original_size, compressed, capacity, varint);
+        ssize_t compressed_size = rle_compress_buffer(original, original_size, compressed, capacity, adaptive);
+        ssize_t decoded_size = compressed_size < 0 ? -1 : rle_decompress_buffer(compressed, compressed_size, decoded,
+                                                                                original_size);
+        equal = decoded_size == (ssize_t) original_size &&
+                compressed_size <= basic_size && compressed_size <= advance_size && compressed_size <= varint_size &&
+                memcmp(original, decoded, original_size) == 0;
+    }
+
+    free(original);
+    free(compressed);
+    free(decoded);
+    fclose(input);
+    return equal;
+}
+
+// Function to compress and decompress a file through streaming contexts, feeding small input
+// pieces into small output buffers so tokens and output get cut everywhere
+int stream_round_trip(const char *path, CompressionMode mode) {
+    FILE *input = fopen(path, "rb");
+    if (!input) {
+        fprintf(stderr, "Failed to open file for stream round trip: %s\n", path);
+        return -1;
+    }
+
+    int equal = 0;
+    size_t original_size = 0;
+    unsigned char *original = read_stream(input, &original_size);
+    unsigned char *compressed = malloc(2 * original_size + STREAM_OUTPUT_SIZE);
+    unsigned char *decoded = malloc(original_size + STREAM_OUTPUT_SIZE);
+    RLEStream stream;
+    if (original && compressed && decoded && rle_stream_init(&stream, stream_compress, mode)) {
+        size_t consumed = 0, compressed_size = 0;
+        ssize_t produced = 0;
+        do {
+            size_t size = original_size - consumed < STREAM_INPUT_SIZE ? original_size - consumed : STREAM_INPUT_SIZE;
+            produced = rle_stream_compress(&stream, &original[consumed], size, &compressed[compressed_size],
+                                           STREAM_OUTPUT_SIZE, consumed + size == original_size ? stream_finish : stream_no_flush);
+            consumed += stream.input_consumed;
+            compressed_size += produced > 0 ? produced : 0;
+        } while (produced > 0 || consumed < original_size);
+        rle_stream_end(&stream);
+
+        size_t decoded_size = 0;
+        if (produced == 0 && rle_stream_init(&stream, stream_decompress, mode)) {
+            consumed = 0;
+            do {
+                size_t size = compressed_size - consumed < STREAM_INPUT_SIZE ? compressed_size - consumed : STREAM_INPUT_SIZE;
+                produced = rle_stream_decompress(&stream, &compressed[consumed], size, &decoded[decoded_size],
+                                                 STREAM_OUTPUT_SIZE, consumed + size == compressed_size ? stream_finish : stream_no_flush);
+                consumed += stream.input_consumed;
+                decoded_size += produced > 0 ? produced : 0;
+            } while (produced > 0 || (produced == 0 && consumed < compressed_size));
+            rle_stream_end(&stream);
+            equal = produced == 0 && decoded_size == original_size && memcmp(original, decoded, original_size) == 0;
+        }
+    }
+
+    free(original);
+    free(compressed);
+    free(decoded);
+    fclose(input);
+    return equal;
+}
+
+// Function to round trip a file several times through short-lived contexts on one buffer pool,
+// as legacy streams and buffer to buffer, checking that only the first round allocates
+int context_round_trip(const char *path) {
+    FILE *input = fopen(path, "rb");
+    if (!input) {
+        fprintf(stderr, "Failed to open file for context round trip: %s\n", path);
+        return -1;
+    }
+
+    int equal = 0;
+    size_t original_size = 0;
+    unsigned char *original = read_stream(input, &original_size);
+    size_t capacity = rle_compress_bound(original_size);
+    unsigned char *compressed = malloc(capacity);
+    unsigned char *decoded = malloc(original_size + 1);
+    BufferPool pool;
+    if (original && compressed && decoded && init_buffer_pool(&pool, 1)) {
+        size_t warm_allocations = 0;
+        equal = 1;
+        for (int round = 0; equal == 1 && round < CONTEXT_ROUNDS; round++) {
+            RLEContext ctx;
+            FILE *encoded = tmpfile();
+            FILE *output = tmpfile();
+            equal = encoded && output && rle_context_create(&ctx, &pool, round % 2 ? advance : basic, 0, 0);
+            if (equal) {
+                rewind(input);
+                size_t decoded_size = 0;
+                unsigned char *streamed = NULL;
+                equal = rle_context_encode(&ctx, input, encoded) >= 0 && fflush(encoded) == 0 &&
+                        fseek(encoded, 0, SEEK_SET) == 0 && rle_context_decode(&ctx, encoded, output) >= 0 &&
+                        fflush(output) == 0 && fseek(output, 0, SEEK_SET) == 0 &&
+                        (streamed = read_stream(output, &decoded_size)) != NULL && decoded_size == original_size &&
+                        memcmp(original, streamed, original_size) == 0;
+                free(streamed);
+
+                ssize_t compressed_size = -1;
+                equal = equal && rle_context_reset(&ctx, adaptive) &&
+                        (compressed_size = rle_context_compress(&ctx, original, original_size, compressed, capacity)) > 0 &&
+                        rle_context_decompress(&ctx, compressed, compressed_size, decoded, original_size) ==
+                        (ssize_t) original_size && memcmp(original, decoded, original_size) == 0;
+                rle_context_destroy(&ctx);
+            }
+            if (encoded) {
+                fclose(encoded);
+            }
+            if (output) {
+                fclose(output);
+            }
+            // Every later round reuses the buffers the first one gave back
+            if (round == 0) {
+                warm_allocations = pool.allocations;
+            } else if (equal && pool.allocations != warm_allocations) {
+                fprintf(stderr, "Context round %d allocated %zu buffers\n", round, pool.allocations - warm_allocations);
+                equal = 0;
+            }
+        }
+        free_buffer_pool(&pool);
+    }
+
+    free(original);
+    free(compressed);
+    free(decoded);
+    fclose(input);
+    return equal;
+}
+
 int main() {
     // Compile the main program
     if (run_command("make all") != 0) {
@@ -80,6 +410,7 @@ int main() {
 
     struct dirent *entry;
     int test_number = 1;
+    int failed = 0;
 
     // Process each file in test_files
     while ((entry = readdir(dir)) != NULL) {
@@ -94,14 +425,34 @@ int main() {
         char adv_compressed_path[MAX_PATH];
         char decompressed_path[MAX_PATH];
         char adv_decompressed_path[MAX_PATH];
-        char test_dir[MAX_PATH];
+        char pattern_compressed_path[MAX_PATH];
+        char pattern_decompressed_path[MAX_PATH];
+        char planes_compressed_path[MAX_PATH];
+        char planes_decompressed_path[MAX_PATH];
+        char delta_compressed_path[MAX_PATH];
+        char delta_decompressed_path[MAX_PATH];
+        char huffman_compressed_path[MAX_PATH];
+        char huffman_decompressed_path[MAX_PATH];
+        char ring_compressed_path[MAX_PATH];
+        char ring_decompressed_path[MAX_PATH];
+        char test_dir[TEST_DIR_SIZE];
 
         snprintf(input_path, MAX_PATH, "%s/%s", TEST_FILES_DIR, entry->d_name);
-        snprintf(test_dir, MAX_PATH, "%s/test_%d", TEST_RESULTS_DIR, test_number);
+        snprintf(test_dir, sizeof(test_dir), "%s/test_%d", TEST_RESULTS_DIR, test_number);
         snprintf(compressed_path, MAX_PATH, "%s/%s.rle", test_dir, entry->d_name);
         snprintf(adv_compressed_path, MAX_PATH, "%s/a_%s.rle", test_dir, entry->d_name);
         snprintf(decompressed_path, MAX_PATH, "%s/%s", test_dir, entry->d_name);
         snprintf(adv_decompressed_path, MAX_PATH, "%s/a_%s", test_dir, entry->d_name);
+        snprintf(pattern_compressed_path, MAX_PATH, "%s/p_%s.rle", test_dir, entry->d_name);
+        snprintf(pattern_decompressed_path, MAX_PATH, "%s/p_%s", test_dir, entry->d_name);
+        snprintf(planes_compressed_path, MAX_PATH, "%s/P_%s.rle", test_dir, entry->d_name);
+        snprintf(planes_decompressed_path, MAX_PATH, "%s/P_%s", test_dir, entry->d_name);
+        snprintf(delta_compressed_path, MAX_PATH, "%s/D_%s.rle", test_dir, entry->d_name);
+        snprintf(delta_decompressed_path, MAX_PATH, "%s/D_%s", test_dir, entry->d_name);
+        snprintf(huffman_compressed_path, MAX_PATH, "%s/H_%s.rle", test_dir, entry->d_name);
+        snprintf(huffman_decompressed_path, MAX_PATH, "%s/H_%s", test_dir, entry->d_name);
+        snprintf(ring_compressed_path, MAX_PATH, "%s/U_%s.rle", test_dir, entry->d_name);
+        snprintf(ring_decompressed_path, MAX_PATH, "%s/U_%s", test_dir, entry->d_name);
 
         // Create test-specific directory
         if (create_directory(test_dir) != 0) {
@@ -112,16 +463,16 @@ int main() {
         printf("\n--------------------------|TEST %02d|--------------------------\n", test_number);
 
         // Run compression
-        char cmd[MAX_PATH * 2];
+        char cmd[MAX_COMMAND];
         snprintf(cmd, sizeof(cmd), "./bin/rle -c %s -o %s", input_path, compressed_path);
-        printf("[TEST 1/6]: Compressing %s\n", entry->d_name);
+        printf("[TEST 1/22]: Compressing %s\n", entry->d_name);
         if (run_command(cmd) != 0) {
             fprintf(stderr, "Compression failed for %s\n", entry->d_name);
             closedir(dir);
             return 1;
         }
         snprintf(cmd, sizeof(cmd), "./bin/rle -a -c %s -o %s", input_path, adv_compressed_path);
-        printf("[TEST 2/6]: Compressing %s (Advance mode)\n", entry->d_name);
+        printf("[TEST 2/22]: Compressing %s (Advance mode)\n", entry->d_name);
         if (run_command(cmd) != 0) {
             fprintf(stderr, "Compression failed for %s\n", entry->d_name);
             closedir(dir);
@@ -130,14 +481,14 @@ int main() {
 
         // Run decompression
         snprintf(cmd, sizeof(cmd), "./bin/rle -d %s -o %s", compressed_path, decompressed_path);
-        printf("[TEST 3/6]: Decompressing %s.rle\n", entry->d_name);
+        printf("[TEST 3/22]: Decompressing %s.rle\n", entry->d_name);
         if (run_command(cmd) != 0) {
             fprintf(stderr, "Decompression failed for %s\n", entry->d_name);
             closedir(dir);
             return 1;
         }
-        snprintf(cmd, sizeof(cmd), "./bin/rle -d %s -o %s", compressed_path, adv_decompressed_path);
-        printf("[TEST 4/6]: Decompressing a_%s.rle\n", entry->d_name);
+        snprintf(cmd, sizeof(cmd), "./bin/rle -d %s -o %s", adv_compressed_path, adv_decompressed_path);
+        printf("[TEST 4/22]: Decompressing a_%s.rle\n", entry->d_name);
         if (run_command(cmd) != 0) {
             fprintf(stderr, "Decompression failed for %s\n", entry->d_name);
             closedir(dir);
@@ -145,24 +496,183 @@ int main() {
         }
 
         // Verify decompressed file matches original
-        printf("[TEST 5/6]: Verifying %s\n", entry->d_name);
+        printf("[TEST 5/22]: Verifying %s\n", entry->d_name);
         if (compare_files(input_path, decompressed_path)) {
             printf("--- [PASSED] - Decompressed file matches original\n");
         } else {
             printf("--- [FAILED] - Decompressed file differs from original\n");
+            failed++;
         }
-        printf("[TEST 6/6]: Verifying a_%s\n", entry->d_name);
+        printf("[TEST 6/22]: Verifying a_%s\n", entry->d_name);
         if (compare_files(input_path, adv_decompressed_path)) {
             printf("--- [PASSED] - Decompressed file matches original\n");
         } else {
             printf("--- [FAILED] - Decompressed file differs from original\n");
+            failed++;
+        }
+
+        // Decode with every chunk size, small files only
+        struct stat st;
+        for (int mode = basic; mode <= advance; mode++) {
+            printf("[TEST %d/22]: Decoding %s%s with chunk sizes 1-%d\n", 7 + mode, mode == advance ? "a_" : "",
+                   entry->d_name, STRESS_MAX_CHUNK_SIZE);
+            if (stat(input_path, &st) != 0 || st.st_size > STRESS_MAX_FILE_SIZE) {
+                printf("--- [SKIPPED] - File is larger than %d bytes\n", STRESS_MAX_FILE_SIZE);
+            } else if (stress_chunk_sizes(input_path, mode) == 1) {
+                printf("--- [PASSED] - Every chunk size decodes to the original\n");
+            } else {
+                printf("--- [FAILED] - Chunked decoding differs from original\n");
+                failed++;
+            }
+        }
+
+        // Compress and decompress through buffered I/O (the CLI maps regular files)
+        for (int mode = basic; mode <= advance; mode++) {
+            printf("[TEST %d/22]: Round-tripping %s%s through buffered I/O and a range\n", 9 + mode,
+                   mode == advance ? "a_" : "", entry->d_name);
+            if (round_trip(input_path, mode) == 1) {
+                printf("--- [PASSED] - Decompressed data matches original\n");
+            } else {
+                printf("--- [FAILED] - Decompressed data differs from original\n");
+                failed++;
+            }
+        }
+
+        // Compress and decompress buffer to buffer
+        for (int mode = basic; mode <= advance; mode++) {
+            printf("[TEST %d/22]: Round-tripping %s%s buffer to buffer\n", 11 + mode,
+                   mode == advance ? "a_" : "", entry->d_name);
+            if (buffer_round_trip(input_path, mode) == 1) {
+                printf("--- [PASSED] - Decompressed data matches original\n");
+            } else {
+                printf("--- [FAILED] - Decompressed data differs from original\n");
+                failed++;
+            }
+        }
+
+        // Compress and decompress through streaming contexts
+        for (int mode = basic; mode <= advance; mode++) {
+            printf("[TEST %d/22]: Streaming %s%s in %d byte pieces\n", 13 + mode, mode == advance ? "a_" : "",
+                   entry->d_name, STREAM_INPUT_SIZE);
+            if (stream_round_trip(input_path, mode) == 1) {
+                printf("--- [PASSED] - Decompressed data matches original\n");
+            } else {
+                printf("--- [FAILED] - Decompressed data differs from original\n");
+                failed++;
+            }
+        }
+
+        // Varint run lengths, buffer to buffer
+        printf("[TEST 15/22]: Round-tripping %s with varint tokens\n", entry->d_name);
+        if (buffer_round_trip(input_path, varint) == 1) {
+            printf("--- [PASSED] - Decompressed data matches original\n");
+        } else {
+            printf("--- [FAILED] - Decompressed data differs from original\n");
+            failed++;
+        }
+
+        // Pick the smallest mode for every block
+        printf("[TEST 16/22]: Round-tripping %s in adaptive mode\n", entry->d_name);
+        if (adaptive_round_trip(input_path) == 1) {
+            printf("--- [PASSED] - Decompressed data matches original, no larger than any mode\n");
+        } else {
+            printf("--- [FAILED] - Adaptive data differs or is larger than a single mode\n");
+            failed++;
+        }
+
+        // Runs of 3 byte elements (24-bit pixels)
+        printf("[TEST 17/22]: Round-tripping %s in pattern mode (3 byte elements)\n", entry->d_name);
+        snprintf(cmd, sizeof(cmd), "./bin/rle -p 3 -c %s -o %s && ./bin/rle -d %s -o %s", input_path,
+                 pattern_compressed_path, pattern_compressed_path, pattern_decompressed_path);
+        if (run_command(cmd) == 0 && compare_files(input_path, pattern_decompressed_path)) {
+            printf("--- [PASSED] - Decompressed file matches original\n");
+        } else {
+            printf("--- [FAILED] - Decompressed file differs from original\n");
+            failed++;
+        }
+
+        // Blocks split into B, G and R planes, decoded from a pipe
+        printf("[TEST 18/22]: Round-tripping %s split into 3 byte planes\n", entry->d_name);
+        snprintf(cmd, sizeof(cmd), "./bin/rle -P 3 -c %s -o %s && ./bin/rle -d - -o - < %s > %s", input_path,
+                 planes_compressed_path, planes_compressed_path, planes_decompressed_path);
+        if (run_command(cmd) == 0 && compare_files(input_path, planes_decompressed_path)) {
+            printf("--- [PASSED] - Decompressed file matches original\n");
+        } else {
+            printf("--- [FAILED] - Decompressed file differs from original\n");
+            failed++;
+        }
+
+        // Differences to the previous pixel, then split into planes
+        printf("[TEST 19/22]: Round-tripping %s with pixel deltas and 3 byte planes\n", entry->d_name);
+        snprintf(cmd, sizeof(cmd), "./bin/rle -D 3 -P 3 -l -c %s -o %s && ./bin/rle -d %s -o %s", input_path,
+                 delta_compressed_path, delta_compressed_path, delta_decompressed_path);
+        if (run_command(cmd) == 0 && compare_files(input_path, delta_decompressed_path)) {
+            printf("--- [PASSED] - Decompressed file matches original\n");
+        } else {
+            printf("--- [FAILED] - Decompressed file differs from original\n");
+            failed++;
+        }
+
+        // Huffman coded tokens, decoded from a pipe
+        printf("[TEST 20/22]: Round-tripping %s with Huffman coded tokens\n", entry->d_name);
+        snprintf(cmd, sizeof(cmd), "./bin/rle -H -P 3 -c %s -o %s && ./bin/rle -d - -o %s < %s", input_path,
+                 huffman_compressed_path, huffman_decompressed_path, huffman_compressed_path);
+        if (run_command(cmd) == 0 && compare_files(input_path, huffman_decompressed_path)) {
+            printf("--- [PASSED] - Decompressed file matches original\n");
+        } else {
+            printf("--- [FAILED] - Decompressed file differs from original\n");
+            failed++;
+        }
+
+        // io_uring reads and writes (stdio where io_uring is not available), small blocks for many requests
+        printf("[TEST 21/22]: Round-tripping %s through io_uring\n", entry->d_name);
+        snprintf(cmd, sizeof(cmd), "./bin/rle -U -s 4096 -c %s -o %s && ./bin/rle -U -d %s -o %s", input_path,
+                 ring_compressed_path, ring_compressed_path, ring_decompressed_path);
+        if (run_command(cmd) == 0 && compare_files(input_path, ring_decompressed_path)) {
+            printf("--- [PASSED] - Decompressed file matches original\n");
+        } else {
+            printf("--- [FAILED] - Decompressed file differs from original\n");
+            failed++;
+        }
+
+        // Reusable contexts on one buffer pool
+        printf("[TEST 22/22]: Round-tripping %s %d times through pooled contexts\n", entry->d_name, CONTEXT_ROUNDS);
+        if (context_round_trip(input_path) == 1) {
+            printf("--- [PASSED] - Decompressed data matches original, no allocations after the first round\n");
+        } else {
+            printf("--- [FAILED] - Decompressed data differs or the pool kept allocating\n");
+            failed++;
         }
 
         test_number++;
     }
+
+    // Batch mode: the whole directory on one thread pool, compressed into one directory and decompressed into another
+    char batch_cmd[MAX_COMMAND];
+    printf("[TEST BATCH]: Round-tripping %s as one batch\n", TEST_FILES_DIR);
+    snprintf(batch_cmd, sizeof(batch_cmd), "./bin/rle -P 3 -c %s -o %s/batch && ./bin/rle -d %s/batch -o %s/batch_out",
+             TEST_FILES_DIR, TEST_RESULTS_DIR, TEST_RESULTS_DIR, TEST_RESULTS_DIR);
+    int batch_matches = run_command(batch_cmd) == 0;
+    rewinddir(dir);
+    while (batch_matches && (entry = readdir(dir)) != NULL) {
+        char input_path[MAX_PATH];
+        char output_path[MAX_PATH];
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        snprintf(input_path, MAX_PATH, "%s/%s", TEST_FILES_DIR, entry->d_name);
+        snprintf(output_path, MAX_PATH, "%s/batch_out/%s", TEST_RESULTS_DIR, entry->d_name);
+        batch_matches = compare_files(input_path, output_path);
+    }
+    if (batch_matches) {
+        printf("--- [PASSED] - Decompressed files match originals\n");
+    } else {
+        printf("--- [FAILED] - Decompressed files differ from originals\n");
+        failed++;
+    }
     printf("\n-------------------------------------------------------------\n");
 
     closedir(dir);
-    printf("Testing complete.\n");
-    return 0;
+    printf("Testing complete.%s\n", failed ? " Some tests FAILED!" : "");
+    return failed ? 1 : 0;
 }